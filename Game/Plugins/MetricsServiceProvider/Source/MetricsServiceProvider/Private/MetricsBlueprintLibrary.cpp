@@ -45,12 +45,21 @@ void UMetricsBlueprintLibrary::TelemetryEventForPlayerWithAttributesWithClientOv
 		return;
 	}
 
-	FString MetricClass = EnumToString(EventClass);
 	const UWorld* World = WorldContextObject->GetWorld();
 
 	// Only report metrics when we are on the server(and have a playerstate) or if this is a native call with a by pass
 	if (PlayerState != nullptr && World != nullptr && (OverrideClientGuard || World->GetNetMode() != NM_Client) && PlayerState->GetUniqueId().IsValid())
 	{
+		// Sample only events that would be sent, so the sampled counts match what's reported. Still before building the
+		// attributes, which is where most of the cost is.
+		float SampleRate = 1.0f;
+		if (!FAnalyticsProviderMetrics::MetricsProvider->ShouldRecordEvent(EventClass, SampleRate))
+		{
+			return;
+		}
+
+		FString MetricClass = EnumToString(EventClass);
+
 		TArray<FAnalyticsEventAttribute> AnalyticsAttributes = ConvertAttrs(Attributes);
 		AnalyticsAttributes.Add(FAnalyticsEventAttribute("Map", World->GetMapName()));
 
@@ -62,11 +71,11 @@ void UMetricsBlueprintLibrary::TelemetryEventForPlayerWithAttributesWithClientOv
 			AnalyticsAttributes.Add(FAnalyticsEventAttribute("Position", Position));
 		}
 
-		FAnalyticsProviderMetrics::MetricsProvider->TelemetryClassEvent(MetricClass, EventName, PlayerState->GetUniqueId()->ToString(), AnalyticsAttributes);
+		FAnalyticsProviderMetrics::MetricsProvider->TelemetryClassEvent(MetricClass, EventName, PlayerState->GetUniqueId()->ToString(), AnalyticsAttributes, SampleRate);
 	}
 	else
 	{
-		UE_LOG(LogPrometheusMetrics, Log, TEXT("Attempting to record event for player as client or NULL playerstate, or no world: %s: %s"), *MetricClass, *EventName);
+		UE_LOG(LogPrometheusMetrics, Log, TEXT("Attempting to record event for player as client or NULL playerstate, or no world: %s: %s"), *EnumToString(EventClass), *EventName);
 	}
 }
 void UMetricsBlueprintLibrary::TelemetryEventForPlayerWithAttributes(const UObject* WorldContextObject, EMetricsClass EventClass, const FString& EventName, const APlayerState* PlayerState, const TArray<FMetricsEventAttr>& Attributes)
@@ -83,9 +92,15 @@ void UMetricsBlueprintLibrary::TelemetryEventWithAttributes(EMetricsClass EventC
 {
 	if (FAnalyticsProviderMetrics::MetricsProvider.IsValid())
 	{
+		float SampleRate = 1.0f;
+		if (!FAnalyticsProviderMetrics::MetricsProvider->ShouldRecordEvent(EventClass, SampleRate))
+		{
+			return;
+		}
+
 		FString MetricClass = EnumToString(EventClass);
 
-		FAnalyticsProviderMetrics::MetricsProvider->TelemetryClassEvent(MetricClass, EventName, "", ConvertAttrs(Attributes));
+		FAnalyticsProviderMetrics::MetricsProvider->TelemetryClassEvent(MetricClass, EventName, "", ConvertAttrs(Attributes), SampleRate);
 	}
 	else
 	{
@@ -93,7 +108,7 @@ void UMetricsBlueprintLibrary::TelemetryEventWithAttributes(EMetricsClass EventC
 	}
 }
 
-TSharedPtr<FPrometheusMetric> UMetricsBlueprintLibrary::GetMetric(const FString& Name, const TArray<FPrometheusLabel>& Labels)
+TSharedPtr<FPrometheusMetric, ESPMode::ThreadSafe> UMetricsBlueprintLibrary::GetMetric(const FString& Name, const TArray<FPrometheusLabel>& Labels)
 {
 	if (FAnalyticsProviderMetrics::MetricsProvider.IsValid())
 	{
@@ -102,6 +117,33 @@ TSharedPtr<FPrometheusMetric> UMetricsBlueprintLibrary::GetMetric(const FString&
 	return nullptr;
 }
 
+FPrometheusMetricHandle UMetricsBlueprintLibrary::RegisterMetric(const FString& Name, const TArray<FPrometheusLabel>& Labels)
+{
+	if (FAnalyticsProviderMetrics::MetricsProvider.IsValid())
+	{
+		return FAnalyticsProviderMetrics::MetricsProvider->Prometheus->RegisterMetric(Name, Labels);
+	}
+	return FPrometheusMetricHandle();
+}
+
+TSharedPtr<FPrometheusHistogram, ESPMode::ThreadSafe> UMetricsBlueprintLibrary::GetHistogram(const FString& Name, const TArray<FPrometheusLabel>& Labels, const TArray<double>& BucketBounds)
+{
+	if (FAnalyticsProviderMetrics::MetricsProvider.IsValid())
+	{
+		return FAnalyticsProviderMetrics::MetricsProvider->Prometheus->GetHistogram(Name, Labels, BucketBounds);
+	}
+	return nullptr;
+}
+
+TSharedPtr<FPrometheusSummary, ESPMode::ThreadSafe> UMetricsBlueprintLibrary::GetSummary(const FString& Name, const TArray<FPrometheusLabel>& Labels, const TArray<double>& Quantiles)
+{
+	if (FAnalyticsProviderMetrics::MetricsProvider.IsValid())
+	{
+		return FAnalyticsProviderMetrics::MetricsProvider->Prometheus->GetSummary(Name, Labels, Quantiles);
+	}
+	return nullptr;
+}
+
 void UMetricsBlueprintLibrary::CacheProfileDetails(const FString& ProfileID, const FString& AccountID, const FString& ClientSessionID)
 {
 	if (FAnalyticsProviderMetrics::MetricsProvider.IsValid())
@@ -8,7 +8,12 @@
 #include "MetricsServiceProvider.h"
 #include "Misc/App.h"
 #include "Misc/EngineBuildSettings.h"
+#include "Misc/Paths.h"
 #include "PrometheusServer.h"
+#include "TelemetryBinaryEncoder.h"
+#include "TelemetrySampler.h"
+#include "TelemetrySpool.h"
+#include "TelemetryWorker.h"
 #include "Runtime/Core/Public/GenericPlatform/GenericPlatformProcess.h"
 #include "Runtime/Core/Public/HAL/PlatformFilemanager.h"
 #include "Runtime/Core/Public/Misc/DateTime.h"
@@ -16,10 +21,6 @@
 #include "Runtime/Core/Public/Misc/FileHelper.h"
 #include "Runtime/Engine/Classes/Kismet/GameplayStatics.h"
 
-#include "Dom/JsonObject.h"
-#include "Dom/JsonValue.h"
-#include "Policies/CondensedJsonPrintPolicy.h"
-#include "Serialization/JsonSerializer.h"
 
 IMPLEMENT_MODULE(FAnalyticsMetricsServiceModule, MetricsServiceProvider)
 
@@ -37,6 +38,23 @@ namespace
 	// The maximum number of seconds we will try to retry inside of.
 	const uint32 RetryLimitTime = 60;
 
+	// Defaults for the memory cap and spool size, overridden by -telemetryMaxInFlightKB= and -telemetrySpoolMaxMB=.
+	const int32 DefaultMaxInFlightKB = 4 * 1024;
+	const int32 DefaultSpoolMaxMB = 64;
+
+	// How often we retry an endpoint that's failing, with one spooled batch or, without a spool, one live batch. The interval
+	// doubles with each failed probe up to the max, and resets once a request succeeds.
+	const double EndpointProbeIntervalSeconds = 10.0;
+	const double MaxEndpointProbeIntervalSeconds = 5.0 * 60.0;
+
+	// 4xx responses other than these mean the batch itself was rejected, retrying it can't help.
+	bool IsRetryableResponseCode(int32 ResponseCode)
+	{
+		return ResponseCode < 400 || ResponseCode >= 500 || ResponseCode == EHttpResponseCodes::RequestTimeout || ResponseCode == EHttpResponseCodes::TooManyRequests;
+	}
+
+	const FString TelemetryEventsMetricName = TEXT("telemetry_events");
+
 	void ConvertFromPascalToCamelCase(FString& Input)
 	{
 		if (Input.Len() == 0)
@@ -47,26 +65,26 @@ namespace
 		Input[0] = Input.Left(1).ToLower().GetCharArray()[0];
 	}
 
-	static FString GetEventSource()
+	static const TCHAR* GetEventSource()
 	{
 #if WITH_EDITOR
-		return "editor";
+		return TEXT("editor");
 #else
 		if (GWorld != nullptr)
 		{
 			switch (GWorld->GetNetMode())
 			{
 			case NM_Client:
-				return "client";
+				return TEXT("client");
 			case NM_Standalone:
-				return "standalone";
+				return TEXT("standalone");
 			default:
-				return "server";
+				return TEXT("server");
 			}
 		}
 		// If we don't have a world, we are neither client or server
 		// so standalone makes the most sense(and can be the case on client shutdown)
-		return "standalone";
+		return TEXT("standalone");
 #endif
 	}
 }
@@ -104,7 +122,7 @@ TSharedPtr<IAnalyticsProvider> FAnalyticsMetricsServiceModule::CreateAnalyticsPr
 	return FAnalyticsProviderMetrics::Create(Key, ApiEndpoint, BinaryKey, BinaryEndpoint, BatchSize, MaxAge);
 }
 
-FAnalyticsProviderMetrics::FAnalyticsProviderMetrics(const FString& Key, const FString& ApiEndpoint, const FString& BinaryKey, const FString& BinaryEndpoint, const int32 BatchSize, const float FlushPeriod) :
+FAnalyticsProviderMetrics::FAnalyticsProviderMetrics(const FString& Key, const FString& ApiEndpoint, const FString& BinaryKey, const FString& BinaryEndpoint, const int32 BatchSize, const float FlushPeriod, bool bIsolated) :
 	ApiKey(Key),
 	BinaryApiKey(BinaryKey),
 	EndPointURL(ApiEndpoint),
@@ -120,12 +138,48 @@ FAnalyticsProviderMetrics::FAnalyticsProviderMetrics(const FString& Key, const F
 
 	Http = &FHttpModule::Get();
 
-	Prometheus = MakeShared<FPrometheusServer>();
-	Prometheus->Initialize();
+	// Servers with a binary endpoint configured send the compact encoding, everyone else keeps posting JSON.
+	TelemetryWorker = MakeUnique<FTelemetryWorker>(EventEnvironment, EngineVersion, BatchSizeThreshold, !BinaryEndpointURL.IsEmpty());
+
+	int32 MaxInFlightKB = DefaultMaxInFlightKB;
+	FParse::Value(FCommandLine::Get(), TEXT("telemetryMaxInFlightKB="), MaxInFlightKB);
+	MaxInFlightBytes = static_cast<int64>(FMath::Max(1, MaxInFlightKB)) * 1024;
+	ProbeIntervalSeconds = EndpointProbeIntervalSeconds;
+
+	FString SpoolPath;
+	if (!bIsolated && (FParse::Value(FCommandLine::Get(), TEXT("telemetrySpool="), SpoolPath) || FParse::Param(FCommandLine::Get(), TEXT("telemetrySpool"))))
+	{
+		if (SpoolPath.IsEmpty())
+		{
+			SpoolPath = FPaths::ProjectSavedDir() / TEXT("Telemetry") / TEXT("TelemetrySpool.bin");
+		}
+		int32 SpoolMaxMB = DefaultSpoolMaxMB;
+		FParse::Value(FCommandLine::Get(), TEXT("telemetrySpoolMaxMB="), SpoolMaxMB);
+		// Compaction copies the file on the worker, which outlives the spool.
+		FTelemetryWorker* Worker = TelemetryWorker.Get();
+		Spool = MakeUnique<FTelemetrySpool>(SpoolPath, static_cast<int64>(FMath::Max(1, SpoolMaxMB)) * 1024 * 1024,
+			[Worker](TUniqueFunction<void()>&& Task) { Worker->RunTask(MoveTemp(Task)); });
+	}
+
+	Prometheus = MakeShared<FPrometheusServer, ESPMode::ThreadSafe>();
+	if (!bIsolated)
+	{
+		Prometheus->Initialize();
+	}
+
+	Sampler = MakeUnique<FTelemetrySampler>(Prometheus);
 
 	DeltaSecondsSinceFlush = 0.0f;
 
-	TelemetryReported = Prometheus->GetMetric(TEXT("telemetry_events"), TArray<FPrometheusLabel>{});
+	TelemetryReported = Prometheus->GetMetric(TelemetryEventsMetricName, TArray<FPrometheusLabel>{});
+	TelemetrySent = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("sent")) });
+	TelemetrySpooled = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("spooled")) });
+	TelemetryReplayed = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("replayed")) });
+	TelemetryDroppedQueueFull = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("dropped")), FPrometheusLabel(TEXT("reason"), TEXT("queue_full")) });
+	TelemetryDroppedMemoryCap = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("dropped")), FPrometheusLabel(TEXT("reason"), TEXT("memory_cap")) });
+	TelemetryDroppedRequestFailed = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("dropped")), FPrometheusLabel(TEXT("reason"), TEXT("request_failed")) });
+	TelemetryDroppedEndpointDown = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("dropped")), FPrometheusLabel(TEXT("reason"), TEXT("endpoint_down")) });
+	TelemetryDroppedRejected = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("dropped")), FPrometheusLabel(TEXT("reason"), TEXT("rejected")) });
 
 	TelemetryClassEvent(TEXT("session"), TEXT("Metrics Started"), ProfileId);
 }
@@ -137,12 +191,25 @@ FAnalyticsProviderMetrics::~FAnalyticsProviderMetrics()
 		EndSession();
 	}
 	TelemetryClassEvent(TEXT("session"), TEXT("Metrics Destructed"), ProfileId);
+
+	// Wait for everything still queued to be serialized so the last events still go out.
+	TelemetryWorker->Shutdown();
+	PostTelemetryBatches();
 }
 
 bool FAnalyticsProviderMetrics::Tick(float DeltaSeconds)
 {
 	HttpRetryManager->Update();
 
+	if (Spool.IsValid())
+	{
+		Spool->Tick();
+	}
+	PostTelemetryBatches();
+	ReplaySpool();
+
+	Prometheus->Tick();
+
 	DeltaSecondsSinceFlush += DeltaSeconds;
 	if (DeltaSecondsSinceFlush >= FlushPeriodThresholdSeconds)
 	{
@@ -175,6 +242,7 @@ bool FAnalyticsProviderMetrics::StartSession(const TArray<FAnalyticsEventAttribu
 		// Set the sessionID here so that SessionStart comes with an ID.
 		// SetSessionID can still be used to set a new one.
 		SessionId = FGuid::NewGuid().ToString(EGuidFormats::DigitsWithHyphens);
+		SessionDetailsCache.Reset();
 		TelemetryClassEvent(TEXT("session"), TEXT("SessionStart"), ProfileId, Attributes);
 		UE_LOG(LogAnalytics, Display, TEXT("Metrics::StartSession(%d attributes)"), Attributes.Num());
 		bHasSessionStarted = true;
@@ -182,18 +250,60 @@ bool FAnalyticsProviderMetrics::StartSession(const TArray<FAnalyticsEventAttribu
 	return bHasSessionStarted;
 }
 
-void FAnalyticsProviderMetrics::HandleResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful) const
+void FAnalyticsProviderMetrics::HandleResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful, int32 NumEvents, bool bFromSpool)
 {
+	InFlightBytes -= Request->GetContentLength();
+	if (bFromSpool)
+	{
+		bReplayInFlight = false;
+	}
+
 	if (!bWasSuccessful)
 	{
 		UE_LOG(LogAnalytics, Warning, TEXT("Request failed to access %s"), *Request->GetURL());
+	}
+	else if (!IsRetryableResponseCode(Response->GetResponseCode()))
+	{
+		// The endpoint is up and answered, it just won't take this batch. Drop it rather than letting it block the spool.
+		UE_LOG(LogAnalytics, Warning, TEXT("Telemetry batch of %d events rejected (%d): %s"), NumEvents, Response->GetResponseCode(), *Response->GetContentAsString());
+		MarkEndpointHealthy();
+		if (bFromSpool && Spool.IsValid())
+		{
+			Spool->Pop();
+		}
+		TelemetryDroppedRejected.Increment(NumEvents);
 		return;
 	}
-
-	if (Response->GetResponseCode() != 200)
+	else if (!EHttpResponseCodes::IsOk(Response->GetResponseCode()))
 	{
 		UE_LOG(LogAnalytics, Warning, TEXT("Couldn't store the data: %s"), *Response->GetContentAsString());
 	}
+	else
+	{
+		MarkEndpointHealthy();
+		TelemetrySent.Increment(NumEvents);
+		if (bFromSpool && Spool.IsValid())
+		{
+			Spool->Pop();
+			TelemetryReplayed.Increment(NumEvents);
+		}
+		return;
+	}
+
+	// Retries are exhausted by the time we get here, so the endpoint is down rather than having a blip. Back off further each time
+	// a probe fails.
+	if (!bEndpointHealthy)
+	{
+		ProbeIntervalSeconds = FMath::Min(ProbeIntervalSeconds * 2.0, MaxEndpointProbeIntervalSeconds);
+	}
+	bEndpointHealthy = false;
+	NextProbeTime = FPlatformTime::Seconds() + ProbeIntervalSeconds;
+
+	// Spooled batches stay in the spool until they're delivered.
+	if (!bFromSpool)
+	{
+		SpoolOrDropBatch(Request->GetContent(), NumEvents, TelemetryDroppedRequestFailed);
+	}
 }
 
 void FAnalyticsProviderMetrics::EndSession()
@@ -209,51 +319,136 @@ void FAnalyticsProviderMetrics::EndSession()
 }
 
 void FAnalyticsProviderMetrics::FlushEvents()
+{
+	// The worker serializes whatever it has, the body is posted by a later Tick() (or right away if it's already done).
+	TelemetryWorker->RequestFlush();
+	PostTelemetryBatches();
+}
+
+void FAnalyticsProviderMetrics::PostTelemetryBatches()
 {
 	if (!Http)
 	{
 		UE_LOG(LogAnalytics, Warning, TEXT("No http found, trying to creating one"));
 		Http = &FHttpModule::Get();
 	}
-	if (EventPayloads.Num() == 0)
-	{
-		return;
-	}
 	if (GIsAutomationTesting)
 	{
-		UE_LOG(LogAnalytics, Log, TEXT("Skipping Event submission while running in automation tests"));
+		// Leave the batches queued, they go out once the tests are done.
 		return;
 	}
 
-	// Don't send request if didn't set EndPointURL.
-	if (!EndPointURL.IsEmpty())
+	FTelemetryBatch Batch;
+	while (TelemetryWorker->DequeueBatch(Batch))
 	{
-		FAnalyticsProviderMetrics::HttpRequest Request = CreateRequest();
+		// Don't send request if didn't set EndPointURL.
+		if (GetEndpointURL(Batch.Content).IsEmpty())
+		{
+			continue;
+		}
+
+		if (!bEndpointHealthy)
+		{
+			// Without anything spooled to replay, a live batch has to be the probe or we'd never find out the endpoint is back.
+			if ((!Spool.IsValid() || Spool->IsEmpty()) && FPlatformTime::Seconds() >= NextProbeTime)
+			{
+				NextProbeTime = FPlatformTime::Seconds() + ProbeIntervalSeconds;
+				PostTelemetryBatch(Batch.Content, Batch.NumEvents, false);
+				continue;
+			}
+			SpoolOrDropBatch(Batch.Content, Batch.NumEvents, TelemetryDroppedEndpointDown);
+			continue;
+		}
 
-		const FString ContentString = GetStringifiedPayloads();
-		Request->SetURL(EndPointURL + "&session_id=" + SessionId + "&key=" + ApiKey);
-		Request->SetVerb("POST");
-		Request->SetHeader(TEXT("User-Agent"), "X-UnrealEngine-Agent");
-		Request->SetHeader("Content-Type", TEXT("application/json"));
-		Request->SetContentAsString(ContentString);
-		Request->ProcessRequest();
+		if (InFlightBytes + Batch.Content.Num() > MaxInFlightBytes)
+		{
+			SpoolOrDropBatch(Batch.Content, Batch.NumEvents, TelemetryDroppedMemoryCap);
+			continue;
+		}
+
+		PostTelemetryBatch(Batch.Content, Batch.NumEvents, false);
 	}
-	
-	EventPayloads.Empty();
 }
 
-FString FAnalyticsProviderMetrics::GetStringifiedPayloads() const
+void FAnalyticsProviderMetrics::PostTelemetryBatch(const TArray<uint8>& Content, int32 NumEvents, bool bFromSpool)
 {
-	FString Payload = TEXT("[");
-	const int32 NumberOfEvents = EventPayloads.Num();
-	const int32 MaxEnentIndex = NumberOfEvents - 1;
-	for (int32 Index = 0; Index <= MaxEnentIndex; ++Index)
+	FAnalyticsProviderMetrics::HttpRequest Request = CreateRequest();
+
+	const bool bBinary = FTelemetryBinaryEncoder::IsBinaryBatch(Content);
+	Request->SetURL(GetEndpointURL(Content) + "&session_id=" + SessionId + "&key=" + (bBinary ? BinaryApiKey : ApiKey));
+	Request->SetVerb("POST");
+	Request->SetHeader(TEXT("User-Agent"), "X-UnrealEngine-Agent");
+	Request->SetHeader("Content-Type", bBinary ? TEXT("application/octet-stream") : TEXT("application/json"));
+	Request->SetContent(Content);
+
+	// Requests can outlive us on shutdown, so don't bind to this directly.
+	TWeakPtr<FAnalyticsProviderMetrics> WeakThis(MetricsProvider);
+	Request->OnProcessRequestComplete().BindLambda([WeakThis, NumEvents, bFromSpool](FHttpRequestPtr InRequest, FHttpResponsePtr InResponse, bool bWasSuccessful) {
+		if (TSharedPtr<FAnalyticsProviderMetrics> This = WeakThis.Pin())
+		{
+			This->HandleResponse(InRequest, InResponse, bWasSuccessful, NumEvents, bFromSpool);
+		}
+	});
+
+	InFlightBytes += Content.Num();
+	Request->ProcessRequest();
+}
+
+const FString& FAnalyticsProviderMetrics::GetEndpointURL(const TArray<uint8>& Content) const
+{
+	return FTelemetryBinaryEncoder::IsBinaryBatch(Content) ? BinaryEndpointURL : EndPointURL;
+}
+
+void FAnalyticsProviderMetrics::SpoolOrDropBatch(const TArray<uint8>& Content, int32 NumEvents, const FPrometheusMetricHandle& DroppedCounter)
+{
+	if (Spool.IsValid() && Spool->Append(Content, NumEvents))
+	{
+		TelemetrySpooled.Increment(NumEvents);
+		return;
+	}
+
+	UE_LOG(LogAnalytics, Verbose, TEXT("Dropping telemetry batch of %d events"), NumEvents);
+	DroppedCounter.Increment(NumEvents);
+}
+
+void FAnalyticsProviderMetrics::ReplaySpool()
+{
+	if (!Spool.IsValid() || Spool->IsEmpty() || bReplayInFlight || GIsAutomationTesting)
 	{
-		const MetricsPayload& CurrentEvent = EventPayloads[Index];
-		Payload += CurrentEvent.Stringify();
-		Payload += Index == MaxEnentIndex ? TEXT("]") : TEXT(",");
+		return;
 	}
-	return Payload;
+
+	// One batch at a time. While the endpoint is failing that batch doubles as the health probe.
+	if (!bEndpointHealthy && FPlatformTime::Seconds() < NextProbeTime)
+	{
+		return;
+	}
+	if (InFlightBytes >= MaxInFlightBytes)
+	{
+		return;
+	}
+
+	TArray<uint8> Content;
+	int32 NumEvents = 0;
+	if (Spool->Peek(Content, NumEvents))
+	{
+		// Spooled by a run that had the other endpoint configured, there's nowhere to send it.
+		if (GetEndpointURL(Content).IsEmpty())
+		{
+			Spool->Pop();
+			TelemetryDroppedRequestFailed.Increment(NumEvents);
+			return;
+		}
+
+		bReplayInFlight = true;
+		PostTelemetryBatch(Content, NumEvents, true);
+	}
+}
+
+void FAnalyticsProviderMetrics::MarkEndpointHealthy()
+{
+	bEndpointHealthy = true;
+	ProbeIntervalSeconds = EndpointProbeIntervalSeconds;
 }
 
 void FAnalyticsProviderMetrics::SetUserID(const FString& InUserID)
@@ -298,6 +493,7 @@ bool FAnalyticsProviderMetrics::SetSessionID(const FString& InSessionID)
 	TArray<FAnalyticsEventAttribute> Attributes{};
 	const FAnalyticsEventAttribute OldIdAttribute = FAnalyticsEventAttribute(TEXT("OldSessionId"), SessionId);
 	SessionId = InSessionID;
+	SessionDetailsCache.Reset();
 
 	const FAnalyticsEventAttribute NewIdAttribute = FAnalyticsEventAttribute(TEXT("NewSessionId"), InSessionID);
 	Attributes.Add(OldIdAttribute);
@@ -345,7 +541,7 @@ void FAnalyticsProviderMetrics::RecordEvent(const FString& EventName, const TArr
 }
 
 // Adds accountid/profileid/client and server session id details as appropriate.
-void FAnalyticsProviderMetrics::AugmentPayloadWithSessionDetails(MetricsPayload& PayloadData, const FString& EventProfileID)
+void FAnalyticsProviderMetrics::AugmentPayloadWithSessionDetails(FTelemetrySessionDetails& PayloadData, const FString& EventProfileID)
 {
 	auto AugmentClientDetailsFromProfile = [&PayloadData, this](const FString& ProfileID) {
 		// If we have profile info, we will add it.  We cache this information when we select a profile.
@@ -406,31 +602,61 @@ void FAnalyticsProviderMetrics::AugmentPayloadWithSessionDetails(MetricsPayload&
 	}
 }
 
-void FAnalyticsProviderMetrics::TelemetryClassEvent(const FString& EventClass, const FString& EventName, const FString& EventProfileID, const TArray<FAnalyticsEventAttribute>& Attributes /* = {} */)
+TSharedPtr<const FTelemetrySessionDetails, ESPMode::ThreadSafe> FAnalyticsProviderMetrics::GetSessionDetails(const FString& EventProfileID)
 {
-	++EventId;
-	MetricsPayload PayloadData;
+	// Which details apply depends on the net mode, so start over whenever it changes.
+	const ENetMode NetMode = GWorld != nullptr ? GWorld->GetNetMode() : NM_MAX;
+	if (NetMode != SessionDetailsNetMode)
+	{
+		SessionDetailsCache.Reset();
+		SessionDetailsNetMode = NetMode;
+	}
 
-	PayloadData.WorkerID = WorkerId;
+	if (const TSharedPtr<const FTelemetrySessionDetails, ESPMode::ThreadSafe>* Existing = SessionDetailsCache.Find(EventProfileID))
+	{
+		return *Existing;
+	}
 
-	PayloadData.EventType = EventName;
-	PayloadData.EventIndex = EventId;
-	PayloadData.EventAttributes = Attributes;
-	PayloadData.EngineVersion = EngineVersion;
-	PayloadData.EventEnvironment = EventEnvironment;
-	PayloadData.EventClass = EventClass;
+	TSharedRef<FTelemetrySessionDetails, ESPMode::ThreadSafe> Details = MakeShared<FTelemetrySessionDetails, ESPMode::ThreadSafe>();
+	Details->WorkerID = WorkerId;
+	AugmentPayloadWithSessionDetails(*Details, EventProfileID);
 
-	AugmentPayloadWithSessionDetails(PayloadData, EventProfileID);
+	return SessionDetailsCache.Add(EventProfileID, Details);
+}
+
+bool FAnalyticsProviderMetrics::ShouldRecordEvent(EMetricsClass EventClass, float& OutSampleRate)
+{
+	return Sampler->ShouldRecord(EventClass, OutSampleRate);
+}
+
+void FAnalyticsProviderMetrics::TelemetryClassEvent(const FString& EventClass, const FString& EventName, const FString& EventProfileID, const TArray<FAnalyticsEventAttribute>& Attributes /* = {} */, float SampleRate /* = 1.0f */)
+{
+	++EventId;
+	FTelemetryEvent Event;
+
+	Event.EventType = EventName;
+	Event.EventIndex = EventId;
+	Event.EventAttributes = Attributes;
+	Event.EventClass = EventClass;
+	Event.SessionDetails = GetSessionDetails(EventProfileID);
+	Event.SampleRate = SampleRate;
 
 	// EventSource changes as you navigate from the main screen through to connecting to a server, so
-	PayloadData.EventSource = GetEventSource();
-	PayloadData.EventTimestamp = FDateTime::UtcNow().ToUnixTimestamp();
+	Event.EventSource = GetEventSource();
+	Event.EventTimestamp = FDateTime::UtcNow().ToUnixTimestamp();
 
-	EventPayloads.Add(PayloadData);
-	if (EventPayloads.Num() >= BatchSizeThreshold)
+	if (!TelemetryWorker->Enqueue(MoveTemp(Event)))
 	{
-		FlushEvents();
+		TelemetryDroppedQueueFull.Increment(1);
+		if (!bHasWarnedQueueFull)
+		{
+			UE_LOG(LogAnalytics, Warning, TEXT("Telemetry queue is full (%u events), dropping events until it drains"), FTelemetryWorker::QueueCapacity);
+			bHasWarnedQueueFull = true;
+		}
+		return;
 	}
+	bHasWarnedQueueFull = false;
+
 	if (TelemetryReported.IsValid())
 	{
 		TelemetryReported->Increment(1);
@@ -554,42 +780,8 @@ void FAnalyticsProviderMetrics::RecordProgress(const FString& ProgressType, cons
 	UE_LOG(LogAnalytics, Display, TEXT("Metrics::RecordProgress('%s', %s, %d)"), *ProgressType, *ProgressHierarchy, Attributes.Num());
 }
 
-FString FAnalyticsProviderMetrics::MetricsPayload::Stringify() const
-{
-	TSharedRef<FJsonObject> Obj = MakeShared<FJsonObject>();
-	TSharedRef<FJsonObject> Attributes = MakeShared<FJsonObject>();
-
-	Obj->SetStringField(TEXT("eventEnvironment"), EventEnvironment);
-	Obj->SetStringField(TEXT("eventSource"), EventSource);
-	Obj->SetStringField(TEXT("eventClass"), EventClass);
-	Obj->SetStringField(TEXT("eventType"), EventType);
-	Obj->SetNumberField(TEXT("eventTimestamp"), EventTimestamp);
-	Obj->SetNumberField(TEXT("eventIndex"), EventIndex);
-
-	Obj->SetStringField(TEXT("versionId"), EngineVersion);
-
-	auto EmptyCheckToSetField = [Obj](const FString& CheckID, const FString& SetField) {
-		if (!CheckID.IsEmpty())
-		{
-			Obj->SetStringField(SetField, CheckID);
-		}
-	};
-
-	// If ID not empty, set the field to Obj
-	EmptyCheckToSetField(AccountID, TEXT("accountId"));
-	EmptyCheckToSetField(ProfileID, TEXT("profileId"));
-	EmptyCheckToSetField(ServerSessionID, TEXT("serverSessionId"));
-	EmptyCheckToSetField(ClientSessionID, TEXT("clientSessionId"));
-	EmptyCheckToSetField(WorkerID, TEXT("workerId"));
-
-	FString Output;
-	TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> JsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Output);
-	FJsonSerializer::Serialize(Obj, JsonWriter);
-
-	return Output;
-}
-
 void FAnalyticsProviderMetrics::CacheProfileDetails(const FString& ProfileID, const FString& AccountID, const FString& ClientSessionID)
 {
 	CachedProfileDetails.Emplace(ProfileID, FProfileDetails{ AccountID, ClientSessionID });
+	SessionDetailsCache.Reset();
 }
@@ -4,16 +4,21 @@
 #include "Runtime/Online/HTTP/Public/Http.h"
 
 #include "Containers/Ticker.h"
+#include "Engine/EngineBaseTypes.h"
 #include "HttpRetrySystem.h"
 #include "Interfaces/IAnalyticsProvider.h"
 #include "PrometheusServer.h"
 #include "Runtime/Launch/Resources/Version.h"
+#include "TelemetrySampler.h"
+#include "TelemetrySpool.h"
+#include "TelemetryWorker.h"
 
 class METRICSSERVICEPROVIDER_API FAnalyticsProviderMetrics : public IAnalyticsProvider, public FTickerObjectBase
 {
 #if WITH_DEV_AUTOMATION_TESTS
 	friend class FMetricsBlueprintLibrarySpec;
 	friend class UTelemetryAssertionComponent;
+	friend class FMetricsTelemetryBenchmark;
 #endif	  // WITH_DEV_AUTOMATION_TESTS
 	friend class UMetricsBlueprintLibrary;
 
@@ -64,9 +69,12 @@ public:
 	virtual void RecordError(const FString& Error, const TArray<FAnalyticsEventAttribute>& EventAttrs) override;
 	virtual void RecordProgress(const FString& ProgressType, const FString& ProgressHierarchy, const TArray<FAnalyticsEventAttribute>& EventAttrs) override;
 
-	void HandleResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful) const;
+	void HandleResponse(FHttpRequestPtr Request, FHttpResponsePtr Response, bool bWasSuccessful, int32 NumEvents, bool bFromSpool);
 
-	void TelemetryClassEvent(const FString& EventClass, const FString& EventName, const FString& EventProfileID, const TArray<FAnalyticsEventAttribute>& Attributes = {});
+	void TelemetryClassEvent(const FString& EventClass, const FString& EventName, const FString& EventProfileID, const TArray<FAnalyticsEventAttribute>& Attributes = {}, float SampleRate = 1.0f);
+
+	// Per class sampling and rate limiting. Call before building the event, SampleRate is then passed to TelemetryClassEvent().
+	bool ShouldRecordEvent(EMetricsClass EventClass, float& OutSampleRate);
 
 	void CacheProfileDetails(const FString& ProfileID, const FString& AccountID, const FString& ClientSessionID);
 
@@ -93,7 +101,9 @@ private:
 	/** Singleton for our extra features */
 	static TSharedPtr<FAnalyticsProviderMetrics> MetricsProvider;
 
-	FAnalyticsProviderMetrics(const FString& Key, const FString& ApiEndpoint, const FString& BinaryApiKey, const FString& BinaryEndpointURL, const int32 BatchSizeThreshold, const float MaxAgeThreshold);
+	// Isolated providers, such as the benchmarks' own, don't bind the Prometheus route or open the telemetry spool. Those belong to
+	// the live provider.
+	FAnalyticsProviderMetrics(const FString& Key, const FString& ApiEndpoint, const FString& BinaryApiKey, const FString& BinaryEndpointURL, const int32 BatchSizeThreshold, const float MaxAgeThreshold, bool bIsolated = false);
 
 	FHttpModule* Http;
 
@@ -105,8 +115,6 @@ private:
 
 	const int32 BatchSizeThreshold;
 
-	FString GetStringifiedPayloads() const;
-
 	const FString EngineVersion;
 
 	const FString EventEnvironment;
@@ -124,6 +132,12 @@ private:
 
 	TMap<const FString, const FProfileDetails> CachedProfileDetails;
 
+	// Session details per event profile ID, shared by every event until the session, net mode or cached profiles change.
+	TMap<FString, TSharedPtr<const FTelemetrySessionDetails, ESPMode::ThreadSafe>> SessionDetailsCache;
+	ENetMode SessionDetailsNetMode = NM_MAX;
+
+	TSharedPtr<const FTelemetrySessionDetails, ESPMode::ThreadSafe> GetSessionDetails(const FString& EventProfileID);
+
 	TSharedPtr<class FHttpRetrySystem::FManager> HttpRetryManager;
 #if ENGINE_MINOR_VERSION >= 26
 	using HttpRequest = TSharedRef<IHttpRequest, ESPMode::ThreadSafe>;
@@ -132,87 +146,47 @@ private:
 #endif
 	HttpRequest CreateRequest();
 
-	TSharedPtr<FPrometheusServer> Prometheus;
-	TSharedPtr<FPrometheusMetric> TelemetryReported;
-
-	/**
-	 * Payload data based on schema defined here: https://docs.google.com/spreadsheets/d/1W_G1DxjpJW1aFGAr_kmPiSOVeo_ygb9GdhMhKf2HJW8/edit#gid=0
-	 */
-	struct MetricsPayload
-	{
-		/**
-		 *  Event Environment e.g(development, staging, production)
-		 */
-		FString EventEnvironment = TEXT("Not set");
-		/**
-		 *  Increments by one after any event has been gathered. This will allow us to spot missing data.
-		 */
-		int32 EventIndex = 0;
-
-		/**
-		 * Denotes the source of the event, which can be either client or server side.
-		 */
-		FString EventSource = TEXT("Not set");
-
-		/**
-		 *  A higher order mnemonic classification of events (e.g. session).
-		 */
-		FString EventClass = TEXT("session");
-
-		/**
-		 *  A mnemonic event identifier (e.g. session_start).
-		 */
-		FString EventType = TEXT("Not set");
-
-		/**
-		 *  The ServerSessionID, which is unique per server instance
-		 */
-		FString ServerSessionID = TEXT("");
-
-		/**
-		 *  The ClientSessionID, which is unique per player session.
-		 */
-		FString ClientSessionID = TEXT("");
-
-		/**
-		 *   Version of the build
-		 */
-		FString EngineVersion = TEXT("TestGyms");
-
-		/**
-		 * Unix time the event occurred
-		 */
-		int32 EventTimestamp = 0;
-
-		/**
-		 * The AccountID of who reported the event(the real person)
-		 */
-		FString AccountID = TEXT("");
-
-		/**
-		 * The ProfileID of the player who reported the event(the character in game)
-		 */
-		FString ProfileID = TEXT("");
-
-		/**
-		 * The WorkerID the event was reported on.
-		 */
-		FString WorkerID = TEXT("");
-
-		/**
-		 *  Attribute data of the event
-		 */
-		TArray<FAnalyticsEventAttribute> EventAttributes;
-
-		FString Stringify() const;
-
-		MetricsPayload()
-		{
-			EventAttributes = TArray<FAnalyticsEventAttribute>();
-		}
-	};
-
-	TArray<MetricsPayload> EventPayloads;
-
-	void AugmentPayloadWithSessionDetails(MetricsPayload& PayloadData, const FString& EventProfileID);
+	TSharedPtr<FPrometheusServer, ESPMode::ThreadSafe> Prometheus;
+	TSharedPtr<FPrometheusMetric, ESPMode::ThreadSafe> TelemetryReported;
+
+	// Extra series in the telemetry_events family, counting events rather than requests.
+	FPrometheusMetricHandle TelemetrySent;
+	FPrometheusMetricHandle TelemetrySpooled;
+	FPrometheusMetricHandle TelemetryReplayed;
+	FPrometheusMetricHandle TelemetryDroppedQueueFull;
+	FPrometheusMetricHandle TelemetryDroppedMemoryCap;
+	FPrometheusMetricHandle TelemetryDroppedRequestFailed;
+	FPrometheusMetricHandle TelemetryDroppedEndpointDown;
+	FPrometheusMetricHandle TelemetryDroppedRejected;
+
+	// Serializes batches off the game thread, we only post the finished bodies.
+	TUniquePtr<FTelemetryWorker> TelemetryWorker;
+	bool bHasWarnedQueueFull = false;
+
+	void PostTelemetryBatches();
+	void PostTelemetryBatch(const TArray<uint8>& Content, int32 NumEvents, bool bFromSpool);
+	void SpoolOrDropBatch(const TArray<uint8>& Content, int32 NumEvents, const FPrometheusMetricHandle& DroppedCounter);
+	void ReplaySpool();
+	void MarkEndpointHealthy();
+
+	// Binary batches go to BinaryEndpointURL, JSON ones to EndPointURL.
+	const FString& GetEndpointURL(const TArray<uint8>& Content) const;
+
+	// Bytes handed to the retry manager and not yet completed. Past MaxInFlightBytes new batches are spooled (or dropped).
+	int64 InFlightBytes = 0;
+	int64 MaxInFlightBytes;
+
+	// Set when a request fails, cleared when one succeeds. While unhealthy new batches go straight to the spool (or are dropped
+	// without one) and we only probe the endpoint at NextProbeTime, with a replay or a live batch.
+	bool bEndpointHealthy = true;
+	double NextProbeTime = 0.0;
+	double ProbeIntervalSeconds = 0.0;
+	bool bReplayInFlight = false;
+
+	// Optional, enabled with -telemetrySpool[=Path].
+	TUniquePtr<FTelemetrySpool> Spool;
+
+	TUniquePtr<FTelemetrySampler> Sampler;
+
+	void AugmentPayloadWithSessionDetails(FTelemetrySessionDetails& PayloadData, const FString& EventProfileID);
 };
@@ -0,0 +1,112 @@
+#include "PrometheusExpositionWriter.h"
+
+#include <cstdio>
+
+void FPrometheusExpositionWriter::AppendString(const FString& String)
+{
+	const FTCHARToUTF8 Converted(*String);
+	AppendBytes(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+}
+
+void FPrometheusExpositionWriter::AppendUInt64(uint64 Value)
+{
+	// Digits come out least significant first, so fill a scratch buffer from the back.
+	uint8 Digits[20];
+	int32 Start = UE_ARRAY_COUNT(Digits);
+	do
+	{
+		Digits[--Start] = static_cast<uint8>('0' + Value % 10);
+		Value /= 10;
+	} while (Value != 0);
+
+	AppendBytes(Digits + Start, UE_ARRAY_COUNT(Digits) - Start);
+}
+
+void FPrometheusExpositionWriter::AppendInt64(int64 Value)
+{
+	if (Value < 0)
+	{
+		AppendChar('-');
+		// Negate as unsigned so INT64_MIN doesn't overflow.
+		AppendUInt64(0 - static_cast<uint64>(Value));
+		return;
+	}
+	AppendUInt64(static_cast<uint64>(Value));
+}
+
+void FPrometheusExpositionWriter::AppendDouble(double Value)
+{
+	if (FMath::IsNaN(Value))
+	{
+		AppendLiteral("NaN");
+		return;
+	}
+	if (!FMath::IsFinite(Value))
+	{
+		if (Value > 0.0)
+		{
+			AppendLiteral("+Inf");
+		}
+		else
+		{
+			AppendLiteral("-Inf");
+		}
+		return;
+	}
+
+	// Past this the fixed point path below could overflow, let the C library deal with it.
+	constexpr double FixedPointLimit = 1e15;
+	const double Magnitude = FMath::Abs(Value);
+	if (Magnitude >= FixedPointLimit)
+	{
+		ANSICHAR Scratch[32];
+		const int32 Length = FMath::Min<int32>(snprintf(Scratch, sizeof(Scratch), "%.17g", Value), sizeof(Scratch) - 1);
+		AppendBytes(reinterpret_cast<const uint8*>(Scratch), Length);
+		return;
+	}
+
+	constexpr uint64 FractionScale = 1000000;
+	uint64 Integral = static_cast<uint64>(Magnitude);
+	uint64 Fraction = static_cast<uint64>((Magnitude - static_cast<double>(Integral)) * FractionScale + 0.5);
+	if (Fraction >= FractionScale)
+	{
+		++Integral;
+		Fraction -= FractionScale;
+	}
+
+	if (Value < 0.0 && (Integral != 0 || Fraction != 0))
+	{
+		AppendChar('-');
+	}
+	AppendUInt64(Integral);
+
+	if (Fraction == 0)
+	{
+		return;
+	}
+
+	// Six zero padded digits, minus any trailing zeros.
+	uint8 Digits[6];
+	for (int32 Index = UE_ARRAY_COUNT(Digits) - 1; Index >= 0; --Index)
+	{
+		Digits[Index] = static_cast<uint8>('0' + Fraction % 10);
+		Fraction /= 10;
+	}
+	int32 NumDigits = UE_ARRAY_COUNT(Digits);
+	while (Digits[NumDigits - 1] == '0')
+	{
+		--NumDigits;
+	}
+
+	AppendChar('.');
+	AppendBytes(Digits, NumDigits);
+}
+
+TArray<uint8> FPrometheusExpositionWriter::MakeSeriesPrefix(const FString& Name, const FString& LabelKey)
+{
+	FPrometheusExpositionWriter Writer;
+	Writer.AppendString(Name);
+	Writer.AppendString(LabelKey);
+	Writer.AppendChar(' ');
+	return Writer.Buffer;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Appends Prometheus text exposition straight into a UTF-8 byte buffer.
+//
+// The buffer is reused between scrapes: Reset() keeps the allocation, so once it has grown to the size of a full scrape,
+// serializing doesn't allocate at all.  Numbers are formatted by hand rather than through Printf.
+class FPrometheusExpositionWriter
+{
+public:
+	// Empties the buffer without releasing its memory.
+	void Reset()
+	{
+		Buffer.Reset();
+	}
+
+	void Reserve(int32 NumBytes)
+	{
+		Buffer.Reserve(NumBytes);
+	}
+
+	const TArray<uint8>& GetBuffer() const
+	{
+		return Buffer;
+	}
+
+	// Hands over the buffer without copying it, and reserves a new one of the same size for the next pass.
+	TArray<uint8> TakeBuffer()
+	{
+		const int32 NumBytes = Buffer.Num();
+		TArray<uint8> Taken = MoveTemp(Buffer);
+		Buffer.Reserve(NumBytes);
+		return Taken;
+	}
+
+	void AppendChar(ANSICHAR Char)
+	{
+		Buffer.Add(static_cast<uint8>(Char));
+	}
+
+	void AppendBytes(const uint8* Bytes, int32 NumBytes)
+	{
+		Buffer.Append(Bytes, NumBytes);
+	}
+
+	void AppendBytes(const TArray<uint8>& Bytes)
+	{
+		Buffer.Append(Bytes);
+	}
+
+	// For string literals, e.g. AppendLiteral("# TYPE ").
+	template <int32 N>
+	void AppendLiteral(const ANSICHAR (&Literal)[N])
+	{
+		AppendBytes(reinterpret_cast<const uint8*>(Literal), N - 1);
+	}
+
+	void AppendString(const FString& String);
+
+	void AppendUInt64(uint64 Value);
+	void AppendInt64(int64 Value);
+
+	// Up to 6 decimal places with trailing zeros trimmed, integral values without a fraction, NaN/+Inf/-Inf as Prometheus expects.
+	void AppendDouble(double Value);
+
+	// The UTF-8 bytes for "<Name><LabelKey> ", which is how every sample line of a series starts.  Built once per series.
+	static TArray<uint8> MakeSeriesPrefix(const FString& Name, const FString& LabelKey);
+
+private:
+	TArray<uint8> Buffer;
+};
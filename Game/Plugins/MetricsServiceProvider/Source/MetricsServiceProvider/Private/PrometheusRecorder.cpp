@@ -0,0 +1,408 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+#include "PrometheusRecorder.h"
+
+#include "Analytics.h"
+#include "Async/Async.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+#include "TelemetryBinaryEncoder.h"
+
+#include <limits>
+
+namespace
+{
+	const uint8 RecordingMagic[4] = { 'U', 'M', 'R', '1' };
+
+	// Written for samples a series missed.
+	const double MissingValue = std::numeric_limits<double>::quiet_NaN();
+
+	uint64 ToBits(double Value)
+	{
+		uint64 Bits;
+		FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+		return Bits;
+	}
+
+	double FromBits(uint64 Bits)
+	{
+		double Value;
+		FMemory::Memcpy(&Value, &Bits, sizeof(Value));
+		return Value;
+	}
+
+	// Most significant bit first.
+	class FBitWriter
+	{
+	public:
+		explicit FBitWriter(TArray<uint8>& InOut)
+			: Out(InOut)
+		{
+		}
+
+		void WriteBit(bool bBit)
+		{
+			if (FreeBits == 0)
+			{
+				Out.Add(0);
+				FreeBits = 8;
+			}
+			--FreeBits;
+			if (bBit)
+			{
+				Out.Last() |= 1 << FreeBits;
+			}
+		}
+
+		void WriteBits(uint64 Value, int32 NumBits)
+		{
+			for (int32 Bit = NumBits - 1; Bit >= 0; --Bit)
+			{
+				WriteBit(((Value >> Bit) & 1) != 0);
+			}
+		}
+
+	private:
+		TArray<uint8>& Out;
+		int32 FreeBits = 0;
+	};
+
+	class FBitReader
+	{
+	public:
+		FBitReader(const uint8* InData, int32 InNumBytes)
+			: Data(InData)
+			, NumBits(static_cast<int64>(InNumBytes) * 8)
+		{
+		}
+
+		bool ReadBits(int32 Count, uint64& OutValue)
+		{
+			if (Position + Count > NumBits)
+			{
+				return false;
+			}
+			OutValue = 0;
+			for (int32 Bit = 0; Bit < Count; ++Bit, ++Position)
+			{
+				OutValue = (OutValue << 1) | ((Data[Position >> 3] >> (7 - (Position & 7))) & 1);
+			}
+			return true;
+		}
+
+	private:
+		const uint8* Data;
+		int64 NumBits;
+		int64 Position = 0;
+	};
+}
+
+void FPrometheusRecorder::FBlock::Reset()
+{
+	Timestamps.Reset();
+	for (TArray<double>& Column : Columns)
+	{
+		Column.Reset();
+	}
+	NewSeries.Reset();
+}
+
+FPrometheusRecorder::FPrometheusRecorder(const FString& InFilePath, double InSampleIntervalSeconds, int32 InSamplesPerBlock)
+	: FilePath(InFilePath)
+	, SampleIntervalSeconds(InSampleIntervalSeconds)
+	, SamplesPerBlock(FMath::Max(1, InSamplesPerBlock))
+	, ActiveBlock(MakeShared<FBlock, ESPMode::ThreadSafe>())
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(FilePath));
+
+	FileHandle.Reset(PlatformFile.OpenWrite(*FilePath));
+	if (!FileHandle.IsValid() || !FileHandle->Write(RecordingMagic, UE_ARRAY_COUNT(RecordingMagic)))
+	{
+		UE_LOG(LogAnalytics, Warning, TEXT("Unable to open metric recording %s, nothing will be recorded."), *FilePath);
+		FileHandle.Reset();
+		return;
+	}
+
+	UE_LOG(LogAnalytics, Display, TEXT("Recording metrics every %.0f ms to %s"), SampleIntervalSeconds * 1000.0, *FilePath);
+}
+
+FPrometheusRecorder::~FPrometheusRecorder()
+{
+	Flush();
+	if (PendingWrite.IsValid())
+	{
+		PendingWrite.Wait();
+	}
+	FileHandle.Reset();
+}
+
+bool FPrometheusRecorder::IsSampleDue(double Now)
+{
+	if (Now < NextSampleTime)
+	{
+		return false;
+	}
+
+	// A long hitch shouldn't turn into a burst of back to back samples.
+	NextSampleTime = FMath::Max(NextSampleTime + SampleIntervalSeconds, Now);
+	return true;
+}
+
+int32 FPrometheusRecorder::AddSeries(const FString& SeriesName)
+{
+	ActiveBlock->NewSeries.Emplace(NumSeries, SeriesName);
+	return NumSeries++;
+}
+
+void FPrometheusRecorder::BeginSample(int64 TimestampMS)
+{
+	ActiveBlock->Timestamps.Add(TimestampMS);
+}
+
+void FPrometheusRecorder::RecordValue(int32 SeriesId, double Value)
+{
+	FBlock& Block = *ActiveBlock;
+	if (SeriesId >= Block.Columns.Num())
+	{
+		Block.Columns.SetNum(SeriesId + 1);
+	}
+
+	// Anything this series missed, in this block, is NaN.
+	TArray<double>& Column = Block.Columns[SeriesId];
+	const int32 SampleIndex = Block.Timestamps.Num() - 1;
+	while (Column.Num() < SampleIndex)
+	{
+		Column.Add(MissingValue);
+	}
+	Column.Add(Value);
+}
+
+void FPrometheusRecorder::EndSample()
+{
+	if (ActiveBlock->Timestamps.Num() >= SamplesPerBlock)
+	{
+		Flush();
+	}
+}
+
+void FPrometheusRecorder::Flush()
+{
+	if (ActiveBlock->Timestamps.Num() == 0 && ActiveBlock->NewSeries.Num() == 0)
+	{
+		return;
+	}
+
+	// Only one block is written at a time, the file is appended to in order.  At normal sample rates the previous one finished
+	// long ago, so this doesn't wait.
+	TSharedPtr<FBlock, ESPMode::ThreadSafe> SpareBlock;
+	if (PendingWrite.IsValid())
+	{
+		SpareBlock = PendingWrite.Get();
+		PendingWrite = TFuture<TSharedPtr<FBlock, ESPMode::ThreadSafe>>();
+	}
+	if (!SpareBlock.IsValid())
+	{
+		SpareBlock = MakeShared<FBlock, ESPMode::ThreadSafe>();
+	}
+	SpareBlock->Reset();
+
+	TSharedPtr<FBlock, ESPMode::ThreadSafe> FullBlock = ActiveBlock;
+	ActiveBlock = SpareBlock;
+
+	PendingWrite = Async(EAsyncExecution::ThreadPool, [this, FullBlock]() {
+		WriteBlock(*FullBlock);
+		return FullBlock;
+	});
+}
+
+void FPrometheusRecorder::WriteBlock(const FBlock& Block)
+{
+	if (!FileHandle.IsValid() || bWriteFailed)
+	{
+		return;
+	}
+
+	BlockBytes.Reset();
+
+	FTelemetryBinaryEncoder::WriteVarInt(BlockBytes, Block.NewSeries.Num());
+	for (const TPair<int32, FString>& Series : Block.NewSeries)
+	{
+		const FTCHARToUTF8 Converted(*Series.Value);
+		FTelemetryBinaryEncoder::WriteVarInt(BlockBytes, Series.Key);
+		FTelemetryBinaryEncoder::WriteVarInt(BlockBytes, Converted.Length());
+		BlockBytes.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+	}
+
+	const int32 NumSamples = Block.Timestamps.Num();
+	FTelemetryBinaryEncoder::WriteVarInt(BlockBytes, NumSamples);
+
+	// Samples are close to evenly spaced, so the delta-of-delta is usually 0 or a few ms and fits in a byte.
+	int64 PreviousTimestamp = 0;
+	int64 PreviousDelta = 0;
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		const int64 Timestamp = Block.Timestamps[Index];
+		if (Index == 0)
+		{
+			FTelemetryBinaryEncoder::WriteVarInt(BlockBytes, static_cast<uint64>(Timestamp));
+		}
+		else
+		{
+			const int64 Delta = Timestamp - PreviousTimestamp;
+			FTelemetryBinaryEncoder::WriteVarInt(BlockBytes, FTelemetryBinaryEncoder::ZigZag(Index == 1 ? Delta : Delta - PreviousDelta));
+			PreviousDelta = Delta;
+		}
+		PreviousTimestamp = Timestamp;
+	}
+
+	// Columns are padded here rather than on the game thread.  A copy is only made for the few that are short.
+	int32 NumColumns = 0;
+	ColumnBytes.Reset();
+	TArray<double> Padded;
+	TArray<uint8> Encoded;
+	for (int32 SeriesId = 0; SeriesId < Block.Columns.Num(); ++SeriesId)
+	{
+		const TArray<double>& Column = Block.Columns[SeriesId];
+		if (Column.Num() == 0 || NumSamples == 0)
+		{
+			continue;
+		}
+
+		const TArray<double>* Values = &Column;
+		if (Column.Num() < NumSamples)
+		{
+			Padded = Column;
+			while (Padded.Num() < NumSamples)
+			{
+				Padded.Add(MissingValue);
+			}
+			Values = &Padded;
+		}
+
+		Encoded.Reset();
+		EncodeColumn(*Values, Encoded);
+		FTelemetryBinaryEncoder::WriteVarInt(ColumnBytes, SeriesId);
+		FTelemetryBinaryEncoder::WriteVarInt(ColumnBytes, Encoded.Num());
+		ColumnBytes.Append(Encoded);
+		++NumColumns;
+	}
+	FTelemetryBinaryEncoder::WriteVarInt(BlockBytes, NumColumns);
+	BlockBytes.Append(ColumnBytes);
+
+	TArray<uint8> BlockLength;
+	FTelemetryBinaryEncoder::WriteVarInt(BlockLength, BlockBytes.Num());
+	if (!FileHandle->Write(BlockLength.GetData(), BlockLength.Num()) || !FileHandle->Write(BlockBytes.GetData(), BlockBytes.Num()))
+	{
+		UE_LOG(LogAnalytics, Warning, TEXT("Failed writing metric recording %s, recording stopped."), *FilePath);
+		bWriteFailed = true;
+		return;
+	}
+	FileHandle->Flush();
+}
+
+void FPrometheusRecorder::EncodeColumn(const TArray<double>& Values, TArray<uint8>& Out)
+{
+	if (Values.Num() == 0)
+	{
+		return;
+	}
+
+	FBitWriter Writer(Out);
+	uint64 Previous = ToBits(Values[0]);
+	Writer.WriteBits(Previous, 64);
+
+	int32 PreviousLeading = -1;
+	int32 PreviousTrailing = 0;
+	for (int32 Index = 1; Index < Values.Num(); ++Index)
+	{
+		const uint64 Current = ToBits(Values[Index]);
+		const uint64 Xor = Current ^ Previous;
+		Previous = Current;
+
+		if (Xor == 0)
+		{
+			Writer.WriteBit(false);
+			continue;
+		}
+		Writer.WriteBit(true);
+
+		// Leading zeros are stored in 5 bits.
+		const int32 Leading = FMath::Min<int32>(FPlatformMath::CountLeadingZeros64(Xor), 31);
+		const int32 Trailing = FPlatformMath::CountTrailingZeros64(Xor);
+
+		if (PreviousLeading >= 0 && Leading >= PreviousLeading && Trailing >= PreviousTrailing)
+		{
+			Writer.WriteBit(false);
+			Writer.WriteBits(Xor >> PreviousTrailing, 64 - PreviousLeading - PreviousTrailing);
+		}
+		else
+		{
+			const int32 Meaningful = 64 - Leading - Trailing;
+			Writer.WriteBit(true);
+			Writer.WriteBits(Leading, 5);
+			Writer.WriteBits(Meaningful - 1, 6);
+			Writer.WriteBits(Xor >> Trailing, Meaningful);
+			PreviousLeading = Leading;
+			PreviousTrailing = Trailing;
+		}
+	}
+}
+
+bool FPrometheusRecorder::DecodeColumn(const uint8* Data, int32 NumBytes, int32 NumValues, TArray<double>& OutValues)
+{
+	OutValues.Reset(NumValues);
+	if (NumValues == 0)
+	{
+		return true;
+	}
+
+	FBitReader Reader(Data, NumBytes);
+	uint64 Previous;
+	if (!Reader.ReadBits(64, Previous))
+	{
+		return false;
+	}
+	OutValues.Add(FromBits(Previous));
+
+	int32 PreviousLeading = 0;
+	int32 PreviousTrailing = 0;
+	while (OutValues.Num() < NumValues)
+	{
+		uint64 Changed;
+		if (!Reader.ReadBits(1, Changed))
+		{
+			return false;
+		}
+
+		if (Changed != 0)
+		{
+			uint64 NewWindow;
+			if (!Reader.ReadBits(1, NewWindow))
+			{
+				return false;
+			}
+
+			if (NewWindow != 0)
+			{
+				uint64 Leading;
+				uint64 MeaningfulMinusOne;
+				if (!Reader.ReadBits(5, Leading) || !Reader.ReadBits(6, MeaningfulMinusOne))
+				{
+					return false;
+				}
+				PreviousLeading = static_cast<int32>(Leading);
+				PreviousTrailing = 64 - PreviousLeading - static_cast<int32>(MeaningfulMinusOne + 1);
+			}
+
+			uint64 Bits;
+			if (!Reader.ReadBits(64 - PreviousLeading - PreviousTrailing, Bits))
+			{
+				return false;
+			}
+			Previous ^= Bits << PreviousTrailing;
+		}
+		OutValues.Add(FromBits(Previous));
+	}
+	return true;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "Async/Future.h"
+#include "CoreMinimal.h"
+
+class IFileHandle;
+
+/**
+ * Samples every gauge/counter series at a fixed rate into an in-memory block and appends it to a columnar run file once the block
+ * is full, so post-run analysis sees sub-second behaviour that the 15-30s scrape interval averages away.  Histograms and summaries
+ * aren't recorded, their percentiles are already in the scrape.
+ *
+ * File layout, all integers are unsigned LEB128 varints unless noted:
+ *   "UMR1"                         4 byte magic, once per file
+ *   Blocks, each:
+ *     BlockLength                  bytes that follow, so a reader can skip blocks
+ *     NewSeriesCount, then per series   SeriesId, byte length + UTF-8 "name{labels}".  Ids are only defined once per file.
+ *     SampleCount
+ *     Timestamps                   first in ms since the Unix epoch, then a zigzag delta, then zigzag delta-of-deltas
+ *     ColumnCount, then per column SeriesId, byte length + XOR compressed values (see EncodeColumn)
+ *
+ * A series that's missing from a sample (not updated yet, or evicted) is recorded as NaN.  Series with no samples at all in a
+ * block have no column in it.
+ *
+ * Game thread only.  Encoding and writing happen on the thread pool, one block at a time.
+ */
+class FPrometheusRecorder
+{
+public:
+	FPrometheusRecorder(const FString& InFilePath, double InSampleIntervalSeconds, int32 InSamplesPerBlock);
+	~FPrometheusRecorder();
+
+	FPrometheusRecorder(const FPrometheusRecorder&) = delete;
+	FPrometheusRecorder& operator=(const FPrometheusRecorder&) = delete;
+
+	bool IsSampleDue(double Now);
+
+	// A sample is BeginSample(), then RecordValue() for each live series, then EndSample().
+	void BeginSample(int64 TimestampMS);
+	void RecordValue(int32 SeriesId, double Value);
+	void EndSample();
+
+	// Ids are handed out once and stay valid for the life of the recorder.
+	int32 AddSeries(const FString& SeriesName);
+
+	// Hands the current block to the thread pool, even if it isn't full.
+	void Flush();
+
+	const FString& GetFilePath() const
+	{
+		return FilePath;
+	}
+
+	// Gorilla style XOR compression: the first value as 64 raw bits, then per value a 0 bit if it's unchanged, otherwise the
+	// XOR with the previous value, reusing the previous leading/trailing zero window when it fits.
+	static void EncodeColumn(const TArray<double>& Values, TArray<uint8>& Out);
+	static bool DecodeColumn(const uint8* Data, int32 NumBytes, int32 NumValues, TArray<double>& OutValues);
+
+private:
+	struct FBlock
+	{
+		TArray<int64> Timestamps;
+
+		// Indexed by series id, each as long as Timestamps once the block is closed.
+		TArray<TArray<double>> Columns;
+
+		// Series first seen while this block was being filled.
+		TArray<TPair<int32, FString>> NewSeries;
+
+		void Reset();
+	};
+
+	void WriteBlock(const FBlock& Block);
+
+	FString FilePath;
+	double SampleIntervalSeconds;
+	int32 SamplesPerBlock;
+	double NextSampleTime = 0.0;
+
+	int32 NumSeries = 0;
+
+	TSharedPtr<FBlock, ESPMode::ThreadSafe> ActiveBlock;
+
+	// The block being written returns itself so its columns can be reused for the next one.
+	TFuture<TSharedPtr<FBlock, ESPMode::ThreadSafe>> PendingWrite;
+
+	// Only touched by the write task.
+	TUniquePtr<IFileHandle> FileHandle;
+	TArray<uint8> BlockBytes;
+	TArray<uint8> ColumnBytes;
+	bool bWriteFailed = false;
+};
@@ -1,16 +1,43 @@
 #include "PrometheusServer.h"
 
+#include "PrometheusExpositionWriter.h"
+#include "PrometheusRecorder.h"
+
 #include "HttpServerModule.h"
 #include "HttpServerResponse.h"
 #include "IHttpRouter.h"
 
+#include "Algo/BinarySearch.h"
 #include "Analytics.h"
+#include "Async/Async.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTLS.h"
 #include "Misc/CommandLine.h"
+#include "Misc/Compression.h"
+#include "Misc/ConfigCacheIni.h"
 #include "Misc/DateTime.h"
+#include "Misc/Paths.h"
 #include "Misc/Timespan.h"
 #include "Stats/Stats.h"
 #include "Stats/StatsData.h"
 
+namespace
+{
+	// Series that were registered but never written are dropped after this long.  Ones that have been written are only dropped
+	// for going quiet when -prometheusSeriesIdleMinutes= is set: gauges such as the NFR checks latch a failure and stop being
+	// written, and have to stay scrapeable.
+	const int64 NeverUpdatedTimeoutMS = 30 * 60 * 1000;
+
+	// How often idle series are looked for.
+	const double EvictionIntervalSeconds = 60.0;
+
+	const FString SeriesEvictedMetricName = TEXT("prometheus_series_evicted_total");
+	const FString SeriesCountMetricName = TEXT("prometheus_series");
+
+	// The recorder appends a block to its file this often.
+	const int32 DefaultRecordBlockSeconds = 10;
+}
+
 // Calculated from int64 UnixEpoch = FDateTime(1970, 1, 1).GetTicks();
 constexpr int64 UnixEpochTicks = 621355968000000000;
 
@@ -19,8 +46,142 @@ static int64 UnixTimestampMS(const FDateTime& Time)
 	return (Time.GetTicks() - UnixEpochTicks) / ETimespan::TicksPerMillisecond;
 }
 
+static uint64 DoubleToBits(double Value)
+{
+	static_assert(sizeof(double) == sizeof(uint64), "Metric values are stored as 64 bit patterns");
+	uint64 Bits;
+	FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+	return Bits;
+}
+
+static double BitsToDouble(uint64 Bits)
+{
+	double Value;
+	FMemory::Memcpy(&Value, &Bits, sizeof(Value));
+	return Value;
+}
+
+static void AtomicAddDouble(std::atomic<uint64>& Bits, double Amount)
+{
+	uint64 Expected = Bits.load(std::memory_order_relaxed);
+	while (!Bits.compare_exchange_weak(Expected, DoubleToBits(BitsToDouble(Expected) + Amount), std::memory_order_relaxed))
+	{
+	}
+}
+
+// Adds an extra label to a "{...}" label key, e.g. ({a="b"}, le="0.5") => {a="b",le="0.5"}
+static FString AppendLabel(const FString& LabelKey, const FString& ExtraLabel)
+{
+	if (LabelKey.Len() <= 2)
+	{
+		return TEXT("{") + ExtraLabel + TEXT("}");
+	}
+	return LabelKey.LeftChop(1) + TEXT(",") + ExtraLabel + TEXT("}");
+}
+
+static FString FormatBound(double Value)
+{
+	return FString::SanitizeFloat(Value);
+}
+
+static void CompressSnapshot(FPrometheusSnapshot& Snapshot)
+{
+	int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Gzip, Snapshot.Body.Num());
+	Snapshot.GzipBody.SetNumUninitialized(CompressedSize);
+	if (FCompression::CompressMemory(NAME_Gzip, Snapshot.GzipBody.GetData(), CompressedSize, Snapshot.Body.GetData(), Snapshot.Body.Num()))
+	{
+		Snapshot.GzipBody.SetNum(CompressedSize, false);
+		Snapshot.SpareGzipBody = Snapshot.GzipBody;
+	}
+	else
+	{
+		// The route falls back to the plain body.
+		Snapshot.GzipBody.Empty();
+	}
+}
+
+static bool AcceptsGzip(const FHttpServerRequest& Request)
+{
+	// Codings are comma separated, each with optional ;q= weight. q=0 means "not acceptable", and an explicit gzip entry
+	// overrides a * one either way.
+	float GzipQuality = -1.0f;
+	float WildcardQuality = -1.0f;
+
+	// Header names compare case insensitively as FStrings.
+	if (const TArray<FString>* Encodings = Request.Headers.Find(TEXT("Accept-Encoding")))
+	{
+		for (const FString& Encoding : *Encodings)
+		{
+			TArray<FString> Codings;
+			Encoding.ParseIntoArray(Codings, TEXT(","));
+			for (const FString& Coding : Codings)
+			{
+				TArray<FString> Params;
+				Coding.ParseIntoArray(Params, TEXT(";"));
+				if (Params.Num() == 0)
+				{
+					continue;
+				}
+
+				float Quality = 1.0f;
+				for (int32 Index = 1; Index < Params.Num(); ++Index)
+				{
+					const FString Param = Params[Index].TrimStartAndEnd();
+					if (Param.StartsWith(TEXT("q=")))
+					{
+						Quality = FCString::Atof(*Param.RightChop(2));
+					}
+				}
+
+				const FString Name = Params[0].TrimStartAndEnd();
+				if (Name.Equals(TEXT("gzip"), ESearchCase::IgnoreCase) || Name.Equals(TEXT("x-gzip"), ESearchCase::IgnoreCase))
+				{
+					GzipQuality = Quality;
+				}
+				else if (Name == TEXT("*"))
+				{
+					WildcardQuality = Quality;
+				}
+			}
+		}
+	}
+	return GzipQuality >= 0.0f ? GzipQuality > 0.0f : WildcardQuality > 0.0f;
+}
+
+// Label values may not contain raw backslashes, quotes or newlines.
+static FString EscapeLabelValue(const FString& Value)
+{
+	return Value.Replace(TEXT("\\"), TEXT("\\\\")).Replace(TEXT("\""), TEXT("\\\"")).Replace(TEXT("\n"), TEXT("\\n"));
+}
+
+FPrometheusServer::FPrometheusServer()
+	: ExpositionWriter(MakeUnique<FPrometheusExpositionWriter>())
+#if STATS
+	, StatsWriter(MakeUnique<FPrometheusExpositionWriter>())
+#endif
+{
+}
+
 bool FPrometheusServer::Initialize()
 {
+	// Eviction applies whether or not we're exporting, the series still take up memory.
+	int32 SeriesIdleMinutes = 0;
+	FParse::Value(FCommandLine::Get(), TEXT("prometheusSeriesIdleMinutes="), SeriesIdleMinutes);
+	SeriesIdleTimeoutMS = static_cast<int64>(FMath::Max(0, SeriesIdleMinutes)) * 60 * 1000;
+	FParse::Value(FCommandLine::Get(), TEXT("prometheusMaxSeriesPerName="), MaxSeriesPerName);
+
+	SeriesEvictedIdle = RegisterMetric(SeriesEvictedMetricName, { FPrometheusLabel(TEXT("reason"), TEXT("idle")) });
+	SeriesEvictedCap = RegisterMetric(SeriesEvictedMetricName, { FPrometheusLabel(TEXT("reason"), TEXT("cap")) });
+	SeriesCount = RegisterMetric(SeriesCountMetricName, {});
+
+	// These only move when eviction does, they mustn't be evicted for being quiet.
+	SeriesEvictedIdle.Metric->bEvictable = false;
+	SeriesEvictedCap.Metric->bEvictable = false;
+	SeriesCount.Metric->bEvictable = false;
+
+	// Recording is local, it doesn't need the HTTP route either.
+	ReadRecorderConfig();
+
 	int32 PrometheusPort = -1;
 
 	FParse::Value(FCommandLine::Get(), TEXT("prometheusPort="), PrometheusPort);
@@ -31,9 +192,16 @@ bool FPrometheusServer::Initialize()
 		return true;
 	}
 
+	FParse::Value(FCommandLine::Get(), TEXT("prometheusSnapshotFrames="), SnapshotFrameInterval);
+	SnapshotFrameInterval = FMath::Max(1, SnapshotFrameInterval);
+
+#if STATS
+	ReadStatExportConfig();
+#endif
+
 	Router = FHttpServerModule::Get().GetHttpRouter(PrometheusPort);
 
-	TWeakPtr<FPrometheusServer> WeakThisPtr(AsShared());
+	TWeakPtr<FPrometheusServer, ESPMode::ThreadSafe> WeakThisPtr(AsShared());
 	// Register a handler for /_worker_metrics
 	// Runtime use "_metrics", just in case sometime worker & runtime in same pod.
 	MetricsHandle = Router->BindRoute(FHttpPath("/_worker_metrics"), EHttpServerRequestVerbs::VERB_GET,
@@ -53,11 +221,130 @@ bool FPrometheusServer::Initialize()
 		return false;
 	}
 
+	// Scrapes that arrive before the first Tick() get the header rather than nothing.
+	PublishSnapshot();
+
 	// Make sure our listener has started
 	FHttpServerModule::Get().StartAllListeners();
 	return true;
 }
 
+void FPrometheusServer::Tick()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (Now - LastEvictionTime >= EvictionIntervalSeconds)
+	{
+		LastEvictionTime = Now;
+		EvictIdleSeries();
+	}
+
+	if (Recorder.IsValid() && Recorder->IsSampleDue(Now))
+	{
+		RecordSample();
+	}
+
+	// Nobody can scrape us, don't pay for the serialization.
+	if (Router == nullptr)
+	{
+		return;
+	}
+
+	if (PendingSnapshot.IsValid())
+	{
+		if (!PendingSnapshot.IsReady())
+		{
+			// Still compressing the last one, try again next frame.
+			return;
+		}
+		SetSnapshot(PendingSnapshot.Get());
+		PendingSnapshot = TFuture<TSharedPtr<const FPrometheusSnapshot, ESPMode::ThreadSafe>>();
+	}
+
+	if (++FramesSinceSnapshot < SnapshotFrameInterval)
+	{
+		return;
+	}
+	FramesSinceSnapshot = 0;
+
+	PublishSnapshot();
+}
+
+void FPrometheusServer::ReadRecorderConfig()
+{
+	float RecordHz = 0.0f;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("prometheusRecordHz="), RecordHz) || RecordHz <= 0.0f)
+	{
+		return;
+	}
+
+	// One file per process, several workers can share a machine.
+	FString RecordPath = FPaths::ProjectSavedDir() / TEXT("Metrics") /
+		FString::Printf(TEXT("Metrics_%s_%u.umr"), *FDateTime::Now().ToString(), FPlatformProcess::GetCurrentProcessId());
+	FParse::Value(FCommandLine::Get(), TEXT("prometheusRecordPath="), RecordPath);
+
+	int32 BlockSeconds = DefaultRecordBlockSeconds;
+	FParse::Value(FCommandLine::Get(), TEXT("prometheusRecordBlockSeconds="), BlockSeconds);
+
+	Recorder = MakeUnique<FPrometheusRecorder>(RecordPath, 1.0 / RecordHz, FMath::CeilToInt(RecordHz * FMath::Max(1, BlockSeconds)));
+}
+
+void FPrometheusServer::RecordSample()
+{
+	{
+		FScopeLock Lock(&MetricsLock);
+
+		Recorder->BeginSample(UnixTimestampMS(FDateTime::UtcNow()));
+		for (const auto& Pair : Metrics.Families)
+		{
+			for (const auto& LabelPair : *Pair.Value)
+			{
+				FPrometheusMetric& Metric = *LabelPair.Value;
+				if (!Metric.HasBeenUpdated())
+				{
+					continue;
+				}
+
+				if (Metric.RecorderSeriesId == INDEX_NONE)
+				{
+					Metric.RecorderSeriesId = Recorder->AddSeries(Pair.Key + LabelPair.Key);
+				}
+				Recorder->RecordValue(Metric.RecorderSeriesId, Metric.GetValue());
+			}
+		}
+	}
+
+	// May wait on the previous block's write, so not under the lock.
+	Recorder->EndSample();
+}
+
+void FPrometheusServer::PublishSnapshot()
+{
+	Serialize();
+
+	TSharedRef<FPrometheusSnapshot, ESPMode::ThreadSafe> NewSnapshot = MakeShared<FPrometheusSnapshot, ESPMode::ThreadSafe>();
+	NewSnapshot->Body = ExpositionWriter->GetBuffer();
+
+	if (!bGzipRequested.load(std::memory_order_relaxed))
+	{
+		// The writer's own buffer is the spare, so this costs an allocation rather than a second copy.
+		NewSnapshot->SpareBody = ExpositionWriter->TakeBuffer();
+		SetSnapshot(NewSnapshot);
+		return;
+	}
+
+	// Compressing a few MB is too slow for the game thread. Scrapes keep getting the previous snapshot until this one is ready.
+	PendingSnapshot = Async(EAsyncExecution::ThreadPool, [NewSnapshot]() {
+		CompressSnapshot(*NewSnapshot);
+		return TSharedPtr<const FPrometheusSnapshot, ESPMode::ThreadSafe>(NewSnapshot);
+	});
+}
+
+void FPrometheusServer::SetSnapshot(const TSharedPtr<const FPrometheusSnapshot, ESPMode::ThreadSafe>& NewSnapshot)
+{
+	FScopeLock Lock(&SnapshotLock);
+	Snapshot = NewSnapshot;
+}
+
 FPrometheusServer::~FPrometheusServer()
 {
 	if (Router != nullptr)
@@ -67,67 +354,363 @@ FPrometheusServer::~FPrometheusServer()
 	}
 }
 
-FString FPrometheusServer::Serialize()
+void FPrometheusServer::Serialize()
 {
-	FString Buffer = TEXT("# UE4 worker metrics\n");
-	FString LastName;
-	for (const auto& Pair : Metrics)
+	FScopeLock Lock(&MetricsLock);
+
+	FPrometheusExpositionWriter& Writer = *ExpositionWriter;
+	Writer.Reset();
+
+	Writer.AppendLiteral("# UE4 worker metrics\n");
+	for (const auto& Pair : Metrics.Families)
 	{
-		// Spec wants a gap between unique metric names, so when our metric name changes, add a newline.
-		if (LastName != Pair.Key)
-		{
-			Buffer += "\n";
-		}
+		// Spec wants a gap between unique metric names. Keys are unique, so every name starts a new block.
+		Writer.AppendChar('\n');
 
 		for (const auto& LabelPair : *Pair.Value)
 		{
+			const FPrometheusMetric& Metric = *LabelPair.Value;
+
 			// Skip reporting any entries that have never been updated.
-			if (!LabelPair.Value->HasBeenUpdated())
+			if (!Metric.HasBeenUpdated())
 			{
 				continue;
 			}
 
-			Buffer += Pair.Key + LabelPair.Key + TEXT(" ") + LabelPair.Value->ToString() + "\n";
+			Writer.AppendBytes(Metric.SeriesPrefix);
+			Writer.AppendDouble(Metric.GetValue());
+			Writer.AppendChar('\n');
+		}
+	}
+
+	for (const auto& Pair : Histograms.Families)
+	{
+		Writer.AppendLiteral("\n# TYPE ");
+		Writer.AppendString(Pair.Key);
+		Writer.AppendLiteral(" histogram\n");
+		for (const auto& LabelPair : *Pair.Value)
+		{
+			if (LabelPair.Value->HasBeenUpdated())
+			{
+				LabelPair.Value->Serialize(Writer);
+			}
 		}
+	}
 
-		LastName = Pair.Key;
+	for (const auto& Pair : Summaries.Families)
+	{
+		Writer.AppendLiteral("\n# TYPE ");
+		Writer.AppendString(Pair.Key);
+		Writer.AppendLiteral(" summary\n");
+		for (const auto& LabelPair : *Pair.Value)
+		{
+			if (LabelPair.Value->HasBeenUpdated())
+			{
+				LabelPair.Value->Serialize(Writer);
+			}
+		}
 	}
 
 #if STATS
-	if (const FGameThreadStatsData* ViewData = FLatestGameThreadStatsData::Get().Latest)
+	SerializeStats(Writer);
+#endif
+}
+
+#if STATS
+void FPrometheusServer::ReadStatExportConfig()
+{
+	FString StatPrefixList;
+	if (FParse::Value(FCommandLine::Get(), TEXT("prometheusStats="), StatPrefixList, false))
+	{
+		StatPrefixList.ParseIntoArray(StatPrefixes, TEXT(","));
+	}
+	else if (GConfig != nullptr)
+	{
+		GConfig->GetArray(TEXT("Prometheus"), TEXT("StatPrefixes"), StatPrefixes, GEngineIni);
+	}
+
+	if (!FParse::Value(FCommandLine::Get(), TEXT("prometheusStatsInterval="), StatExportIntervalSeconds) && GConfig != nullptr)
+	{
+		GConfig->GetDouble(TEXT("Prometheus"), TEXT("StatExportIntervalSeconds"), StatExportIntervalSeconds, GEngineIni);
+	}
+
+	for (FString& Prefix : StatPrefixes)
 	{
-		Buffer += "\n";
+		Prefix.TrimStartAndEndInline();
+	}
+	StatPrefixes.RemoveAll([](const FString& Prefix) {
+		return Prefix.IsEmpty();
+	});
+
+	UE_LOG(LogAnalytics, Log, TEXT("Prometheus stat export: %s, refreshed every %.1fs."),
+		StatPrefixes.Num() > 0 ? *FString::Join(StatPrefixes, TEXT(",")) : TEXT("all stats"), StatExportIntervalSeconds);
+}
+
+void FPrometheusServer::SerializeStats(FPrometheusExpositionWriter& Writer)
+{
+	const double Now = FPlatformTime::Seconds();
+	const bool bRefresh = LastStatExportTime == 0.0 || Now - LastStatExportTime >= StatExportIntervalSeconds;
+
+	const FGameThreadStatsData* ViewData = FLatestGameThreadStatsData::Get().Latest;
+	if (bRefresh && ViewData != nullptr)
+	{
+		LastStatExportTime = Now;
+		StatsWriter->Reset();
+		StatsWriter->AppendChar('\n');
 
 		const int64 Timestamp = UnixTimestampMS((FDateTime::UtcNow()));
 		for (const auto& Pair : ViewData->NameToStatMap)
 		{
-			if (Pair.Value)
+			if (!Pair.Value)
+			{
+				continue;
+			}
+
+			FCachedStat* CachedStat = CachedStats.Find(Pair.Key);
+			if (CachedStat == nullptr)
 			{
-				Buffer += FString::Printf(TEXT("stat{name=\"%s\",field=\"count\"} %u %lld\n"), *Pair.Key.ToString(), Pair.Value->GetValue_CallCount(EComplexStatField::IncAve), Timestamp);
-				Buffer += FString::Printf(TEXT("stat{name=\"%s\",field=\"incave\"} %f %lld\n"), *Pair.Key.ToString(), FPlatformTime::ToMilliseconds64(Pair.Value->GetValue_Duration(EComplexStatField::IncAve)), Timestamp);
-				Buffer += FString::Printf(TEXT("stat{name=\"%s\",field=\"incmax\"} %f %lld\n"), *Pair.Key.ToString(), FPlatformTime::ToMilliseconds64(Pair.Value->GetValue_Duration(EComplexStatField::IncMax)), Timestamp);
+				const FString StatName = Pair.Key.ToString();
+
+				CachedStat = &CachedStats.Add(Pair.Key);
+				CachedStat->bExported = StatPrefixes.Num() == 0 || StatPrefixes.ContainsByPredicate([&StatName](const FString& Prefix) {
+					return StatName.StartsWith(Prefix);
+				});
+
+				if (CachedStat->bExported)
+				{
+					const FString EscapedName = EscapeLabelValue(StatName);
+					CachedStat->CountPrefix = FPrometheusExpositionWriter::MakeSeriesPrefix(TEXT("stat"), FString::Printf(TEXT("{name=\"%s\",field=\"count\"}"), *EscapedName));
+					CachedStat->IncAvePrefix = FPrometheusExpositionWriter::MakeSeriesPrefix(TEXT("stat"), FString::Printf(TEXT("{name=\"%s\",field=\"incave\"}"), *EscapedName));
+					CachedStat->IncMaxPrefix = FPrometheusExpositionWriter::MakeSeriesPrefix(TEXT("stat"), FString::Printf(TEXT("{name=\"%s\",field=\"incmax\"}"), *EscapedName));
+				}
 			}
+
+			if (!CachedStat->bExported)
+			{
+				continue;
+			}
+
+			StatsWriter->AppendBytes(CachedStat->CountPrefix);
+			StatsWriter->AppendUInt64(Pair.Value->GetValue_CallCount(EComplexStatField::IncAve));
+			StatsWriter->AppendChar(' ');
+			StatsWriter->AppendInt64(Timestamp);
+			StatsWriter->AppendChar('\n');
+
+			StatsWriter->AppendBytes(CachedStat->IncAvePrefix);
+			StatsWriter->AppendDouble(FPlatformTime::ToMilliseconds64(Pair.Value->GetValue_Duration(EComplexStatField::IncAve)));
+			StatsWriter->AppendChar(' ');
+			StatsWriter->AppendInt64(Timestamp);
+			StatsWriter->AppendChar('\n');
+
+			StatsWriter->AppendBytes(CachedStat->IncMaxPrefix);
+			StatsWriter->AppendDouble(FPlatformTime::ToMilliseconds64(Pair.Value->GetValue_Duration(EComplexStatField::IncMax)));
+			StatsWriter->AppendChar(' ');
+			StatsWriter->AppendInt64(Timestamp);
+			StatsWriter->AppendChar('\n');
 		}
 	}
-#endif
 
-	return Buffer;
+	// Samples carry the timestamp they were taken at, so re-sending the cached block between refreshes is accurate.
+	Writer.AppendBytes(StatsWriter->GetBuffer());
 }
+#endif
 
 bool FPrometheusServer::ProcessPrometheusRequest(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete)
 {
-	auto Response = FHttpServerResponse::Create(Serialize(), TEXT("text/plain; version=0.0.4"));
+	const bool bAcceptsGzip = AcceptsGzip(Request);
+	if (bAcceptsGzip)
+	{
+		bGzipRequested.store(true, std::memory_order_relaxed);
+	}
+
+	TSharedPtr<const FPrometheusSnapshot, ESPMode::ThreadSafe> Current;
+	TArray<uint8> Body;
+	bool bSendGzip = false;
+	{
+		FScopeLock Lock(&SnapshotLock);
+		Current = Snapshot;
+		if (Current.IsValid())
+		{
+			bSendGzip = bAcceptsGzip && Current->GzipBody.Num() > 0;
+			Body = MoveTemp(bSendGzip ? Current->SpareGzipBody : Current->SpareBody);
+		}
+	}
+
+	// Only a second scrape of the same snapshot (more than one scraper) finds the spare gone and pays for a copy.
+	if (Current.IsValid() && Body.Num() == 0)
+	{
+		Body = bSendGzip ? Current->GzipBody : Current->Body;
+	}
+	auto Response = FHttpServerResponse::Create(MoveTemp(Body), TEXT("text/plain; version=0.0.4"));
+
+	// Whether it's compressed depends on the request, so caches between us and the scraper mustn't mix them up.
+	Response->Headers.Add(TEXT("Vary"), { TEXT("Accept-Encoding") });
+	if (bSendGzip)
+	{
+		Response->Headers.Add(TEXT("Content-Encoding"), { TEXT("gzip") });
+	}
 
 	OnComplete(MoveTemp(Response));
 
 	return true;
 }
 
-TSharedRef<FPrometheusMetric> FPrometheusServer::GetMetric(const FString& Name, TArray<FPrometheusLabel> Labels)
+template <typename SeriesType>
+TSharedRef<SeriesType, ESPMode::ThreadSafe> FPrometheusServer::FindOrAddSeries(TSeriesRegistry<SeriesType>& Registry, const FString& Name, const FString& LabelKey,
+	TFunctionRef<TSharedRef<SeriesType, ESPMode::ThreadSafe>()> Create)
 {
 	// If we don't have that metric at all, add it and return the first one.
-	TSharedRef<TMap<const FString, TSharedRef<FPrometheusMetric>>> Entries = Metrics.FindOrAdd(Name, MakeShared<TMap<const FString, TSharedRef<FPrometheusMetric>>>());
+	// Only allocate the per-name map when the name is new, FindOrAdd would build (and throw away) one on every lookup.
+	TSharedRef<TSeriesMap<SeriesType>, ESPMode::ThreadSafe>* ExistingEntries = Registry.Families.Find(Name);
+	TSharedRef<TSeriesMap<SeriesType>, ESPMode::ThreadSafe> Entries = ExistingEntries != nullptr ? *ExistingEntries : Registry.Families.Add(Name, MakeShared<TSeriesMap<SeriesType>, ESPMode::ThreadSafe>());
+
+	if (TSharedRef<SeriesType, ESPMode::ThreadSafe>* Existing = Entries->Find(LabelKey))
+	{
+		return *Existing;
+	}
 
+	// Asking for an evicted series that's still held elsewhere hands back the same instance, so both stay in sync.
+	typename TSeriesRegistry<SeriesType>::FDormantSeries Dormant;
+	if (Registry.Dormant.RemoveAndCopyValue(Name + LabelKey, Dormant))
+	{
+		if (TSharedPtr<SeriesType, ESPMode::ThreadSafe> DormantSeries = Dormant.Series.Pin())
+		{
+			TSharedRef<SeriesType, ESPMode::ThreadSafe> Series = DormantSeries.ToSharedRef();
+			AddSeries(Registry, Name, *Entries, LabelKey, Series);
+			return Series;
+		}
+	}
+
+	TSharedRef<SeriesType, ESPMode::ThreadSafe> Series = Create();
+	AddSeries(Registry, Name, *Entries, LabelKey, Series);
+	return Series;
+}
+
+template <typename SeriesType>
+void FPrometheusServer::AddSeries(TSeriesRegistry<SeriesType>& Registry, const FString& Name, TSeriesMap<SeriesType>& Entries, const FString& LabelKey,
+	const TSharedRef<SeriesType, ESPMode::ThreadSafe>& Series)
+{
+	if (MaxSeriesPerName > 0 && Entries.Num() >= MaxSeriesPerName)
+	{
+		// Linear, but only paid when adding a series to a name that's already full.
+		const FString* OldestKey = nullptr;
+		int64 OldestTimestamp = MAX_int64;
+		for (const auto& Pair : Entries)
+		{
+			const int64 LastUpdate = Pair.Value->GetLastUpdateTimestamp();
+			if (Pair.Value->bEvictable && LastUpdate < OldestTimestamp)
+			{
+				OldestTimestamp = LastUpdate;
+				OldestKey = &Pair.Key;
+			}
+		}
+
+		if (OldestKey != nullptr)
+		{
+			const FString EvictedKey = *OldestKey;
+			MakeDormant(Registry, Name, EvictedKey, Entries.FindChecked(EvictedKey));
+			Entries.Remove(EvictedKey);
+			SeriesEvictedCap.Increment(1);
+		}
+	}
+
+	Entries.Add(LabelKey, Series);
+}
+
+template <typename SeriesType>
+void FPrometheusServer::MakeDormant(TSeriesRegistry<SeriesType>& Registry, const FString& Name, const FString& LabelKey, const TSharedRef<SeriesType, ESPMode::ThreadSafe>& Series)
+{
+	// Only worth remembering if someone other than our map holds it.  A count of one can't change under us: the only way to get
+	// another reference is GetMetric() and friends, which need the lock we hold.
+	if (Series.GetSharedReferenceCount() > 1)
+	{
+		Registry.Dormant.Add(Name + LabelKey, typename TSeriesRegistry<SeriesType>::FDormantSeries{ Name, LabelKey, Series, Series->GetLastUpdateTimestamp() });
+	}
+}
+
+template <typename SeriesType>
+int32 FPrometheusServer::EvictIdleSeries(TSeriesRegistry<SeriesType>& Registry, int64 Now, int64 IdleCutoff, int64 NeverUpdatedCutoff)
+{
+	int32 NumSeries = 0;
+	for (auto It = Registry.Families.CreateIterator(); It; ++It)
+	{
+		TSeriesMap<SeriesType>& Entries = *It->Value;
+		for (auto EntryIt = Entries.CreateIterator(); EntryIt; ++EntryIt)
+		{
+			SeriesType& Series = *EntryIt->Value;
+			Series.RefreshLastUpdateTimestamp(Now);
+			if (Series.bEvictable && Series.GetLastUpdateTimestamp() < (Series.HasBeenUpdated() ? IdleCutoff : NeverUpdatedCutoff))
+			{
+				MakeDormant(Registry, It->Key, EntryIt->Key, EntryIt->Value);
+				EntryIt.RemoveCurrent();
+				SeriesEvictedIdle.Increment(1);
+			}
+		}
+
+		if (Entries.Num() == 0)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		NumSeries += Entries.Num();
+	}
+
+	// Dormant series that have been updated since come back. Ones nobody holds any more are forgotten.
+	for (auto It = Registry.Dormant.CreateIterator(); It; ++It)
+	{
+		TSharedPtr<SeriesType, ESPMode::ThreadSafe> Series = It->Value.Series.Pin();
+		if (!Series.IsValid())
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		Series->RefreshLastUpdateTimestamp(Now);
+		if (Series->GetLastUpdateTimestamp() != It->Value.LastUpdateAtEviction)
+		{
+			TSharedRef<TSeriesMap<SeriesType>, ESPMode::ThreadSafe>* ExistingEntries = Registry.Families.Find(It->Value.Name);
+			TSharedRef<TSeriesMap<SeriesType>, ESPMode::ThreadSafe> Entries = ExistingEntries != nullptr ? *ExistingEntries : Registry.Families.Add(It->Value.Name, MakeShared<TSeriesMap<SeriesType>, ESPMode::ThreadSafe>());
+			if (!Entries->Contains(It->Value.LabelKey))
+			{
+				AddSeries(Registry, It->Value.Name, *Entries, It->Value.LabelKey, Series.ToSharedRef());
+				++NumSeries;
+			}
+			It.RemoveCurrent();
+		}
+	}
+
+	return NumSeries;
+}
+
+void FPrometheusServer::EvictIdleSeries()
+{
+	FScopeLock Lock(&MetricsLock);
+
+	const int64 Now = UnixTimestampMS(FDateTime::UtcNow());
+	const int64 IdleCutoff = SeriesIdleTimeoutMS > 0 ? Now - SeriesIdleTimeoutMS : MIN_int64;
+	const int64 NeverUpdatedCutoff = Now - NeverUpdatedTimeoutMS;
+	int32 NumSeries = EvictIdleSeries(Metrics, Now, IdleCutoff, NeverUpdatedCutoff);
+	NumSeries += EvictIdleSeries(Histograms, Now, IdleCutoff, NeverUpdatedCutoff);
+	NumSeries += EvictIdleSeries(Summaries, Now, IdleCutoff, NeverUpdatedCutoff);
+
+	SeriesCount.Set(NumSeries);
+}
+
+TSharedRef<FPrometheusMetric, ESPMode::ThreadSafe> FPrometheusServer::GetMetric(const FString& Name, TArray<FPrometheusLabel> Labels)
+{
+	FScopeLock Lock(&MetricsLock);
+
+	const FString StrLabel = MakeLabelKey(Labels);
+	return FindOrAddSeries<FPrometheusMetric>(Metrics, Name, StrLabel, [&Name, &StrLabel]() {
+		TSharedRef<FPrometheusMetric, ESPMode::ThreadSafe> Metric = MakeShared<FPrometheusMetric, ESPMode::ThreadSafe>();
+		Metric->SeriesPrefix = FPrometheusExpositionWriter::MakeSeriesPrefix(Name, StrLabel);
+		Metric->RegisteredTimestamp = UnixTimestampMS(FDateTime::UtcNow());
+		return Metric;
+	});
+}
+
+FString FPrometheusServer::MakeLabelKey(TArray<FPrometheusLabel>& Labels)
+{
 	FString StrLabel(TEXT("{}"));
 
 	if (Labels.Num() > 0)
@@ -148,12 +731,80 @@ TSharedRef<FPrometheusMetric> FPrometheusServer::GetMetric(const FString& Name,
 		StrLabel += TEXT("}");
 	}
 
-	return Entries->FindOrAdd(StrLabel, MakeShared<FPrometheusMetric>());
+	return StrLabel;
+}
+
+TSharedRef<FPrometheusHistogram, ESPMode::ThreadSafe> FPrometheusServer::GetHistogram(const FString& Name, TArray<FPrometheusLabel> Labels, const TArray<double>& BucketBounds)
+{
+	FScopeLock Lock(&MetricsLock);
+
+	const FString StrLabel = MakeLabelKey(Labels);
+	return FindOrAddSeries<FPrometheusHistogram>(Histograms, Name, StrLabel, [&Name, &StrLabel, &BucketBounds]() {
+		TSharedRef<FPrometheusHistogram, ESPMode::ThreadSafe> Histogram = MakeShared<FPrometheusHistogram, ESPMode::ThreadSafe>(BucketBounds);
+		Histogram->SetSeries(Name, StrLabel);
+		Histogram->LastUpdateTimestamp = UnixTimestampMS(FDateTime::UtcNow());
+		return Histogram;
+	});
+}
+
+TSharedRef<FPrometheusSummary, ESPMode::ThreadSafe> FPrometheusServer::GetSummary(const FString& Name, TArray<FPrometheusLabel> Labels, const TArray<double>& Quantiles)
+{
+	FScopeLock Lock(&MetricsLock);
+
+	const FString StrLabel = MakeLabelKey(Labels);
+	return FindOrAddSeries<FPrometheusSummary>(Summaries, Name, StrLabel, [&Name, &StrLabel, &Quantiles]() {
+		TSharedRef<FPrometheusSummary, ESPMode::ThreadSafe> Summary = MakeShared<FPrometheusSummary, ESPMode::ThreadSafe>(Quantiles, FPrometheusSummary::DefaultWindowSize);
+		Summary->SetSeries(Name, StrLabel);
+		Summary->LastUpdateTimestamp = UnixTimestampMS(FDateTime::UtcNow());
+		return Summary;
+	});
+}
+
+FPrometheusMetricHandle FPrometheusServer::RegisterMetric(const FString& Name, const TArray<FPrometheusLabel>& Labels)
+{
+	return FPrometheusMetricHandle(GetMetric(Name, Labels));
+}
+
+FPrometheusMetric::~FPrometheusMetric()
+{
+	delete[] Shards.load(std::memory_order_acquire);
+}
+
+FPrometheusMetric::FShard* FPrometheusMetric::GetOrCreateShards()
+{
+	FShard* Existing = Shards.load(std::memory_order_acquire);
+	if (Existing != nullptr)
+	{
+		return Existing;
+	}
+
+	FShard* Created = new FShard[NumShards];
+	if (Shards.compare_exchange_strong(Existing, Created, std::memory_order_acq_rel))
+	{
+		return Created;
+	}
+
+	// Another thread beat us to it.
+	delete[] Created;
+	return Existing;
+}
+
+double FPrometheusMetric::GetValue() const
+{
+	double Result = BitsToDouble(ValueBits.load(std::memory_order_relaxed));
+	if (const FShard* ShardArray = Shards.load(std::memory_order_acquire))
+	{
+		for (int32 Index = 0; Index < NumShards; ++Index)
+		{
+			Result += BitsToDouble(ShardArray[Index].Bits.load(std::memory_order_relaxed));
+		}
+	}
+	return Result;
 }
 
 FString FPrometheusMetric::ToString() const
 {
-	return FString::Printf(TEXT("%f"), Value);
+	return FString::Printf(TEXT("%f"), GetValue());
 }
 
 void FPrometheusMetric::Set(double InValue)
@@ -163,8 +814,16 @@ void FPrometheusMetric::Set(double InValue)
 
 void FPrometheusMetric::Set(double InValue, const FDateTime& InTimestamp)
 {
-	Value = InValue;
-	Timestamp = UnixTimestampMS(InTimestamp);
+	// The shards hold increments on top of the base value, so a Set() discards them.
+	if (FShard* ShardArray = Shards.load(std::memory_order_acquire))
+	{
+		for (int32 Index = 0; Index < NumShards; ++Index)
+		{
+			ShardArray[Index].Bits.store(DoubleToBits(0.0), std::memory_order_relaxed);
+		}
+	}
+	ValueBits.store(DoubleToBits(InValue), std::memory_order_relaxed);
+	Timestamp.store(UnixTimestampMS(InTimestamp), std::memory_order_relaxed);
 }
 
 void FPrometheusMetric::Increment(double Amount)
@@ -174,6 +833,204 @@ void FPrometheusMetric::Increment(double Amount)
 
 void FPrometheusMetric::Increment(double Amount, const FDateTime& InTimestamp)
 {
-	Value += Amount;
-	Timestamp = UnixTimestampMS(InTimestamp);
+	FShard* ShardArray = GetOrCreateShards();
+	const uint32 ShardIndex = FPlatformTLS::GetCurrentThreadId() % NumShards;
+	AtomicAddDouble(ShardArray[ShardIndex].Bits, Amount);
+	Timestamp.store(UnixTimestampMS(InTimestamp), std::memory_order_relaxed);
+}
+
+FPrometheusHistogram::FPrometheusHistogram(TArray<double> InBucketBounds)
+	: BucketBounds(MoveTemp(InBucketBounds))
+{
+	BucketBounds.Sort();
+
+	BucketLabels.Reserve(BucketBounds.Num() + 1);
+	for (const double Bound : BucketBounds)
+	{
+		BucketLabels.Add(FString::Printf(TEXT("le=\"%s\""), *FormatBound(Bound)));
+	}
+	BucketLabels.Add(TEXT("le=\"+Inf\""));
+
+	BucketCounts = MakeUnique<std::atomic<uint64>[]>(BucketBounds.Num() + 1);
+}
+
+void FPrometheusHistogram::Observe(double Value)
+{
+	// First bucket whose upper bound is >= Value, or the +Inf bucket past the end.
+	const int32 BucketIndex = Algo::LowerBound(BucketBounds, Value);
+	BucketCounts[BucketIndex].fetch_add(1, std::memory_order_relaxed);
+	AtomicAddDouble(SumBits, Value);
+	Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FPrometheusHistogram::RefreshLastUpdateTimestamp(int64 Now)
+{
+	const uint64 CurrentCount = Count.load(std::memory_order_relaxed);
+	if (CurrentCount != CountAtLastRefresh)
+	{
+		CountAtLastRefresh = CurrentCount;
+		LastUpdateTimestamp = Now;
+	}
+}
+
+void FPrometheusHistogram::SetSeries(const FString& Name, const FString& LabelKey)
+{
+	BucketPrefixes.Reset(BucketLabels.Num());
+	for (const FString& BucketLabel : BucketLabels)
+	{
+		BucketPrefixes.Add(FPrometheusExpositionWriter::MakeSeriesPrefix(Name + TEXT("_bucket"), AppendLabel(LabelKey, BucketLabel)));
+	}
+	SumPrefix = FPrometheusExpositionWriter::MakeSeriesPrefix(Name + TEXT("_sum"), LabelKey);
+	CountPrefix = FPrometheusExpositionWriter::MakeSeriesPrefix(Name + TEXT("_count"), LabelKey);
+}
+
+void FPrometheusHistogram::Serialize(FPrometheusExpositionWriter& Writer) const
+{
+	// Buckets are read one at a time while other threads may be observing, so derive _count from the buckets we actually
+	// read. That keeps the +Inf bucket and _count consistent with each other, which Prometheus expects.
+	uint64 Cumulative = 0;
+	for (int32 Index = 0; Index < BucketPrefixes.Num(); ++Index)
+	{
+		Cumulative += BucketCounts[Index].load(std::memory_order_relaxed);
+		Writer.AppendBytes(BucketPrefixes[Index]);
+		Writer.AppendUInt64(Cumulative);
+		Writer.AppendChar('\n');
+	}
+	Writer.AppendBytes(SumPrefix);
+	Writer.AppendDouble(BitsToDouble(SumBits.load(std::memory_order_relaxed)));
+	Writer.AppendChar('\n');
+	Writer.AppendBytes(CountPrefix);
+	Writer.AppendUInt64(Cumulative);
+	Writer.AppendChar('\n');
+}
+
+TArray<double> FPrometheusHistogram::LinearBuckets(double Start, double Width, int32 Count)
+{
+	TArray<double> Bounds;
+	Bounds.Reserve(Count);
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		Bounds.Add(Start + Width * Index);
+	}
+	return Bounds;
+}
+
+TArray<double> FPrometheusHistogram::ExponentialBuckets(double Start, double Factor, int32 Count)
+{
+	TArray<double> Bounds;
+	Bounds.Reserve(Count);
+	double Bound = Start;
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		Bounds.Add(Bound);
+		Bound *= Factor;
+	}
+	return Bounds;
+}
+
+FPrometheusSummary::FPrometheusSummary(TArray<double> InQuantiles, int32 InWindowSize)
+	: Quantiles(MoveTemp(InQuantiles))
+	, WindowSize(FMath::Max(1, InWindowSize))
+{
+	Quantiles.Sort();
+
+	QuantileLabels.Reserve(Quantiles.Num());
+	for (const double Quantile : Quantiles)
+	{
+		QuantileLabels.Add(FString::Printf(TEXT("quantile=\"%s\""), *FormatBound(Quantile)));
+	}
+
+	Window = MakeUnique<std::atomic<uint64>[]>(WindowSize);
+	SetQuantileBits = MakeUnique<std::atomic<uint64>[]>(Quantiles.Num());
+}
+
+const TArray<double>& FPrometheusSummary::DefaultQuantiles()
+{
+	static const TArray<double> Quantiles = { 0.5, 0.9, 0.95, 0.99 };
+	return Quantiles;
+}
+
+void FPrometheusSummary::Observe(double Value)
+{
+	const uint64 Slot = NextSample.fetch_add(1, std::memory_order_relaxed) % WindowSize;
+	Window[Slot].store(DoubleToBits(Value), std::memory_order_relaxed);
+	AtomicAddDouble(SumBits, Value);
+	Count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FPrometheusSummary::SetQuantiles(TFunctionRef<double(double Quantile)> GetQuantile, double AddedSum, uint64 AddedCount)
+{
+	for (int32 Index = 0; Index < Quantiles.Num(); ++Index)
+	{
+		SetQuantileBits[Index].store(DoubleToBits(GetQuantile(Quantiles[Index])), std::memory_order_relaxed);
+	}
+	AtomicAddDouble(SumBits, AddedSum);
+	Count.fetch_add(AddedCount, std::memory_order_relaxed);
+	bQuantilesSet.store(true, std::memory_order_release);
+}
+
+void FPrometheusSummary::RefreshLastUpdateTimestamp(int64 Now)
+{
+	const uint64 CurrentCount = Count.load(std::memory_order_relaxed);
+	if (CurrentCount != CountAtLastRefresh)
+	{
+		CountAtLastRefresh = CurrentCount;
+		LastUpdateTimestamp = Now;
+	}
+}
+
+void FPrometheusSummary::SetSeries(const FString& Name, const FString& LabelKey)
+{
+	QuantilePrefixes.Reset(QuantileLabels.Num());
+	for (const FString& QuantileLabel : QuantileLabels)
+	{
+		QuantilePrefixes.Add(FPrometheusExpositionWriter::MakeSeriesPrefix(Name, AppendLabel(LabelKey, QuantileLabel)));
+	}
+	SumPrefix = FPrometheusExpositionWriter::MakeSeriesPrefix(Name + TEXT("_sum"), LabelKey);
+	CountPrefix = FPrometheusExpositionWriter::MakeSeriesPrefix(Name + TEXT("_count"), LabelKey);
+}
+
+void FPrometheusSummary::Serialize(FPrometheusExpositionWriter& Writer) const
+{
+	if (bQuantilesSet.load(std::memory_order_acquire))
+	{
+		for (int32 Index = 0; Index < Quantiles.Num(); ++Index)
+		{
+			Writer.AppendBytes(QuantilePrefixes[Index]);
+			Writer.AppendDouble(BitsToDouble(SetQuantileBits[Index].load(std::memory_order_relaxed)));
+			Writer.AppendChar('\n');
+		}
+	}
+	else
+	{
+		const int32 NumSamples = static_cast<int32>(FMath::Min<uint64>(NextSample.load(std::memory_order_relaxed), WindowSize));
+
+		TArray<double> Samples;
+		Samples.Reserve(NumSamples);
+		for (int32 Index = 0; Index < NumSamples; ++Index)
+		{
+			Samples.Add(BitsToDouble(Window[Index].load(std::memory_order_relaxed)));
+		}
+		Samples.Sort();
+
+		for (int32 Index = 0; Index < Quantiles.Num(); ++Index)
+		{
+			double Value = 0.0;
+			if (NumSamples > 0)
+			{
+				// Nearest rank.
+				const int32 Rank = FMath::Clamp(FMath::CeilToInt(Quantiles[Index] * NumSamples) - 1, 0, NumSamples - 1);
+				Value = Samples[Rank];
+			}
+			Writer.AppendBytes(QuantilePrefixes[Index]);
+			Writer.AppendDouble(Value);
+			Writer.AppendChar('\n');
+		}
+	}
+	Writer.AppendBytes(SumPrefix);
+	Writer.AppendDouble(BitsToDouble(SumBits.load(std::memory_order_relaxed)));
+	Writer.AppendChar('\n');
+	Writer.AppendBytes(CountPrefix);
+	Writer.AppendUInt64(Count.load(std::memory_order_relaxed));
+	Writer.AppendChar('\n');
 }
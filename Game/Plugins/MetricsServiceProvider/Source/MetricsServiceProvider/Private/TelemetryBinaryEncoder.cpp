@@ -0,0 +1,125 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+#include "TelemetryBinaryEncoder.h"
+
+#include "Runtime/Launch/Resources/Version.h"
+#include "TelemetryWorker.h"
+
+namespace
+{
+	const uint8 BinaryBatchMagic[4] = { 'U', 'T', 'B', '1' };
+}
+
+void FTelemetryBinaryEncoder::WriteVarInt(TArray<uint8>& Out, uint64 Value)
+{
+	while (Value >= 0x80)
+	{
+		Out.Add(static_cast<uint8>(Value | 0x80));
+		Value >>= 7;
+	}
+	Out.Add(static_cast<uint8>(Value));
+}
+
+bool FTelemetryBinaryEncoder::IsBinaryBatch(const TArray<uint8>& Content)
+{
+	return Content.Num() >= UE_ARRAY_COUNT(BinaryBatchMagic) && FMemory::Memcmp(Content.GetData(), BinaryBatchMagic, UE_ARRAY_COUNT(BinaryBatchMagic)) == 0;
+}
+
+int32 FTelemetryBinaryEncoder::AddString(const FString& String)
+{
+	if (const int32* Existing = StringIndices.Find(String))
+	{
+		return *Existing;
+	}
+
+	const FTCHARToUTF8 Converted(*String);
+	WriteVarInt(StringBytes, Converted.Length());
+	StringBytes.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+
+	return StringIndices.Add(String, NumStrings++);
+}
+
+int32 FTelemetryBinaryEncoder::AddLiteral(const TCHAR* Literal)
+{
+	if (const int32* Existing = LiteralIndices.Find(Literal))
+	{
+		return *Existing;
+	}
+	return LiteralIndices.Add(Literal, AddString(Literal));
+}
+
+void FTelemetryBinaryEncoder::Encode(const TArray<FTelemetryEvent>& Events, const FString& EventEnvironment, const FString& EngineVersion, TArray<uint8>& OutContent)
+{
+	StringIndices.Reset();
+	LiteralIndices.Reset();
+	SessionIndices.Reset();
+	StringBytes.Reset();
+	EventBytes.Reset();
+	NumStrings = 0;
+
+	// Index 0 is the empty string, which is what missing IDs encode as.
+	AddString(FString());
+
+	const int32 EnvironmentIndex = AddString(EventEnvironment);
+	const int32 EngineVersionIndex = AddString(EngineVersion);
+
+	int64 PreviousEventIndex = 0;
+	int64 PreviousTimestamp = 0;
+	for (const FTelemetryEvent& Event : Events)
+	{
+		WriteVarInt(EventBytes, ZigZag(Event.EventIndex - PreviousEventIndex));
+		WriteVarInt(EventBytes, ZigZag(Event.EventTimestamp - PreviousTimestamp));
+		PreviousEventIndex = Event.EventIndex;
+		PreviousTimestamp = Event.EventTimestamp;
+
+		WriteVarInt(EventBytes, AddLiteral(Event.EventSource));
+		WriteVarInt(EventBytes, AddString(Event.EventClass));
+		WriteVarInt(EventBytes, AddString(Event.EventType));
+
+		FSessionIndices Session = { 0, 0, 0, 0, 0 };
+		if (const FTelemetrySessionDetails* Details = Event.SessionDetails.Get())
+		{
+			if (const FSessionIndices* Existing = SessionIndices.Find(Details))
+			{
+				Session = *Existing;
+			}
+			else
+			{
+				Session.AccountID = AddString(Details->AccountID);
+				Session.ProfileID = AddString(Details->ProfileID);
+				Session.ServerSessionID = AddString(Details->ServerSessionID);
+				Session.ClientSessionID = AddString(Details->ClientSessionID);
+				Session.WorkerID = AddString(Details->WorkerID);
+				SessionIndices.Add(Details, Session);
+			}
+		}
+		WriteVarInt(EventBytes, Session.AccountID);
+		WriteVarInt(EventBytes, Session.ProfileID);
+		WriteVarInt(EventBytes, Session.ServerSessionID);
+		WriteVarInt(EventBytes, Session.ClientSessionID);
+		WriteVarInt(EventBytes, Session.WorkerID);
+
+		WriteVarInt(EventBytes, Event.EventAttributes.Num());
+		for (const FAnalyticsEventAttribute& Attribute : Event.EventAttributes)
+		{
+#if ENGINE_MINOR_VERSION >= 27
+			WriteVarInt(EventBytes, AddString(Attribute.GetName()));
+			WriteVarInt(EventBytes, AddString(Attribute.GetValue()));
+#else
+			WriteVarInt(EventBytes, AddString(Attribute.AttrName));
+			WriteVarInt(EventBytes, AddString(Attribute.ToString()));
+#endif
+		}
+
+		const uint64 SampleRatePPM = Event.SampleRate < 1.0f ? FMath::Max<uint64>(1, FMath::RoundToInt(Event.SampleRate * 1000000.0f)) : 0;
+		WriteVarInt(EventBytes, SampleRatePPM);
+	}
+
+	OutContent.Reset(UE_ARRAY_COUNT(BinaryBatchMagic) + StringBytes.Num() + EventBytes.Num() + 16);
+	OutContent.Append(BinaryBatchMagic, UE_ARRAY_COUNT(BinaryBatchMagic));
+	WriteVarInt(OutContent, NumStrings);
+	OutContent.Append(StringBytes);
+	WriteVarInt(OutContent, EnvironmentIndex);
+	WriteVarInt(OutContent, EngineVersionIndex);
+	WriteVarInt(OutContent, Events.Num());
+	OutContent.Append(EventBytes);
+}
@@ -0,0 +1,67 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FTelemetryEvent;
+struct FTelemetrySessionDetails;
+
+/**
+ * Compact binary encoding of a telemetry batch, posted to BinaryEndpointURL instead of the JSON array.
+ *
+ * Layout, all integers are unsigned LEB128 varints unless noted:
+ *   "UTB1"                        4 byte magic
+ *   StringCount, then per string  byte length + UTF-8 bytes.  String 0 is always the empty string.
+ *   EventEnvironment, EngineVersion   string indices, shared by every event in the batch
+ *   EventCount, then per event:
+ *     EventIndex, EventTimestamp   zigzag encoded delta from the previous event (the first is relative to 0)
+ *     EventSource, EventClass, EventType   string indices
+ *     AccountID, ProfileID, ServerSessionID, ClientSessionID, WorkerID   string indices
+ *     AttributeCount, then per attribute a name and value string index
+ *     SampleRate                   in parts per million, 0 when the event wasn't sampled
+ *
+ * Field names never appear and each distinct string is written once per batch, which is where the saving over JSON comes from
+ * for servers reporting many events for the same few sessions.
+ *
+ * Reuse one encoder, its tables keep their allocations between batches.  Not thread safe.
+ */
+class FTelemetryBinaryEncoder
+{
+public:
+	void Encode(const TArray<FTelemetryEvent>& Events, const FString& EventEnvironment, const FString& EngineVersion, TArray<uint8>& OutContent);
+
+	// True if Content was produced by Encode(), as opposed to being a JSON batch.
+	static bool IsBinaryBatch(const TArray<uint8>& Content);
+
+	static void WriteVarInt(TArray<uint8>& Out, uint64 Value);
+	static uint64 ZigZag(int64 Value)
+	{
+		return (static_cast<uint64>(Value) << 1) ^ static_cast<uint64>(Value >> 63);
+	}
+
+private:
+	int32 AddString(const FString& String);
+	int32 AddLiteral(const TCHAR* Literal);
+
+	TMap<FString, int32> StringIndices;
+
+	// Event sources are always string literals, so they're looked up by pointer.
+	TMap<const TCHAR*, int32> LiteralIndices;
+
+	// Events from the same profile share their session details, so they only need looking up once per batch.
+	struct FSessionIndices
+	{
+		int32 AccountID;
+		int32 ProfileID;
+		int32 ServerSessionID;
+		int32 ClientSessionID;
+		int32 WorkerID;
+	};
+	TMap<const FTelemetrySessionDetails*, FSessionIndices> SessionIndices;
+
+	TArray<uint8> StringBytes;
+	int32 NumStrings = 0;
+
+	TArray<uint8> EventBytes;
+};
@@ -0,0 +1,113 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <atomic>
+
+/**
+ * Bounded, lock free multi producer queue used to hand telemetry events to the serialization worker.
+ *
+ * This is Dmitry Vyukov's bounded MPMC ring: each cell carries a sequence number that tells producers and the consumer whose
+ * turn it is, so a push is one CAS on the enqueue position plus a move into a preallocated cell.  Nothing is allocated after
+ * construction and Enqueue() never blocks; when the ring is full it returns false and the caller decides what to drop.
+ */
+template <typename ElementType>
+class TTelemetryEventQueue
+{
+public:
+	// Capacity is rounded up to a power of two.
+	explicit TTelemetryEventQueue(uint32 InCapacity)
+		: Capacity(FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(InCapacity, 2)))
+		, Mask(Capacity - 1)
+		, Cells(MakeUnique<FCell[]>(Capacity))
+	{
+		for (uint32 Index = 0; Index < Capacity; ++Index)
+		{
+			Cells[Index].Sequence.store(Index, std::memory_order_relaxed);
+		}
+	}
+
+	TTelemetryEventQueue(const TTelemetryEventQueue&) = delete;
+	TTelemetryEventQueue& operator=(const TTelemetryEventQueue&) = delete;
+
+	// Safe from any number of threads. Returns false, leaving Item untouched, if the queue is full.
+	bool Enqueue(ElementType&& Item)
+	{
+		uint64 Position = EnqueuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			FCell& Cell = Cells[Position & Mask];
+			const uint64 Sequence = Cell.Sequence.load(std::memory_order_acquire);
+			const int64 Difference = static_cast<int64>(Sequence) - static_cast<int64>(Position);
+			if (Difference == 0)
+			{
+				if (EnqueuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+				{
+					Cell.Value = MoveTemp(Item);
+					Cell.Sequence.store(Position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (Difference < 0)
+			{
+				// The consumer hasn't freed this cell yet, we've gone all the way round.
+				return false;
+			}
+			else
+			{
+				Position = EnqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Single consumer. Returns false if the queue is empty.
+	bool Dequeue(ElementType& OutItem)
+	{
+		uint64 Position = DequeuePosition.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			FCell& Cell = Cells[Position & Mask];
+			const uint64 Sequence = Cell.Sequence.load(std::memory_order_acquire);
+			const int64 Difference = static_cast<int64>(Sequence) - static_cast<int64>(Position + 1);
+			if (Difference == 0)
+			{
+				if (DequeuePosition.compare_exchange_weak(Position, Position + 1, std::memory_order_relaxed))
+				{
+					OutItem = MoveTemp(Cell.Value);
+					Cell.Sequence.store(Position + Capacity, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (Difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				Position = DequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	uint32 GetCapacity() const
+	{
+		return Capacity;
+	}
+
+private:
+	struct FCell
+	{
+		std::atomic<uint64> Sequence{ 0 };
+		ElementType Value;
+	};
+
+	const uint32 Capacity;
+	const uint64 Mask;
+	TUniquePtr<FCell[]> Cells;
+
+	// Kept on separate cache lines so producers and the consumer don't invalidate each other.
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> EnqueuePosition{ 0 };
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> DequeuePosition{ 0 };
+};
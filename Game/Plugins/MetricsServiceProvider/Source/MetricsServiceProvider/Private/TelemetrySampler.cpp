@@ -0,0 +1,152 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+#include "TelemetrySampler.h"
+
+#include "Analytics.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CommandLine.h"
+#include "Misc/ConfigCacheIni.h"
+#include "PrometheusServer.h"
+
+namespace
+{
+	const FString TelemetryEventsMetricName = TEXT("telemetry_events");
+	const TCHAR* SamplingSection = TEXT("TelemetrySampling");
+
+	// e.g. EMetricsClass::MetricsClass_Movement => Movement
+	FString GetClassName(int32 ClassIndex)
+	{
+		FString Name = StaticEnum<EMetricsClass>()->GetNameStringByIndex(ClassIndex);
+		Name.RemoveFromStart(TEXT("EMetricsClass::"));
+		Name.RemoveFromStart(TEXT("MetricsClass_"));
+		return Name;
+	}
+}
+
+FTelemetrySampler::FTelemetrySampler(const TSharedPtr<FPrometheusServer, ESPMode::ThreadSafe>& InPrometheus)
+	: Prometheus(InPrometheus)
+{
+	// The enum's implicit _MAX entry is excluded.
+	Classes.SetNum(StaticEnum<EMetricsClass>()->NumEnums() - 1);
+	ReadConfig();
+}
+
+void FTelemetrySampler::ReadConfig()
+{
+	TArray<FString> ConfigLines;
+	if (GConfig != nullptr)
+	{
+		GConfig->GetArray(SamplingSection, TEXT("Classes"), ConfigLines, GEngineIni);
+	}
+	for (const FString& Line : ConfigLines)
+	{
+		FString ClassName;
+		float Probability = 1.0f;
+		double RatePerSecond = 0.0;
+		double Burst = 0.0;
+		FParse::Value(*Line, TEXT("Class="), ClassName);
+		FParse::Value(*Line, TEXT("Probability="), Probability);
+		FParse::Value(*Line, TEXT("RatePerSecond="), RatePerSecond);
+		FParse::Value(*Line, TEXT("Burst="), Burst);
+		Configure(ClassName, Probability, RatePerSecond, Burst);
+	}
+
+	// Command line entries win over the ini.
+	FString CommandLineConfig;
+	if (FParse::Value(FCommandLine::Get(), TEXT("telemetrySampling="), CommandLineConfig, false))
+	{
+		TArray<FString> Entries;
+		CommandLineConfig.ParseIntoArray(Entries, TEXT(","));
+		for (const FString& Entry : Entries)
+		{
+			TArray<FString> Fields;
+			Entry.ParseIntoArray(Fields, TEXT(":"), false);
+			Configure(Fields[0],
+				Fields.IsValidIndex(1) ? FCString::Atof(*Fields[1]) : 1.0f,
+				Fields.IsValidIndex(2) ? FCString::Atod(*Fields[2]) : 0.0,
+				Fields.IsValidIndex(3) ? FCString::Atod(*Fields[3]) : 0.0);
+		}
+	}
+}
+
+void FTelemetrySampler::Configure(const FString& ClassName, float Probability, double RatePerSecond, double Burst)
+{
+	for (int32 ClassIndex = 0; ClassIndex < Classes.Num(); ++ClassIndex)
+	{
+		const FString Name = GetClassName(ClassIndex);
+		if (!Name.Equals(ClassName, ESearchCase::IgnoreCase))
+		{
+			continue;
+		}
+
+		FClassSampling& Sampling = Classes[ClassIndex];
+		Sampling.bConfigured = true;
+		Sampling.Probability = FMath::Clamp(Probability, 0.0f, 1.0f);
+		Sampling.RatePerSecond = FMath::Max(0.0, RatePerSecond);
+		// Default to a one second burst.
+		Sampling.Burst = Burst > 0.0 ? Burst : FMath::Max(1.0, Sampling.RatePerSecond);
+		Sampling.Tokens = Sampling.Burst;
+
+		if (Prometheus.IsValid())
+		{
+			const FString LowerName = Name.ToLower();
+			Sampling.SampledOut = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("sampled_out")), FPrometheusLabel(TEXT("class"), LowerName) });
+			Sampling.RateLimited = Prometheus->RegisterMetric(TelemetryEventsMetricName, { FPrometheusLabel(TEXT("status"), TEXT("rate_limited")), FPrometheusLabel(TEXT("class"), LowerName) });
+		}
+
+		UE_LOG(LogAnalytics, Log, TEXT("Telemetry sampling for %s: probability %.3f, %.1f/s (burst %.1f)"), *Name, Sampling.Probability, Sampling.RatePerSecond, Sampling.Burst);
+		return;
+	}
+
+	UE_LOG(LogAnalytics, Warning, TEXT("Unknown telemetry class '%s' in sampling config"), *ClassName);
+}
+
+bool FTelemetrySampler::ShouldRecord(EMetricsClass EventClass, float& OutSampleRate)
+{
+	OutSampleRate = 1.0f;
+
+	const int32 ClassIndex = static_cast<int32>(EventClass);
+	if (!Classes.IsValidIndex(ClassIndex) || !Classes[ClassIndex].bConfigured)
+	{
+		return true;
+	}
+	FClassSampling& Sampling = Classes[ClassIndex];
+
+	if (Sampling.Probability < 1.0f && FMath::FRand() >= Sampling.Probability)
+	{
+		Sampling.SampledOut.Increment(1);
+		return false;
+	}
+
+	if (Sampling.RatePerSecond <= 0.0)
+	{
+		OutSampleRate = Sampling.Probability;
+		return true;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	Sampling.Tokens = FMath::Min(Sampling.Burst, Sampling.Tokens + (Now - Sampling.LastRefillTime) * Sampling.RatePerSecond);
+	Sampling.LastRefillTime = Now;
+
+	if (Now - Sampling.WindowStartTime >= 1.0)
+	{
+		if (Sampling.OfferedInWindow > 0)
+		{
+			Sampling.AdmitRatio = static_cast<float>(Sampling.AdmittedInWindow) / Sampling.OfferedInWindow;
+		}
+		Sampling.WindowStartTime = Now;
+		Sampling.OfferedInWindow = 0;
+		Sampling.AdmittedInWindow = 0;
+	}
+	++Sampling.OfferedInWindow;
+
+	if (Sampling.Tokens < 1.0)
+	{
+		Sampling.RateLimited.Increment(1);
+		return false;
+	}
+	Sampling.Tokens -= 1.0;
+	++Sampling.AdmittedInWindow;
+
+	OutSampleRate = FMath::Max(Sampling.Probability * Sampling.AdmitRatio, KINDA_SMALL_NUMBER);
+	return true;
+}
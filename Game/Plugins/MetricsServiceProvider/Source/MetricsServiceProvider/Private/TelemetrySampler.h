@@ -0,0 +1,59 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MetricsBlueprintLibrary.h"
+
+class FPrometheusServer;
+
+/**
+ * Decides, per EMetricsClass, whether an event is recorded at all.  Checked before any attributes or payload are built.
+ *
+ * Each class has a sampling probability and an optional token bucket (RatePerSecond refilled up to Burst).  An event has to pass
+ * both.  The rate an event was kept at is handed back so it can be recorded with the event and counts re-weighted downstream;
+ * for the token bucket that's the fraction it admitted over the previous second.
+ *
+ * Configured with +Classes=(Class=Movement,Probability=0.1,RatePerSecond=50,Burst=100) in the [TelemetrySampling] section of the
+ * engine ini, or -telemetrySampling=Movement:0.1:50:100,Combat:0.5 (Class:Probability[:RatePerSecond[:Burst]]) on the command line.
+ * Classes that aren't listed are always recorded.
+ *
+ * Game thread only.
+ */
+class FTelemetrySampler
+{
+public:
+	explicit FTelemetrySampler(const TSharedPtr<FPrometheusServer, ESPMode::ThreadSafe>& Prometheus);
+
+	// Returns false if the event should be dropped. OutSampleRate is in (0, 1].
+	bool ShouldRecord(EMetricsClass EventClass, float& OutSampleRate);
+
+private:
+	struct FClassSampling
+	{
+		bool bConfigured = false;
+
+		float Probability = 1.0f;
+
+		// Zero means no rate limit.
+		double RatePerSecond = 0.0;
+		double Burst = 0.0;
+		double Tokens = 0.0;
+		double LastRefillTime = 0.0;
+
+		// Admission ratio of the token bucket, measured over one second windows.
+		double WindowStartTime = 0.0;
+		int32 OfferedInWindow = 0;
+		int32 AdmittedInWindow = 0;
+		float AdmitRatio = 1.0f;
+
+		FPrometheusMetricHandle SampledOut;
+		FPrometheusMetricHandle RateLimited;
+	};
+
+	void Configure(const FString& ClassName, float Probability, double RatePerSecond, double Burst);
+	void ReadConfig();
+
+	TArray<FClassSampling> Classes;
+	TSharedPtr<FPrometheusServer, ESPMode::ThreadSafe> Prometheus;
+};
@@ -0,0 +1,362 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+#include "TelemetrySpool.h"
+
+#include "Analytics.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+	constexpr int64 RecordHeaderSize = sizeof(int32) * 2;
+
+	// Compaction streams the file through a buffer this size rather than holding the whole live region in memory.
+	constexpr int64 CopyChunkSize = 64 * 1024;
+
+	// Appends [Offset, Offset + NumBytes) of Source to Dest.
+	bool CopyRange(IFileHandle& Source, IFileHandle& Dest, int64 Offset, int64 NumBytes)
+	{
+		if (!Source.Seek(Offset))
+		{
+			return false;
+		}
+
+		TArray<uint8> Chunk;
+		Chunk.SetNumUninitialized(FMath::Min(NumBytes, CopyChunkSize));
+		while (NumBytes > 0)
+		{
+			const int64 ChunkBytes = FMath::Min<int64>(NumBytes, Chunk.Num());
+			if (!Source.Read(Chunk.GetData(), ChunkBytes) || !Dest.Write(Chunk.GetData(), ChunkBytes))
+			{
+				return false;
+			}
+			NumBytes -= ChunkBytes;
+		}
+		return true;
+	}
+}
+
+// A copy of the unreplayed records into the temp file, made by the worker while the game thread keeps using the spool.
+struct FTelemetrySpool::FCompaction
+{
+	// The region copied. Records appended after EndOffset while the copy runs are added when it's swapped in.
+	int64 StartOffset = 0;
+	int64 EndOffset = 0;
+
+	bool bSucceeded = false;
+	std::atomic<bool> bDone{ false };
+};
+
+FTelemetrySpool::FTelemetrySpool(const FString& InFilePath, int64 InMaxSizeBytes, FRunTask InRunTask)
+	: FilePath(InFilePath)
+	, MaxSizeBytes(InMaxSizeBytes)
+	, RunTask(MoveTemp(InRunTask))
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(FilePath));
+
+	// Anything left over from a previous run gets replayed.
+	FileSize = FMath::Max<int64>(PlatformFile.FileSize(*FilePath), 0);
+	if (FileSize > 0)
+	{
+		Recover();
+	}
+	PlatformFile.DeleteFile(*GetOffsetPath());
+
+	// Left by a compaction that didn't finish.
+	PlatformFile.DeleteFile(*GetTempPath());
+
+	if (!IsEmpty())
+	{
+		UE_LOG(LogAnalytics, Display, TEXT("Found %lld bytes of spooled telemetry in %s, it will be replayed."), FileSize - ReadOffset, *FilePath);
+	}
+}
+
+FTelemetrySpool::~FTelemetrySpool()
+{
+	// A copy still running is abandoned, the spool itself is left intact and its temp file is cleared up by the next run.
+	FinishCompaction();
+	WriteHandle.Reset();
+
+	// Remember how far the replay got, so the next run doesn't resend batches that were already delivered.
+	if (ReadOffset > 0 && !FFileHelper::SaveStringToFile(LexToString(ReadOffset), *GetOffsetPath()))
+	{
+		UE_LOG(LogAnalytics, Warning, TEXT("Unable to save the replay offset of telemetry spool %s"), *FilePath);
+	}
+}
+
+void FTelemetrySpool::Recover()
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	int64 SavedReadOffset = 0;
+	FString SavedReadOffsetString;
+	if (FFileHelper::LoadFileToString(SavedReadOffsetString, *GetOffsetPath()))
+	{
+		LexFromString(SavedReadOffset, *SavedReadOffsetString);
+	}
+
+	// Walk the record headers to find where the last complete record ends, and check the saved offset is on a record.
+	int64 ValidSize = 0;
+	bool bSavedReadOffsetValid = SavedReadOffset == 0;
+	{
+		TUniquePtr<IFileHandle> ReadHandle(PlatformFile.OpenRead(*FilePath));
+		if (!ReadHandle.IsValid())
+		{
+			UE_LOG(LogAnalytics, Warning, TEXT("Unable to read telemetry spool %s, it will be replayed as is"), *FilePath);
+			return;
+		}
+
+		int32 Header[2];
+		while (FileSize - ValidSize >= RecordHeaderSize && ReadHandle->Seek(ValidSize) && ReadHandle->Read(reinterpret_cast<uint8*>(Header), sizeof(Header))
+			&& Header[1] >= 0 && FileSize - ValidSize - RecordHeaderSize >= Header[1])
+		{
+			ValidSize += RecordHeaderSize + Header[1];
+			bSavedReadOffsetValid |= ValidSize == SavedReadOffset;
+		}
+	}
+
+	if (ValidSize < FileSize)
+	{
+		// Cut short by a crash mid write. Drop the partial record now, before anything is appended after it.
+		UE_LOG(LogAnalytics, Warning, TEXT("Discarding a %lld byte truncated record at the end of telemetry spool %s"), FileSize - ValidSize, *FilePath);
+		TUniquePtr<IFileHandle> TruncateHandle(PlatformFile.OpenWrite(*FilePath, /*bAppend*/ true, /*bAllowRead*/ true));
+		if (!TruncateHandle.IsValid() || !TruncateHandle->Truncate(ValidSize))
+		{
+			UE_LOG(LogAnalytics, Warning, TEXT("Unable to truncate telemetry spool %s, discarding it"), *FilePath);
+			TruncateHandle.Reset();
+			DeleteFile();
+			return;
+		}
+		FileSize = ValidSize;
+	}
+
+	if (bSavedReadOffsetValid)
+	{
+		ReadOffset = SavedReadOffset;
+	}
+	DeleteFileIfReplayed();
+}
+
+void FTelemetrySpool::Tick()
+{
+	FinishCompaction();
+}
+
+bool FTelemetrySpool::OpenForAppend()
+{
+	if (!WriteHandle.IsValid())
+	{
+		WriteHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*FilePath, /*bAppend*/ true, /*bAllowRead*/ true));
+		if (!WriteHandle.IsValid())
+		{
+			UE_LOG(LogAnalytics, Warning, TEXT("Unable to open telemetry spool %s"), *FilePath);
+		}
+	}
+	return WriteHandle.IsValid();
+}
+
+bool FTelemetrySpool::Append(const TArray<uint8>& Body, int32 NumEvents)
+{
+	FinishCompaction();
+
+	const int64 RecordSize = RecordHeaderSize + Body.Num();
+	if (FileSize + RecordSize > MaxSizeBytes)
+	{
+		// The cap is on the file itself, so reclaim what's already been replayed. Unless the compaction runs inline this
+		// record is still dropped, it's the ones after it that fit.
+		StartCompaction();
+	}
+	if (FileSize + RecordSize > MaxSizeBytes || !OpenForAppend())
+	{
+		return false;
+	}
+
+	int32 Header[2] = { NumEvents, Body.Num() };
+	if (!WriteHandle->Write(reinterpret_cast<const uint8*>(Header), sizeof(Header)) || !WriteHandle->Write(Body.GetData(), Body.Num()))
+	{
+		// Don't leave a partial record for the next one to be appended after.
+		UE_LOG(LogAnalytics, Warning, TEXT("Failed writing to telemetry spool %s"), *FilePath);
+		if (!WriteHandle->Truncate(FileSize))
+		{
+			UE_LOG(LogAnalytics, Warning, TEXT("Unable to truncate telemetry spool %s after a failed write"), *FilePath);
+		}
+		WriteHandle.Reset();
+		return false;
+	}
+	WriteHandle->Flush();
+
+	FileSize += RecordSize;
+	return true;
+}
+
+bool FTelemetrySpool::Peek(TArray<uint8>& OutBody, int32& OutNumEvents)
+{
+	FinishCompaction();
+
+	PeekedRecordSize = 0;
+	if (IsEmpty())
+	{
+		return false;
+	}
+
+	TUniquePtr<IFileHandle> ReadHandle(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*FilePath, /*bAllowWrite*/ true));
+	if (!ReadHandle.IsValid() || !ReadHandle->Seek(ReadOffset))
+	{
+		return false;
+	}
+
+	int32 Header[2];
+	if (FileSize - ReadOffset < RecordHeaderSize || !ReadHandle->Read(reinterpret_cast<uint8*>(Header), sizeof(Header))
+		|| Header[1] < 0 || FileSize - ReadOffset - RecordHeaderSize < Header[1])
+	{
+		// Crash tails are trimmed when the spool is opened, so the file has been damaged some other way.
+		UE_LOG(LogAnalytics, Warning, TEXT("Discarding unreadable records from offset %lld in telemetry spool %s"), ReadOffset, *FilePath);
+		ReadHandle.Reset();
+		ReadOffset = FileSize;
+		DeleteFileIfReplayed();
+		return false;
+	}
+
+	OutBody.SetNumUninitialized(Header[1]);
+	if (!ReadHandle->Read(OutBody.GetData(), Header[1]))
+	{
+		return false;
+	}
+
+	OutNumEvents = Header[0];
+	PeekedRecordSize = RecordHeaderSize + Header[1];
+	return true;
+}
+
+void FTelemetrySpool::Pop()
+{
+	ReadOffset += PeekedRecordSize;
+	PeekedRecordSize = 0;
+
+	if (IsEmpty())
+	{
+		DeleteFileIfReplayed();
+	}
+	else if (ReadOffset >= MaxSizeBytes / 2)
+	{
+		// A replay that keeps pace with new failures may never drain the file, so don't let the replayed prefix build up.
+		StartCompaction();
+	}
+}
+
+void FTelemetrySpool::StartCompaction()
+{
+	if (Compaction.IsValid() || ReadOffset == 0 || IsEmpty())
+	{
+		return;
+	}
+
+	Compaction = MakeShared<FCompaction, ESPMode::ThreadSafe>();
+	Compaction->StartOffset = ReadOffset;
+	Compaction->EndOffset = FileSize;
+
+	// Only the read side is shared with the game thread, which carries on appending past EndOffset and popping before it.
+	auto Copy = [Job = Compaction, SourcePath = FilePath, DestPath = GetTempPath()]()
+	{
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+		{
+			TUniquePtr<IFileHandle> Source(PlatformFile.OpenRead(*SourcePath, /*bAllowWrite*/ true));
+			TUniquePtr<IFileHandle> Dest(PlatformFile.OpenWrite(*DestPath));
+			Job->bSucceeded = Source.IsValid() && Dest.IsValid() && CopyRange(*Source, *Dest, Job->StartOffset, Job->EndOffset - Job->StartOffset);
+		}
+		Job->bDone.store(true, std::memory_order_release);
+	};
+
+	if (RunTask)
+	{
+		RunTask(MoveTemp(Copy));
+	}
+	else
+	{
+		Copy();
+	}
+	FinishCompaction();
+}
+
+void FTelemetrySpool::FinishCompaction()
+{
+	if (!Compaction.IsValid() || !Compaction->bDone.load(std::memory_order_acquire))
+	{
+		return;
+	}
+
+	const TSharedPtr<FCompaction, ESPMode::ThreadSafe> Finished = MoveTemp(Compaction);
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	const FString TempPath = GetTempPath();
+	if (!Finished->bSucceeded)
+	{
+		UE_LOG(LogAnalytics, Warning, TEXT("Failed copying telemetry spool %s to %s for compaction"), *FilePath, *TempPath);
+		PlatformFile.DeleteFile(*TempPath);
+		return;
+	}
+	if (IsEmpty())
+	{
+		// Everything was replayed while the copy ran.
+		PlatformFile.DeleteFile(*TempPath);
+		DeleteFileIfReplayed();
+		return;
+	}
+
+	// Records appended while the copy ran. Usually a batch or two, so this is cheap enough to do here.
+	WriteHandle.Reset();
+	bool bCopiedTail = false;
+	{
+		TUniquePtr<IFileHandle> Source(PlatformFile.OpenRead(*FilePath));
+		TUniquePtr<IFileHandle> Dest(PlatformFile.OpenWrite(*TempPath, /*bAppend*/ true));
+		bCopiedTail = Source.IsValid() && Dest.IsValid() && CopyRange(*Source, *Dest, Finished->EndOffset, FileSize - Finished->EndOffset);
+	}
+	if (!bCopiedTail)
+	{
+		UE_LOG(LogAnalytics, Warning, TEXT("Failed writing %s while compacting telemetry spool"), *TempPath);
+		PlatformFile.DeleteFile(*TempPath);
+		return;
+	}
+
+	PlatformFile.DeleteFile(*FilePath);
+	if (!PlatformFile.MoveFile(*FilePath, *TempPath))
+	{
+		UE_LOG(LogAnalytics, Warning, TEXT("Failed replacing telemetry spool %s, %lld bytes of spooled telemetry lost"), *FilePath, FileSize - ReadOffset);
+		PlatformFile.DeleteFile(*TempPath);
+		FileSize = 0;
+		ReadOffset = 0;
+		return;
+	}
+
+	FileSize -= Finished->StartOffset;
+	ReadOffset -= Finished->StartOffset;
+}
+
+void FTelemetrySpool::DeleteFileIfReplayed()
+{
+	// The worker may still be reading the file, FinishCompaction() deletes it instead.
+	if (IsEmpty() && !Compaction.IsValid())
+	{
+		DeleteFile();
+	}
+}
+
+void FTelemetrySpool::DeleteFile()
+{
+	WriteHandle.Reset();
+	FPlatformFileManager::Get().GetPlatformFile().DeleteFile(*FilePath);
+	FileSize = 0;
+	ReadOffset = 0;
+}
+
+FString FTelemetrySpool::GetOffsetPath() const
+{
+	return FilePath + TEXT(".offset");
+}
+
+FString FTelemetrySpool::GetTempPath() const
+{
+	return FilePath + TEXT(".tmp");
+}
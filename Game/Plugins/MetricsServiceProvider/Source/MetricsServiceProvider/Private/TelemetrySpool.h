@@ -0,0 +1,86 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <atomic>
+
+class IFileHandle;
+
+/**
+ * Append-only on-disk spool for telemetry batches that couldn't be delivered.
+ *
+ * Each record is [int32 NumEvents][int32 NumBytes][NumBytes of serialized batch], the batch being a UTF-8 JSON array or
+ * FTelemetryBinaryEncoder output.  Records are read back in order with Peek()/Pop(); once everything has been popped the file is
+ * deleted, and popped records are compacted away before they take up half the cap.  Compaction copies the file on the thread
+ * RunTask hands it to, and the copy is swapped in by a later call once it's done.
+ * The cap applies to the size of the file on disk.  A spool left behind by a previous run is replayed from where that run got to,
+ * which is saved on a clean shutdown, or from the start after a crash; delivery is at least once.  A record cut short by a crash is
+ * trimmed off when the spool is opened.
+ *
+ * Game thread only, apart from the compaction copy.
+ */
+class FTelemetrySpool
+{
+public:
+	// Runs a task off the game thread. Without one, compaction runs inline.
+	using FRunTask = TFunction<void(TUniqueFunction<void()>&&)>;
+
+	FTelemetrySpool(const FString& InFilePath, int64 InMaxSizeBytes, FRunTask InRunTask = nullptr);
+	~FTelemetrySpool();
+
+	// Returns false if the record would take the file over its size cap or the write fails.
+	bool Append(const TArray<uint8>& Body, int32 NumEvents);
+
+	// Reads the oldest record not yet popped. Returns false if there isn't one.
+	bool Peek(TArray<uint8>& OutBody, int32& OutNumEvents);
+
+	// Drops the record returned by the last Peek().
+	void Pop();
+
+	// Swaps in a finished compaction.
+	void Tick();
+
+	bool IsEmpty() const
+	{
+		return ReadOffset >= FileSize;
+	}
+
+	const FString& GetFilePath() const
+	{
+		return FilePath;
+	}
+
+private:
+	bool OpenForAppend();
+	void DeleteFile();
+
+	// Trims a partial record left by a crash and picks up the replay offset saved by the last clean shutdown.
+	void Recover();
+
+	FString GetOffsetPath() const;
+
+	// Starts rewriting the file without the records that have already been popped, if a rewrite isn't already running.
+	void StartCompaction();
+	void FinishCompaction();
+
+	void DeleteFileIfReplayed();
+
+	FString GetTempPath() const;
+
+	const FString FilePath;
+	const int64 MaxSizeBytes;
+	const FRunTask RunTask;
+
+	struct FCompaction;
+	TSharedPtr<FCompaction, ESPMode::ThreadSafe> Compaction;
+
+	TUniquePtr<IFileHandle> WriteHandle;
+
+	int64 FileSize = 0;
+	int64 ReadOffset = 0;
+
+	// Size of the record returned by the last Peek(), so Pop() knows how far to advance.
+	int64 PeekedRecordSize = 0;
+};
@@ -0,0 +1,223 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+#include "TelemetryWorker.h"
+
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+
+#include "Dom/JsonObject.h"
+#include "Dom/JsonValue.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	// Upper bound on how long a partial batch waits for a flush request before the worker checks again.
+	const uint32 WorkerWaitMS = 100;
+}
+
+FTelemetryWorker::FTelemetryWorker(const FString& InEventEnvironment, const FString& InEngineVersion, int32 InBatchSize, bool bInBinaryEncoding)
+	: Queue(QueueCapacity)
+	, EventEnvironment(InEventEnvironment)
+	, EngineVersion(InEngineVersion)
+	, BatchSize(FMath::Max(1, InBatchSize))
+	, bBinaryEncoding(bInBinaryEncoding)
+{
+	if (FPlatformProcess::SupportsMultithreading())
+	{
+		WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+		Thread = FRunnableThread::Create(this, TEXT("TelemetryWorker"), 0, TPri_BelowNormal);
+	}
+}
+
+FTelemetryWorker::~FTelemetryWorker()
+{
+	Shutdown();
+
+	if (WakeEvent != nullptr)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+}
+
+bool FTelemetryWorker::Enqueue(FTelemetryEvent&& Event)
+{
+	if (!Queue.Enqueue(MoveTemp(Event)))
+	{
+		return false;
+	}
+
+	if (NumQueued.fetch_add(1, std::memory_order_relaxed) + 1 >= BatchSize)
+	{
+		if (Thread == nullptr)
+		{
+			ProcessQueue();
+		}
+		else
+		{
+			WakeEvent->Trigger();
+		}
+	}
+	return true;
+}
+
+void FTelemetryWorker::RequestFlush()
+{
+	bFlushRequested.store(true, std::memory_order_relaxed);
+	if (Thread == nullptr)
+	{
+		ProcessQueue();
+	}
+	else
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+bool FTelemetryWorker::DequeueBatch(FTelemetryBatch& OutBatch)
+{
+	return Batches.Dequeue(OutBatch);
+}
+
+void FTelemetryWorker::Shutdown()
+{
+	if (Thread == nullptr)
+	{
+		bFlushRequested.store(true, std::memory_order_relaxed);
+		ProcessQueue();
+		return;
+	}
+
+	Stop();
+	Thread->WaitForCompletion();
+	delete Thread;
+	Thread = nullptr;
+}
+
+void FTelemetryWorker::RunTask(TUniqueFunction<void()>&& Task)
+{
+	if (Thread == nullptr)
+	{
+		Task();
+		return;
+	}
+
+	Tasks.Enqueue(MoveTemp(Task));
+	WakeEvent->Trigger();
+}
+
+uint32 FTelemetryWorker::Run()
+{
+	while (!bStopping.load(std::memory_order_relaxed))
+	{
+		WakeEvent->Wait(WorkerWaitMS);
+		ProcessQueue();
+	}
+
+	// Nothing queued before shutdown gets lost.
+	bFlushRequested.store(true, std::memory_order_relaxed);
+	ProcessQueue();
+	return 0;
+}
+
+void FTelemetryWorker::Stop()
+{
+	bStopping.store(true, std::memory_order_relaxed);
+	if (WakeEvent != nullptr)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FTelemetryWorker::ProcessQueue()
+{
+	TUniqueFunction<void()> Task;
+	while (Tasks.Dequeue(Task))
+	{
+		Task();
+	}
+
+	FTelemetryEvent Event;
+	while (Queue.Dequeue(Event))
+	{
+		NumQueued.fetch_sub(1, std::memory_order_relaxed);
+		PendingEvents.Add(MoveTemp(Event));
+	}
+
+	const bool bFlush = bFlushRequested.exchange(false, std::memory_order_relaxed);
+	if (PendingEvents.Num() == 0 || (!bFlush && PendingEvents.Num() < BatchSize))
+	{
+		return;
+	}
+
+	Batches.Enqueue(SerializeBatch());
+	PendingEvents.Reset();
+}
+
+FTelemetryBatch FTelemetryWorker::SerializeBatch()
+{
+	FTelemetryBatch Batch;
+	Batch.NumEvents = PendingEvents.Num();
+
+	if (bBinaryEncoding)
+	{
+		BinaryEncoder.Encode(PendingEvents, EventEnvironment, EngineVersion, Batch.Content);
+		return Batch;
+	}
+
+	FString Payload = TEXT("[");
+	const int32 MaxEventIndex = PendingEvents.Num() - 1;
+	for (int32 Index = 0; Index <= MaxEventIndex; ++Index)
+	{
+		Payload += PendingEvents[Index].Stringify(EventEnvironment, EngineVersion);
+		Payload += Index == MaxEventIndex ? TEXT("]") : TEXT(",");
+	}
+
+	const FTCHARToUTF8 Converted(*Payload);
+	Batch.Content.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+	return Batch;
+}
+
+FString FTelemetryEvent::Stringify(const FString& EventEnvironment, const FString& EngineVersion) const
+{
+	TSharedRef<FJsonObject> Obj = MakeShared<FJsonObject>();
+	TSharedRef<FJsonObject> Attributes = MakeShared<FJsonObject>();
+
+	Obj->SetStringField(TEXT("eventEnvironment"), EventEnvironment);
+	Obj->SetStringField(TEXT("eventSource"), EventSource);
+	Obj->SetStringField(TEXT("eventClass"), EventClass);
+	Obj->SetStringField(TEXT("eventType"), EventType);
+	Obj->SetNumberField(TEXT("eventTimestamp"), EventTimestamp);
+	Obj->SetNumberField(TEXT("eventIndex"), EventIndex);
+
+	Obj->SetStringField(TEXT("versionId"), EngineVersion);
+
+	if (SampleRate < 1.0f)
+	{
+		Obj->SetNumberField(TEXT("sampleRate"), SampleRate);
+	}
+
+	auto EmptyCheckToSetField = [Obj](const FString& CheckID, const FString& SetField) {
+		if (!CheckID.IsEmpty())
+		{
+			Obj->SetStringField(SetField, CheckID);
+		}
+	};
+
+	// If ID not empty, set the field to Obj
+	if (SessionDetails.IsValid())
+	{
+		EmptyCheckToSetField(SessionDetails->AccountID, TEXT("accountId"));
+		EmptyCheckToSetField(SessionDetails->ProfileID, TEXT("profileId"));
+		EmptyCheckToSetField(SessionDetails->ServerSessionID, TEXT("serverSessionId"));
+		EmptyCheckToSetField(SessionDetails->ClientSessionID, TEXT("clientSessionId"));
+		EmptyCheckToSetField(SessionDetails->WorkerID, TEXT("workerId"));
+	}
+
+	FString Output;
+	TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> JsonWriter = TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&Output);
+	FJsonSerializer::Serialize(Obj, JsonWriter);
+
+	return Output;
+}
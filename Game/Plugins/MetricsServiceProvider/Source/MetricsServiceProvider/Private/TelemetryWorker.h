@@ -0,0 +1,165 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/Runnable.h"
+#include "Interfaces/IAnalyticsProvider.h"
+#include "TelemetryBinaryEncoder.h"
+#include "TelemetryEventQueue.h"
+
+#include <atomic>
+
+class FEvent;
+class FRunnableThread;
+
+/**
+ * The parts of an event that are the same for every event a profile reports during a session.  Built once and shared by
+ * every event that uses it instead of being copied into each one.
+ */
+struct FTelemetrySessionDetails
+{
+	/**
+	 * The AccountID of who reported the event(the real person)
+	 */
+	FString AccountID;
+
+	/**
+	 * The ProfileID of the player who reported the event(the character in game)
+	 */
+	FString ProfileID;
+
+	/**
+	 *  The ServerSessionID, which is unique per server instance
+	 */
+	FString ServerSessionID;
+
+	/**
+	 *  The ClientSessionID, which is unique per player session.
+	 */
+	FString ClientSessionID;
+
+	/**
+	 * The WorkerID the event was reported on.
+	 */
+	FString WorkerID;
+};
+
+/**
+ * Payload data based on schema defined here: https://docs.google.com/spreadsheets/d/1W_G1DxjpJW1aFGAr_kmPiSOVeo_ygb9GdhMhKf2HJW8/edit#gid=0
+ *
+ * Only what differs per event is stored here.  The environment and engine version are fixed for the process and added by the worker.
+ */
+struct FTelemetryEvent
+{
+	/**
+	 *  Increments by one after any event has been gathered. This will allow us to spot missing data.
+	 */
+	int32 EventIndex = 0;
+
+	/**
+	 * Unix time the event occurred
+	 */
+	int32 EventTimestamp = 0;
+
+	/**
+	 * Denotes the source of the event, which can be either client or server side.  Always a string literal.
+	 */
+	const TCHAR* EventSource = TEXT("Not set");
+
+	/**
+	 *  A higher order mnemonic classification of events (e.g. session).
+	 */
+	FString EventClass;
+
+	/**
+	 *  A mnemonic event identifier (e.g. session_start).
+	 */
+	FString EventType;
+
+	/**
+	 *  Attribute data of the event
+	 */
+	TArray<FAnalyticsEventAttribute> EventAttributes;
+
+	TSharedPtr<const FTelemetrySessionDetails, ESPMode::ThreadSafe> SessionDetails;
+
+	/**
+	 * Fraction of events of this class that were kept by sampling/rate limiting, so counts can be re-weighted. 1 if not sampled.
+	 */
+	float SampleRate = 1.0f;
+
+	FString Stringify(const FString& EventEnvironment, const FString& EngineVersion) const;
+};
+
+// A serialized batch of events ready to post, either a UTF-8 JSON array or FTelemetryBinaryEncoder output.
+struct FTelemetryBatch
+{
+	TArray<uint8> Content;
+	int32 NumEvents = 0;
+};
+
+/**
+ * Serializes telemetry off the game thread.
+ *
+ * Producers push events into a bounded ring.  The worker thread drains it, and once BatchSize events are waiting (or a flush
+ * is requested) turns them into a JSON body, or a binary one when bBinaryEncoding is set.  Bodies are handed back through DequeueBatch() so the game thread can post them
+ * with the retry manager, which isn't thread safe.  Without multithreading support the work is done inline by the caller.
+ */
+class FTelemetryWorker : public FRunnable
+{
+public:
+	FTelemetryWorker(const FString& InEventEnvironment, const FString& InEngineVersion, int32 InBatchSize, bool bInBinaryEncoding);
+	virtual ~FTelemetryWorker();
+
+	// Returns false, dropping the event, if the queue is full.
+	bool Enqueue(FTelemetryEvent&& Event);
+
+	// Serialize everything queued so far, even if it doesn't fill a batch.
+	void RequestFlush();
+
+	// Game thread. Pops the next serialized batch ready to post.
+	bool DequeueBatch(FTelemetryBatch& OutBatch);
+
+	// Serializes everything still queued and stops the thread. Once this returns, every event is available from DequeueBatch().
+	void Shutdown();
+
+	// Runs Task on the worker thread, or inline without multithreading support or once the worker has been shut down.
+	void RunTask(TUniqueFunction<void()>&& Task);
+
+	//FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	static constexpr uint32 QueueCapacity = 4096;
+
+private:
+	void ProcessQueue();
+	FTelemetryBatch SerializeBatch();
+
+	TTelemetryEventQueue<FTelemetryEvent> Queue;
+
+	// Drained events waiting for a full batch. Only touched by the worker.
+	TArray<FTelemetryEvent> PendingEvents;
+
+	TQueue<FTelemetryBatch, EQueueMode::Spsc> Batches;
+
+	// File work handed over by the game thread, such as spool compaction.
+	TQueue<TUniqueFunction<void()>, EQueueMode::Spsc> Tasks;
+
+	const FString EventEnvironment;
+	const FString EngineVersion;
+	const int32 BatchSize;
+	const bool bBinaryEncoding;
+
+	// Only used by the worker.
+	FTelemetryBinaryEncoder BinaryEncoder;
+
+	std::atomic<int32> NumQueued{ 0 };
+	std::atomic<bool> bFlushRequested{ false };
+	std::atomic<bool> bStopping{ false };
+
+	FEvent* WakeEvent = nullptr;
+	FRunnableThread* Thread = nullptr;
+};
@@ -0,0 +1,285 @@
+#include "MetricsServiceProvider.h"
+#include "PrometheusServer.h"
+
+#include "Async/ParallelFor.h"
+#include "Dom/JsonObject.h"
+#include "Dom/JsonValue.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "PrometheusExpositionWriter.h"
+#include "Serialization/JsonSerializer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+ * Cost of the metrics plugin itself.  Each test writes its results to Saved/Automation/MetricsBenchmarks/<Suite>.json so they
+ * can be compared between GDK bumps:
+ *
+ *   { "suite": "...", "engineVersion": "...", "timestamp": "...",
+ *     "results": [ { "name": "...", "operations": N, "seconds": S, "nsPerOp": X, ...parameters } ] }
+ */
+namespace
+{
+	class FBenchmarkReport
+	{
+	public:
+		FBenchmarkReport(FAutomationTestBase& InTest, const FString& InSuite)
+			: Test(InTest)
+			, Suite(InSuite)
+		{
+		}
+
+		TSharedRef<FJsonObject> AddResult(const FString& Name, int64 NumOperations, double Seconds)
+		{
+			const double NanosecondsPerOperation = NumOperations > 0 ? Seconds * 1e9 / NumOperations : 0.0;
+
+			TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+			Result->SetStringField(TEXT("name"), Name);
+			Result->SetNumberField(TEXT("operations"), NumOperations);
+			Result->SetNumberField(TEXT("seconds"), Seconds);
+			Result->SetNumberField(TEXT("nsPerOp"), NanosecondsPerOperation);
+			Results.Add(MakeShared<FJsonValueObject>(Result));
+
+			Test.AddInfo(FString::Printf(TEXT("%s: %lld ops in %.3f ms, %.1f ns/op"), *Name, NumOperations, Seconds * 1000.0, NanosecondsPerOperation));
+			return Result;
+		}
+
+		void Save() const
+		{
+			TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+			Root->SetStringField(TEXT("suite"), Suite);
+			Root->SetStringField(TEXT("engineVersion"), FEngineVersion::Current().ToString());
+			Root->SetStringField(TEXT("timestamp"), FDateTime::UtcNow().ToIso8601());
+			Root->SetArrayField(TEXT("results"), Results);
+
+			FString Output;
+			TSharedRef<TJsonWriter<>> JsonWriter = TJsonWriterFactory<>::Create(&Output);
+			FJsonSerializer::Serialize(Root, JsonWriter);
+
+			const FString Path = FPaths::AutomationDir() / TEXT("MetricsBenchmarks") / Suite + TEXT(".json");
+			if (FFileHelper::SaveStringToFile(Output, *Path))
+			{
+				Test.AddInfo(FString::Printf(TEXT("Benchmark results written to %s"), *Path));
+			}
+			else
+			{
+				Test.AddWarning(FString::Printf(TEXT("Unable to write benchmark results to %s"), *Path));
+			}
+		}
+
+	private:
+		FAutomationTestBase& Test;
+		FString Suite;
+		TArray<TSharedPtr<FJsonValue>> Results;
+	};
+
+	TArray<FPrometheusLabel> MakeLabels(int32 NumLabels, int32 Variant)
+	{
+		TArray<FPrometheusLabel> Labels;
+		for (int32 Index = 0; Index < NumLabels; ++Index)
+		{
+			Labels.Emplace(FString::Printf(TEXT("label_%d"), Index), FString::Printf(TEXT("value_%d_%d"), Index, Variant));
+		}
+		return Labels;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMetricsGetMetricBenchmark, "MetricsServiceProvider.Benchmarks.GetMetric",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+// Creating a series, and looking an existing one up again, by label count.
+bool FMetricsGetMetricBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumSeries = 1000;
+	constexpr int32 NumLookups = 100000;
+
+	FBenchmarkReport Report(*this, TEXT("GetMetric"));
+	for (const int32 NumLabels : { 0, 2, 8 })
+	{
+		TSharedRef<FPrometheusServer, ESPMode::ThreadSafe> Server = MakeShared<FPrometheusServer, ESPMode::ThreadSafe>();
+
+		// Without labels every call resolves to the one series.
+		TArray<TArray<FPrometheusLabel>> LabelSets;
+		for (int32 Index = 0; Index < NumSeries; ++Index)
+		{
+			LabelSets.Add(MakeLabels(NumLabels, Index));
+		}
+
+		double StartTime = FPlatformTime::Seconds();
+		for (const TArray<FPrometheusLabel>& Labels : LabelSets)
+		{
+			Server->GetMetric(TEXT("benchmark_metric"), Labels);
+		}
+		Report.AddResult(FString::Printf(TEXT("Create/%dLabels"), NumLabels), NumSeries, FPlatformTime::Seconds() - StartTime)
+			->SetNumberField(TEXT("labels"), NumLabels);
+
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < NumLookups; ++Index)
+		{
+			Server->GetMetric(TEXT("benchmark_metric"), LabelSets[Index % NumSeries]);
+		}
+		Report.AddResult(FString::Printf(TEXT("Lookup/%dLabels"), NumLabels), NumLookups, FPlatformTime::Seconds() - StartTime)
+			->SetNumberField(TEXT("labels"), NumLabels);
+	}
+	Report.Save();
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMetricsContentionBenchmark, "MetricsServiceProvider.Benchmarks.Contention",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+// Set() and Increment() on one series from several threads at once.
+bool FMetricsContentionBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumOperationsPerThread = 200000;
+
+	FBenchmarkReport Report(*this, TEXT("Contention"));
+	for (const int32 NumThreads : { 1, 2, 4, 8 })
+	{
+		TSharedRef<FPrometheusServer, ESPMode::ThreadSafe> Server = MakeShared<FPrometheusServer, ESPMode::ThreadSafe>();
+		FPrometheusMetricHandle Gauge = Server->RegisterMetric(TEXT("benchmark_gauge"), {});
+		FPrometheusMetricHandle Counter = Server->RegisterMetric(TEXT("benchmark_counter"), {});
+
+		double StartTime = FPlatformTime::Seconds();
+		ParallelFor(NumThreads, [&Gauge](int32 ThreadIndex) {
+			for (int32 Index = 0; Index < NumOperationsPerThread; ++Index)
+			{
+				Gauge.Set(Index);
+			}
+		});
+		Report.AddResult(FString::Printf(TEXT("Set/%dThreads"), NumThreads), static_cast<int64>(NumThreads) * NumOperationsPerThread,
+			FPlatformTime::Seconds() - StartTime)->SetNumberField(TEXT("threads"), NumThreads);
+
+		StartTime = FPlatformTime::Seconds();
+		ParallelFor(NumThreads, [&Counter](int32 ThreadIndex) {
+			for (int32 Index = 0; Index < NumOperationsPerThread; ++Index)
+			{
+				Counter.Increment(1);
+			}
+		});
+		Report.AddResult(FString::Printf(TEXT("Increment/%dThreads"), NumThreads), static_cast<int64>(NumThreads) * NumOperationsPerThread,
+			FPlatformTime::Seconds() - StartTime)->SetNumberField(TEXT("threads"), NumThreads);
+
+		// Contention mustn't lose increments.
+		TestEqual(FString::Printf(TEXT("Counter total with %d threads"), NumThreads),
+			Server->GetMetric(TEXT("benchmark_counter"), {})->GetValue(), static_cast<double>(NumThreads) * NumOperationsPerThread);
+	}
+	Report.Save();
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMetricsSerializeBenchmark, "MetricsServiceProvider.Benchmarks.Serialize",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+// Building the exposition body, by series count.
+bool FMetricsSerializeBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumIterations = 10;
+
+	// Spread over names so no name hits the per-name series cap.
+	constexpr int32 NumSeriesPerName = 100;
+
+	FBenchmarkReport Report(*this, TEXT("Serialize"));
+	for (const int32 NumSeries : { 1000, 10000, 100000 })
+	{
+		TSharedRef<FPrometheusServer, ESPMode::ThreadSafe> Server = MakeShared<FPrometheusServer, ESPMode::ThreadSafe>();
+		for (int32 Index = 0; Index < NumSeries; ++Index)
+		{
+			const TArray<FPrometheusLabel> Labels = { FPrometheusLabel(TEXT("series"), FString::FromInt(Index % NumSeriesPerName)) };
+			Server->RegisterMetric(FString::Printf(TEXT("benchmark_metric_%d"), Index / NumSeriesPerName), Labels).Set(Index * 0.25);
+		}
+
+		// Warm up the writer's buffer.
+		Server->Serialize();
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			Server->Serialize();
+		}
+		TSharedRef<FJsonObject> Result = Report.AddResult(FString::Printf(TEXT("Serialize/%dSeries"), NumSeries), NumIterations,
+			FPlatformTime::Seconds() - StartTime);
+		Result->SetNumberField(TEXT("series"), NumSeries);
+		Result->SetNumberField(TEXT("bytes"), Server->ExpositionWriter->GetBuffer().Num());
+	}
+	Report.Save();
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMetricsTelemetryBenchmark, "MetricsServiceProvider.Benchmarks.Telemetry",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+// TelemetryClassEvent() and FlushEvents() on the game thread, then how long the worker takes to hand the batch back.
+bool FMetricsTelemetryBenchmark::RunTest(const FString& Parameters)
+{
+	constexpr double BatchTimeoutSeconds = 30.0;
+
+	const TArray<FAnalyticsEventAttribute> Attributes = { FAnalyticsEventAttribute(TEXT("Benchmark"), TEXT("Telemetry")),
+		FAnalyticsEventAttribute(TEXT("Value"), TEXT("42")) };
+
+	FBenchmarkReport Report(*this, TEXT("Telemetry"));
+
+	// Nothing bigger than the queue, or we'd be timing drops rather than serialization.
+	for (const int32 BatchSize : { 10, 100, 1000, static_cast<int32>(FTelemetryWorker::QueueCapacity) })
+	{
+		// A private, isolated provider: it leaves the Prometheus route and the spool to the live one, and nothing it queues is
+		// posted while automation tests are running.
+		TSharedPtr<FAnalyticsProviderMetrics> Provider(new FAnalyticsProviderMetrics(TEXT("Benchmark"), FString(), FString(), FString(), BatchSize, 0.0f, /*bIsolated*/ true));
+
+		// Drop the start up event so only ours are counted.
+		Provider->FlushEvents();
+		FTelemetryBatch Batch;
+		while (Provider->TelemetryWorker->DequeueBatch(Batch))
+		{
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < BatchSize; ++Index)
+		{
+			Provider->TelemetryClassEvent(TEXT("benchmark"), TEXT("BenchmarkEvent"), FString(), Attributes);
+		}
+		Provider->FlushEvents();
+		const double GameThreadSeconds = FPlatformTime::Seconds() - StartTime;
+
+		const int32 NumDropped = static_cast<int32>(Provider->Prometheus->GetMetric(TEXT("telemetry_events"),
+			{ FPrometheusLabel(TEXT("status"), TEXT("dropped")), FPrometheusLabel(TEXT("reason"), TEXT("queue_full")) })->GetValue());
+
+		int32 NumSerialized = 0;
+		int64 NumBytes = 0;
+		while (NumSerialized < BatchSize && FPlatformTime::Seconds() - StartTime < BatchTimeoutSeconds)
+		{
+			if (Provider->TelemetryWorker->DequeueBatch(Batch))
+			{
+				NumSerialized += Batch.NumEvents;
+				NumBytes += Batch.Content.Num();
+			}
+			else
+			{
+				FPlatformProcess::Sleep(0.0f);
+			}
+		}
+		const double EndToEndSeconds = FPlatformTime::Seconds() - StartTime;
+
+		TSharedRef<FJsonObject> GameThread = Report.AddResult(FString::Printf(TEXT("GameThread/%dEvents"), BatchSize), BatchSize, GameThreadSeconds);
+		GameThread->SetNumberField(TEXT("batchSize"), BatchSize);
+
+		TSharedRef<FJsonObject> EndToEnd = Report.AddResult(FString::Printf(TEXT("Serialized/%dEvents"), BatchSize), NumSerialized, EndToEndSeconds);
+		EndToEnd->SetNumberField(TEXT("batchSize"), BatchSize);
+		EndToEnd->SetNumberField(TEXT("bytes"), NumBytes);
+
+		TestEqual(FString::Printf(TEXT("No events dropped with batches of %d"), BatchSize), NumDropped, 0);
+		TestEqual(FString::Printf(TEXT("Every event serialized with batches of %d"), BatchSize), NumSerialized, BatchSize);
+	}
+	Report.Save();
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
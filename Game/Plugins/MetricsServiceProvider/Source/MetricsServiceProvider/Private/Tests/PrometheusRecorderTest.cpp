@@ -0,0 +1,60 @@
+#include "PrometheusRecorder.h"
+
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPrometheusRecorderTest, "MetricsServiceProvider.Prometheus.Recorder",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FPrometheusRecorderTest::RunTest(const FString& Parameters)
+{
+	// Repeats, small changes, sign flips, and the NaN the recorder writes for missed samples.
+	const TArray<double> Values = { 16.7, 16.7, 16.7, 16.8, 33.3, -1.0, 0.0, 1e300, FMath::Sqrt(-1.0), FMath::Sqrt(-1.0), 16.7, 5.0e-324 };
+
+	TArray<uint8> Encoded;
+	FPrometheusRecorder::EncodeColumn(Values, Encoded);
+	TestTrue(TEXT("Column is smaller than the raw doubles"), Encoded.Num() < Values.Num() * static_cast<int32>(sizeof(double)));
+
+	TArray<double> Decoded;
+	TestTrue(TEXT("Column decodes"), FPrometheusRecorder::DecodeColumn(Encoded.GetData(), Encoded.Num(), Values.Num(), Decoded));
+	TestEqual(TEXT("Decoded value count"), Decoded.Num(), Values.Num());
+	for (int32 Index = 0; Index < FMath::Min(Values.Num(), Decoded.Num()); ++Index)
+	{
+		// Bit exact, NaN included.
+		TestEqual(FString::Printf(TEXT("Value %d"), Index), FMemory::Memcmp(&Values[Index], &Decoded[Index], sizeof(double)), 0);
+	}
+
+	TestFalse(TEXT("Truncated column fails to decode"), FPrometheusRecorder::DecodeColumn(Encoded.GetData(), 4, Values.Num(), Decoded));
+
+	const FString RecordPath = FPaths::AutomationTransientDir() / TEXT("PrometheusRecorderTest.umr");
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.DeleteFile(*RecordPath);
+
+	{
+		FPrometheusRecorder Recorder(RecordPath, 0.1, 30);
+		const int32 Gauge = Recorder.AddSeries(TEXT("unreal_gauge{a=\"b\"}"));
+		const int32 Counter = Recorder.AddSeries(TEXT("unreal_counter"));
+		for (int32 Sample = 0; Sample < 100; ++Sample)
+		{
+			Recorder.BeginSample(1600000000000 + Sample * 100);
+			Recorder.RecordValue(Gauge, 60.0);
+			if (Sample % 2 == 0)
+			{
+				Recorder.RecordValue(Counter, Sample);
+			}
+			Recorder.EndSample();
+		}
+	}
+
+	const int64 FileSize = PlatformFile.FileSize(*RecordPath);
+	TestTrue(TEXT("Recording was written"), FileSize > 4);
+	TestTrue(TEXT("Recording is smaller than the raw samples"), FileSize < 100 * (sizeof(int64) + 2 * sizeof(double)));
+
+	PlatformFile.DeleteFile(*RecordPath);
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
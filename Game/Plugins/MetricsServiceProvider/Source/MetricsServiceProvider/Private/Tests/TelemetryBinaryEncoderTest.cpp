@@ -0,0 +1,289 @@
+#include "TelemetryBinaryEncoder.h"
+
+#include "Misc/AutomationTest.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "TelemetryWorker.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// Reads a batch back following the layout in TelemetryBinaryEncoder.h.
+	class FBinaryBatchReader
+	{
+	public:
+		struct FDecodedEvent
+		{
+			int64 EventIndex = 0;
+			int64 EventTimestamp = 0;
+			FString EventSource;
+			FString EventClass;
+			FString EventType;
+			FString AccountID;
+			FString ProfileID;
+			FString ServerSessionID;
+			FString ClientSessionID;
+			FString WorkerID;
+			TArray<TPair<FString, FString>> Attributes;
+			uint64 SampleRatePPM = 0;
+		};
+
+		explicit FBinaryBatchReader(const TArray<uint8>& InBytes)
+			: Bytes(InBytes)
+		{
+		}
+
+		bool Read()
+		{
+			Offset = 4;
+			const uint64 NumStrings = ReadVarInt();
+			for (uint64 i = 0; i < NumStrings && !bError; ++i)
+			{
+				const int32 Length = static_cast<int32>(ReadVarInt());
+				if (bError || Length < 0 || Offset + Length > Bytes.Num())
+				{
+					bError = true;
+					break;
+				}
+				const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Bytes.GetData() + Offset), Length);
+				Strings.Add(FString(Converted.Length(), Converted.Get()));
+				Offset += Length;
+			}
+
+			EventEnvironment = ReadString();
+			EngineVersion = ReadString();
+
+			const uint64 NumEvents = ReadVarInt();
+			int64 PreviousEventIndex = 0;
+			int64 PreviousTimestamp = 0;
+			for (uint64 i = 0; i < NumEvents && !bError; ++i)
+			{
+				FDecodedEvent& Event = Events.AddDefaulted_GetRef();
+				Event.EventIndex = PreviousEventIndex + UnZigZag(ReadVarInt());
+				Event.EventTimestamp = PreviousTimestamp + UnZigZag(ReadVarInt());
+				PreviousEventIndex = Event.EventIndex;
+				PreviousTimestamp = Event.EventTimestamp;
+
+				Event.EventSource = ReadString();
+				Event.EventClass = ReadString();
+				Event.EventType = ReadString();
+				Event.AccountID = ReadString();
+				Event.ProfileID = ReadString();
+				Event.ServerSessionID = ReadString();
+				Event.ClientSessionID = ReadString();
+				Event.WorkerID = ReadString();
+
+				const uint64 NumAttributes = ReadVarInt();
+				for (uint64 j = 0; j < NumAttributes && !bError; ++j)
+				{
+					const FString Name = ReadString();
+					Event.Attributes.Emplace(Name, ReadString());
+				}
+				Event.SampleRatePPM = ReadVarInt();
+			}
+
+			return !bError && Offset == Bytes.Num();
+		}
+
+		TArray<FString> Strings;
+		FString EventEnvironment;
+		FString EngineVersion;
+		TArray<FDecodedEvent> Events;
+
+	private:
+		uint64 ReadVarInt()
+		{
+			uint64 Value = 0;
+			for (int32 Shift = 0; Shift < 64; Shift += 7)
+			{
+				if (Offset >= Bytes.Num())
+				{
+					break;
+				}
+				const uint8 Byte = Bytes[Offset++];
+				Value |= static_cast<uint64>(Byte & 0x7f) << Shift;
+				if ((Byte & 0x80) == 0)
+				{
+					return Value;
+				}
+			}
+			bError = true;
+			return 0;
+		}
+
+		FString ReadString()
+		{
+			const uint64 Index = ReadVarInt();
+			if (Index >= static_cast<uint64>(Strings.Num()))
+			{
+				bError = true;
+				return FString();
+			}
+			return Strings[static_cast<int32>(Index)];
+		}
+
+		static int64 UnZigZag(uint64 Value)
+		{
+			return static_cast<int64>(Value >> 1) ^ -static_cast<int64>(Value & 1);
+		}
+
+		const TArray<uint8>& Bytes;
+		int32 Offset = 0;
+		bool bError = false;
+	};
+
+	// The body FTelemetryWorker posts when binary encoding is off.
+	TArray<uint8> EncodeJson(const TArray<FTelemetryEvent>& Events, const FString& EventEnvironment, const FString& EngineVersion)
+	{
+		FString Payload = TEXT("[");
+		for (int32 Index = 0; Index < Events.Num(); ++Index)
+		{
+			Payload += Events[Index].Stringify(EventEnvironment, EngineVersion);
+			Payload += Index == Events.Num() - 1 ? TEXT("]") : TEXT(",");
+		}
+
+		const FTCHARToUTF8 Converted(*Payload);
+		return TArray<uint8>(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+	}
+
+	TArray<FTelemetryEvent> MakeEvents(int32 NumEvents)
+	{
+		TArray<TSharedPtr<const FTelemetrySessionDetails, ESPMode::ThreadSafe>> Sessions;
+		for (int32 i = 0; i < 3; ++i)
+		{
+			TSharedRef<FTelemetrySessionDetails, ESPMode::ThreadSafe> Details = MakeShared<FTelemetrySessionDetails, ESPMode::ThreadSafe>();
+			Details->AccountID = FString::Printf(TEXT("account-%d"), i);
+			Details->ProfileID = FString::Printf(TEXT("profile-%d"), i);
+			Details->ServerSessionID = TEXT("server-session");
+			Details->ClientSessionID = FString::Printf(TEXT("client-session-%d"), i);
+			Details->WorkerID = TEXT("UnrealWorker-1");
+			Sessions.Add(Details);
+		}
+
+		TArray<FTelemetryEvent> Events;
+		for (int32 i = 0; i < NumEvents; ++i)
+		{
+			FTelemetryEvent& Event = Events.AddDefaulted_GetRef();
+			Event.EventIndex = 1000 + i;
+			// Timestamps mostly rise, but events can be queued out of order.
+			Event.EventTimestamp = 1600000000 + i / 10 - (i % 7 == 3 ? 2 : 0);
+			Event.EventSource = i % 4 == 0 ? TEXT("Client") : TEXT("Server");
+			Event.EventClass = i % 2 == 0 ? TEXT("nfr") : TEXT("session");
+			Event.EventType = FString::Printf(TEXT("type_%d"), i % 5);
+			// Every fifth event has no session, so every ID encodes as the empty string.
+			if (i % 5 != 4)
+			{
+				Event.SessionDetails = Sessions[i % Sessions.Num()];
+			}
+			if (i % 3 == 0)
+			{
+				Event.EventAttributes.Emplace(TEXT("fps"), FString::Printf(TEXT("%d"), 30 + i % 30));
+				Event.EventAttributes.Emplace(TEXT("map"), TEXT("BenchmarkGym"));
+			}
+			Event.SampleRate = i % 8 == 0 ? 0.25f : 1.0f;
+		}
+		return Events;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTelemetryBinaryEncoderTest, "MetricsServiceProvider.Telemetry.BinaryEncoder",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FTelemetryBinaryEncoderTest::RunTest(const FString& Parameters)
+{
+	// Varints and zigzag.
+	{
+		TArray<uint8> Bytes;
+		FTelemetryBinaryEncoder::WriteVarInt(Bytes, 0);
+		FTelemetryBinaryEncoder::WriteVarInt(Bytes, 127);
+		FTelemetryBinaryEncoder::WriteVarInt(Bytes, 300);
+		TestTrue(TEXT("Varints are LEB128"), Bytes == TArray<uint8>({ 0x00, 0x7f, 0xac, 0x02 }));
+
+		TestEqual(TEXT("ZigZag 0"), static_cast<int64>(FTelemetryBinaryEncoder::ZigZag(0)), static_cast<int64>(0));
+		TestEqual(TEXT("ZigZag -1"), static_cast<int64>(FTelemetryBinaryEncoder::ZigZag(-1)), static_cast<int64>(1));
+		TestEqual(TEXT("ZigZag 1"), static_cast<int64>(FTelemetryBinaryEncoder::ZigZag(1)), static_cast<int64>(2));
+		TestEqual(TEXT("ZigZag -2"), static_cast<int64>(FTelemetryBinaryEncoder::ZigZag(-2)), static_cast<int64>(3));
+	}
+
+	const FString EventEnvironment = TEXT("testing");
+	const FString EngineVersion = TEXT("4.26.0-GDK");
+	const TArray<FTelemetryEvent> Events = MakeEvents(500);
+
+	FTelemetryBinaryEncoder Encoder;
+	TArray<uint8> Binary;
+	Encoder.Encode(Events, EventEnvironment, EngineVersion, Binary);
+	const TArray<uint8> Json = EncodeJson(Events, EventEnvironment, EngineVersion);
+
+	TestTrue(TEXT("Encoded batch is recognised as binary"), FTelemetryBinaryEncoder::IsBinaryBatch(Binary));
+	TestFalse(TEXT("JSON batch isn't recognised as binary"), FTelemetryBinaryEncoder::IsBinaryBatch(Json));
+	TestTrue(TEXT("Batch starts with the magic"), Binary.Num() >= 4 && Binary[0] == 'U' && Binary[1] == 'T' && Binary[2] == 'B' && Binary[3] == '1');
+
+	// Every event reads back as it went in.
+	FBinaryBatchReader Reader(Binary);
+	if (!TestTrue(TEXT("Batch reads back to its last byte"), Reader.Read()))
+	{
+		return false;
+	}
+
+	TestTrue(TEXT("String 0 is the empty string"), Reader.Strings.Num() > 0 && Reader.Strings[0].IsEmpty());
+	TestEqual(TEXT("Each distinct string is written once"), TSet<FString>(Reader.Strings).Num(), Reader.Strings.Num());
+	TestEqual(TEXT("Environment"), Reader.EventEnvironment, EventEnvironment);
+	TestEqual(TEXT("Engine version"), Reader.EngineVersion, EngineVersion);
+
+	if (!TestEqual(TEXT("Event count"), Reader.Events.Num(), Events.Num()))
+	{
+		return false;
+	}
+	for (int32 i = 0; i < Events.Num(); ++i)
+	{
+		const FTelemetryEvent& Expected = Events[i];
+		const FBinaryBatchReader::FDecodedEvent& Actual = Reader.Events[i];
+		const FTelemetrySessionDetails EmptySession;
+		const FTelemetrySessionDetails& Session = Expected.SessionDetails.IsValid() ? *Expected.SessionDetails : EmptySession;
+
+		bool bMatches = Actual.EventIndex == Expected.EventIndex
+			&& Actual.EventTimestamp == Expected.EventTimestamp
+			&& Actual.EventSource == Expected.EventSource
+			&& Actual.EventClass == Expected.EventClass
+			&& Actual.EventType == Expected.EventType
+			&& Actual.AccountID == Session.AccountID
+			&& Actual.ProfileID == Session.ProfileID
+			&& Actual.ServerSessionID == Session.ServerSessionID
+			&& Actual.ClientSessionID == Session.ClientSessionID
+			&& Actual.WorkerID == Session.WorkerID
+			&& Actual.Attributes.Num() == Expected.EventAttributes.Num()
+			&& Actual.SampleRatePPM == (Expected.SampleRate < 1.0f ? 250000u : 0u);
+		for (int32 j = 0; bMatches && j < Actual.Attributes.Num(); ++j)
+		{
+#if ENGINE_MINOR_VERSION >= 27
+			bMatches = Actual.Attributes[j].Key == Expected.EventAttributes[j].GetName() && Actual.Attributes[j].Value == Expected.EventAttributes[j].GetValue();
+#else
+			bMatches = Actual.Attributes[j].Key == Expected.EventAttributes[j].AttrName && Actual.Attributes[j].Value == Expected.EventAttributes[j].ToString();
+#endif
+		}
+		if (!TestTrue(*FString::Printf(TEXT("Event %d reads back unchanged"), i), bMatches))
+		{
+			break;
+		}
+	}
+
+	// Reusing the encoder starts each batch afresh.
+	{
+		TArray<uint8> Again;
+		Encoder.Encode(Events, EventEnvironment, EngineVersion, Again);
+		TestTrue(TEXT("Reused encoder produces the same batch"), Again == Binary);
+
+		TArray<uint8> Empty;
+		Encoder.Encode(TArray<FTelemetryEvent>(), EventEnvironment, EngineVersion, Empty);
+		FBinaryBatchReader EmptyReader(Empty);
+		TestTrue(TEXT("Empty batch reads back"), EmptyReader.Read() && EmptyReader.Events.Num() == 0);
+	}
+
+	// Field names and repeated session strings are where the saving comes from.
+	AddInfo(FString::Printf(TEXT("%d events: %d bytes binary, %d bytes JSON"), Events.Num(), Binary.Num(), Json.Num()));
+	TestTrue(TEXT("Binary batch is under a quarter of the JSON one"), Binary.Num() * 4 < Json.Num());
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
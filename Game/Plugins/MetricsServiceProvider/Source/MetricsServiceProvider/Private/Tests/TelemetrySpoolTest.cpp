@@ -0,0 +1,148 @@
+#include "TelemetrySpool.h"
+
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	TArray<uint8> MakeBody(const FString& Text)
+	{
+		const FTCHARToUTF8 Converted(*Text);
+		return TArray<uint8>(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTelemetrySpoolTest, "MetricsServiceProvider.Telemetry.Spool",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FTelemetrySpoolTest::RunTest(const FString& Parameters)
+{
+	const FString SpoolPath = FPaths::AutomationTransientDir() / TEXT("TelemetrySpoolTest.bin");
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.DeleteFile(*SpoolPath);
+
+	const TArray<uint8> First = MakeBody(TEXT("[{\"eventIndex\":1}]"));
+	const TArray<uint8> Second = MakeBody(TEXT("[{\"eventIndex\":2},{\"eventIndex\":3}]"));
+
+	{
+		FTelemetrySpool Spool(SpoolPath, 1024);
+		TestTrue(TEXT("New spool is empty"), Spool.IsEmpty());
+		TestTrue(TEXT("Append first batch"), Spool.Append(First, 1));
+		TestTrue(TEXT("Append second batch"), Spool.Append(Second, 2));
+
+		TArray<uint8> Body;
+		int32 NumEvents = 0;
+		TestTrue(TEXT("Peek returns the oldest batch"), Spool.Peek(Body, NumEvents));
+		TestEqual(TEXT("Oldest batch body"), Body, First);
+		TestEqual(TEXT("Oldest batch event count"), NumEvents, 1);
+
+		// Not popped, a failed replay leaves it at the front.
+		TestTrue(TEXT("Peek again"), Spool.Peek(Body, NumEvents));
+		TestEqual(TEXT("Still the oldest batch"), Body, First);
+		Spool.Pop();
+	}
+
+	// A spool left behind by an earlier run is replayed from where that run got to.
+	{
+		FTelemetrySpool Spool(SpoolPath, 1024);
+		TestFalse(TEXT("Reopened spool has data"), Spool.IsEmpty());
+
+		TArray<uint8> Body;
+		int32 NumEvents = 0;
+		TestTrue(TEXT("Replay second batch"), Spool.Peek(Body, NumEvents));
+		TestEqual(TEXT("Replayed second batch"), Body, Second);
+		TestEqual(TEXT("Replayed second batch event count"), NumEvents, 2);
+		Spool.Pop();
+
+		TestTrue(TEXT("Spool is empty after replay"), Spool.IsEmpty());
+		TestFalse(TEXT("Spool file deleted after replay"), PlatformFile.FileExists(*SpoolPath));
+	}
+
+	// A record cut short by a crash is trimmed off, so batches spooled by the next run still replay.
+	{
+		{
+			FTelemetrySpool Spool(SpoolPath, 1024);
+			TestTrue(TEXT("Append before the crash"), Spool.Append(First, 1));
+		}
+		TArray<uint8> Contents;
+		FFileHelper::LoadFileToArray(Contents, *SpoolPath);
+		Contents.Append(TArray<uint8>{ 2, 0, 0, 0, 100, 0, 0, 0, '[' });
+		FFileHelper::SaveArrayToFile(Contents, *SpoolPath);
+
+		FTelemetrySpool Spool(SpoolPath, 1024);
+		TestEqual(TEXT("Partial record trimmed"), PlatformFile.FileSize(*SpoolPath), static_cast<int64>(First.Num() + 8));
+		TestTrue(TEXT("Append after the crash"), Spool.Append(Second, 2));
+
+		TArray<uint8> Body;
+		int32 NumEvents = 0;
+		TestTrue(TEXT("Replay batch from before the crash"), Spool.Peek(Body, NumEvents));
+		TestEqual(TEXT("Batch from before the crash"), Body, First);
+		Spool.Pop();
+		TestTrue(TEXT("Replay batch from after the crash"), Spool.Peek(Body, NumEvents));
+		TestEqual(TEXT("Batch from after the crash"), Body, Second);
+		Spool.Pop();
+	}
+	PlatformFile.DeleteFile(*SpoolPath);
+
+	// Size cap.
+	{
+		FTelemetrySpool Spool(SpoolPath, First.Num() + 8);
+		TestTrue(TEXT("Batch within the cap is spooled"), Spool.Append(First, 1));
+		TestFalse(TEXT("Batch over the cap is rejected"), Spool.Append(Second, 2));
+	}
+	PlatformFile.DeleteFile(*SpoolPath);
+
+	// The cap is on the file, popped records are compacted away rather than counted against it forever.
+	{
+		const int64 MaxSizeBytes = (First.Num() + 8) * 3;
+		FTelemetrySpool Spool(SpoolPath, MaxSizeBytes);
+		TestTrue(TEXT("Fill the spool"), Spool.Append(First, 1) && Spool.Append(First, 1) && Spool.Append(First, 1));
+
+		TArray<uint8> Body;
+		int32 NumEvents = 0;
+		TestTrue(TEXT("Replay oldest batch"), Spool.Peek(Body, NumEvents));
+		Spool.Pop();
+
+		TestTrue(TEXT("Batch fits once the replayed one is compacted away"), Spool.Append(First, 1));
+		TestTrue(TEXT("Spool file stays within the cap"), PlatformFile.FileSize(*SpoolPath) <= MaxSizeBytes);
+		TestTrue(TEXT("Replay after compaction"), Spool.Peek(Body, NumEvents));
+		TestEqual(TEXT("Records survive compaction"), Body, First);
+	}
+	PlatformFile.DeleteFile(*SpoolPath);
+
+	// Compaction copies on another thread while the spool carries on being used, and is swapped in afterwards.
+	{
+		TArray<TUniqueFunction<void()>> Deferred;
+		const int64 RecordSize = First.Num() + 8;
+		FTelemetrySpool Spool(SpoolPath, RecordSize * 6, [&Deferred](TUniqueFunction<void()>&& Task) { Deferred.Add(MoveTemp(Task)); });
+		TestTrue(TEXT("Fill the spool"), Spool.Append(First, 1) && Spool.Append(First, 1) && Spool.Append(First, 1) && Spool.Append(First, 1));
+
+		TArray<uint8> Body;
+		int32 NumEvents = 0;
+		for (int32 Index = 0; Index < 3; ++Index)
+		{
+			Spool.Peek(Body, NumEvents);
+			Spool.Pop();
+		}
+		TestEqual(TEXT("Half the cap replayed starts a compaction"), Deferred.Num(), 1);
+		TestTrue(TEXT("Append while compacting"), Spool.Append(Second, 2));
+
+		Deferred[0]();
+		Spool.Tick();
+		TestEqual(TEXT("Compacted file holds the unreplayed and newly appended records"), PlatformFile.FileSize(*SpoolPath), RecordSize + Second.Num() + 8);
+		TestTrue(TEXT("Replay the record copied by the compaction"), Spool.Peek(Body, NumEvents));
+		TestEqual(TEXT("Record copied by the compaction"), Body, First);
+		Spool.Pop();
+		TestTrue(TEXT("Replay the record appended while compacting"), Spool.Peek(Body, NumEvents));
+		TestEqual(TEXT("Record appended while compacting"), Body, Second);
+		Spool.Pop();
+		TestFalse(TEXT("Spool file deleted after replay"), PlatformFile.FileExists(*SpoolPath));
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
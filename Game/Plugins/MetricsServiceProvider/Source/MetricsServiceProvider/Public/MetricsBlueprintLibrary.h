@@ -90,5 +90,12 @@ public:
 
 	static void CacheProfileDetails(const FString& ProfileID, const FString& AccountID, const FString& ClientSessionID);
 
-	static TSharedPtr<FPrometheusMetric> GetMetric(const FString& Name, const TArray<FPrometheusLabel>& Labels);
+	static TSharedPtr<FPrometheusMetric, ESPMode::ThreadSafe> GetMetric(const FString& Name, const TArray<FPrometheusLabel>& Labels);
+
+	/** Resolves a metric once for repeated updates. Returns an invalid handle if the metrics provider isn't available yet. */
+	static FPrometheusMetricHandle RegisterMetric(const FString& Name, const TArray<FPrometheusLabel>& Labels);
+
+	/** Distribution metrics, see FPrometheusHistogram/FPrometheusSummary. Returns nullptr if the metrics provider isn't available yet. */
+	static TSharedPtr<FPrometheusHistogram, ESPMode::ThreadSafe> GetHistogram(const FString& Name, const TArray<FPrometheusLabel>& Labels, const TArray<double>& BucketBounds);
+	static TSharedPtr<FPrometheusSummary, ESPMode::ThreadSafe> GetSummary(const FString& Name, const TArray<FPrometheusLabel>& Labels, const TArray<double>& Quantiles = FPrometheusSummary::DefaultQuantiles());
 };
@@ -1,7 +1,12 @@
 #pragma once
 
+#include "Async/Future.h"
 #include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
 #include "HttpRouteHandle.h"
+#include "Templates/Function.h"
+
+#include <atomic>
 
 /*
  * Basic Prometheus metrics exporter
@@ -10,26 +15,61 @@
  *   Call GetMetric() rarely, cache the result/you own it.  Each metric name/set of labels is a unique value.
  *   Call Set() as often as you want.
  *
- *   ProcessPrometheusRequest() will be called periodically by our metrics scraper.
+ *   For hot paths prefer RegisterMetric(), which hands back an FPrometheusMetricHandle.  Resolve it once (e.g. in BeginPlay)
+ *   and keep it; setting through the handle never rebuilds the label key or touches the metric maps.
+ *
+ *   Set()/Increment() are safe from any thread.  GetMetric()/RegisterMetric() are too, but take the registry lock.
+ *   Series are shared with ESPMode::ThreadSafe, so handles and the pointers returned here can be copied and released anywhere.
+ *
+ *   Distributions (latency, frame time) should use GetHistogram() or GetSummary() rather than averaging into a single value,
+ *   so the tail can be scraped.  Observe() on either is safe from any thread.
+ *
+ *   Series that are registered but never updated are evicted after 30 minutes, and each metric name keeps at most
+ *   -prometheusMaxSeriesPerName= series (default 1000), dropping the least recently updated.  Evicting series that have been
+ *   updated but gone quiet is opt-in with -prometheusSeriesIdleMinutes=, since a gauge that is set once and left (a latched
+ *   failure, a final result) would otherwise vanish from scrapes.  A series you still hold keeps working: it's re-exported the
+ *   next time it's updated.  The registry's own prometheus_series* metrics are never evicted.
+ *
+ *   -prometheusRecordHz=10 additionally samples every gauge/counter series ten times a second into a local run file under
+ *   Saved/Metrics (or -prometheusRecordPath=), see FPrometheusRecorder for the format.
+ *
+ *   ProcessPrometheusRequest() will be called periodically by our metrics scraper.  It never serializes, it serves the last
+ *   snapshot published by Tick(), which the owner calls once per frame on the game thread.
+ *
+ *   With STATS enabled, game thread stats are exported as stat{name="...",field="..."}.  Which stats, and how often they're
+ *   refreshed, is configured by -prometheusStats=Prefix1,Prefix2 and -prometheusStatsInterval=Seconds, or StatPrefixes and
+ *   StatExportIntervalSeconds in the [Prometheus] section of the engine ini.  No prefixes exports every stat.
  */
 
+class FPrometheusExpositionWriter;
+class FPrometheusRecorder;
 class IHttpRouter;
 
 typedef TPair<FString, FString> FPrometheusLabel;
 
 // Reference: https://github.com/prometheus/docs/blob/master/content/docs/instrumenting/exposition_formats.md#basic-info
+//
+// Set() and Increment() are lock free and may be called from any thread (game, net, physics, task graph workers) while the
+// HTTP route is reading the value.  Increment() writes to a per-thread shard so concurrent counters don't fight over one cache line.
+// Mixing Set() and Increment() on the same series from different threads at the same time is not linearizable, use one or the other.
 class METRICSSERVICEPROVIDER_API FPrometheusMetric
 {
 public:
 	FPrometheusMetric(){};
+	~FPrometheusMetric();
+
+	FPrometheusMetric(const FPrometheusMetric&) = delete;
+	FPrometheusMetric& operator=(const FPrometheusMetric&) = delete;
 
 	FString ToString() const;
 
+	double GetValue() const;
+
 	// HasBeenUpdated is use to check to see if the metric has ever actually had values set.
 	// We may end up with metrics that are created, but never updated and this is used to prune our results down a lot.
 	bool HasBeenUpdated() const
 	{
-		return Timestamp != 0;
+		return Timestamp.load(std::memory_order_relaxed) != 0;
 	};
 
 	void Set(double Value);
@@ -39,26 +79,360 @@ public:
 	void Increment(double Amount, const FDateTime& Timestamp);
 
 private:
-	double Value = 0.0;
-	int64 Timestamp = 0;
+	static constexpr int32 NumShards = 8;
+
+	// Padded so each shard sits on its own cache line.
+	struct FShard
+	{
+		std::atomic<uint64> Bits{ 0 };
+		uint8 Padding[PLATFORM_CACHE_LINE_SIZE - sizeof(std::atomic<uint64>)];
+	};
+
+	FShard* GetOrCreateShards();
+
+	// Doubles are stored as their bit pattern so they can live in a plain 64 bit atomic.
+	std::atomic<uint64> ValueBits{ 0 };
+	std::atomic<int64> Timestamp{ 0 };
+
+	// Allocated on the first Increment(), gauges that are only ever Set() never pay for them.
+	std::atomic<FShard*> Shards{ nullptr };
+
+	friend class FPrometheusServer;
+
+	// Last update, or registration if it's never been updated. Used for eviction.
+	int64 GetLastUpdateTimestamp() const
+	{
+		const int64 LastUpdate = Timestamp.load(std::memory_order_relaxed);
+		return LastUpdate != 0 ? LastUpdate : RegisteredTimestamp;
+	}
+
+	// Every update is already timestamped, nothing to do.
+	void RefreshLastUpdateTimestamp(int64 Now)
+	{
+	}
+
+	bool bEvictable = true;
+
+	// "<name>{labels} " as UTF-8, filled in by the server when the series is registered.
+	TArray<uint8> SeriesPrefix;
+	int64 RegisteredTimestamp = 0;
+
+	// Column this series is written to by the recorder, assigned the first time it's sampled.
+	int32 RecorderSeriesId = INDEX_NONE;
+};
+
+// Stable, cheap to copy reference to a single registered series.  A default constructed handle is invalid and ignores writes,
+// so callers can hold one before the metrics provider exists and resolve it lazily.
+class METRICSSERVICEPROVIDER_API FPrometheusMetricHandle
+{
+public:
+	FPrometheusMetricHandle(){};
+
+	bool IsValid() const
+	{
+		return Metric.IsValid();
+	}
+
+	void Set(double Value) const
+	{
+		if (Metric.IsValid())
+		{
+			Metric->Set(Value);
+		}
+	}
+
+	void Increment(double Amount) const
+	{
+		if (Metric.IsValid())
+		{
+			Metric->Increment(Amount);
+		}
+	}
+
+	void Reset()
+	{
+		Metric.Reset();
+	}
+
+private:
+	friend class FPrometheusServer;
+
+	explicit FPrometheusMetricHandle(const TSharedRef<FPrometheusMetric, ESPMode::ThreadSafe>& InMetric)
+		: Metric(InMetric)
+	{
+	}
+
+	TSharedPtr<FPrometheusMetric, ESPMode::ThreadSafe> Metric;
+};
+
+// Histogram with fixed bucket upper bounds, exposed as <name>_bucket{le="..."}, <name>_sum and <name>_count.
+// Observe() does a binary search over the bounds and a couple of relaxed atomic adds, no locks.
+class METRICSSERVICEPROVIDER_API FPrometheusHistogram
+{
+public:
+	// Bounds are the inclusive upper bound of each bucket, an implicit +Inf bucket is always added.
+	explicit FPrometheusHistogram(TArray<double> InBucketBounds);
+
+	FPrometheusHistogram(const FPrometheusHistogram&) = delete;
+	FPrometheusHistogram& operator=(const FPrometheusHistogram&) = delete;
+
+	void Observe(double Value);
+
+	bool HasBeenUpdated() const
+	{
+		return Count.load(std::memory_order_relaxed) != 0;
+	}
+
+	// Appends the exposition lines for this series.
+	void Serialize(FPrometheusExpositionWriter& Writer) const;
+
+	// Helpers for building bucket bounds, e.g. ExponentialBuckets(1.0, 2.0, 10) => 1, 2, 4 ... 512.
+	static TArray<double> LinearBuckets(double Start, double Width, int32 Count);
+	static TArray<double> ExponentialBuckets(double Start, double Factor, int32 Count);
+
+private:
+	friend class FPrometheusServer;
+
+	// Builds the per line prefixes, called by the server when the series is registered. LabelKey is the series' "{...}" label string.
+	void SetSeries(const FString& Name, const FString& LabelKey);
+
+	// Observe() doesn't read the clock, so for eviction the server's periodic sweep stamps the time whenever it sees Count move.
+	int64 GetLastUpdateTimestamp() const
+	{
+		return LastUpdateTimestamp;
+	}
+	void RefreshLastUpdateTimestamp(int64 Now);
+
+	int64 LastUpdateTimestamp = 0;
+	uint64 CountAtLastRefresh = 0;
+	bool bEvictable = true;
+
+	TArray<double> BucketBounds;
+	TArray<FString> BucketLabels;
+
+	TArray<TArray<uint8>> BucketPrefixes;
+	TArray<uint8> SumPrefix;
+	TArray<uint8> CountPrefix;
+
+	// One count per bound plus the +Inf bucket. Counts are per bucket and made cumulative when serialized.
+	TUniquePtr<std::atomic<uint64>[]> BucketCounts;
+
+	std::atomic<uint64> SumBits{ 0 };
+	std::atomic<uint64> Count{ 0 };
+};
+
+// Summary reporting quantiles over a sliding window of the most recent observations, plus lifetime <name>_sum and <name>_count.
+// Observe() writes into a fixed size ring with a single atomic increment, quantiles are only computed when scraped.
+class METRICSSERVICEPROVIDER_API FPrometheusSummary
+{
+public:
+	FPrometheusSummary(TArray<double> InQuantiles, int32 InWindowSize);
+
+	FPrometheusSummary(const FPrometheusSummary&) = delete;
+	FPrometheusSummary& operator=(const FPrometheusSummary&) = delete;
+
+	void Observe(double Value);
+
+	// Publishes quantiles computed elsewhere (e.g. merged from several servers' sketches) in place of the window's.  _sum and
+	// _count stay lifetime totals as Prometheus expects, so pass only the observations that are new since the last call.
+	void SetQuantiles(TFunctionRef<double(double Quantile)> GetQuantile, double AddedSum, uint64 AddedCount);
+
+	bool HasBeenUpdated() const
+	{
+		return Count.load(std::memory_order_relaxed) != 0;
+	}
+
+	void Serialize(FPrometheusExpositionWriter& Writer) const;
+
+	static const TArray<double>& DefaultQuantiles();
+	static constexpr int32 DefaultWindowSize = 1024;
+
+private:
+	friend class FPrometheusServer;
+
+	void SetSeries(const FString& Name, const FString& LabelKey);
+
+	// Same eviction bookkeeping as FPrometheusHistogram.
+	int64 GetLastUpdateTimestamp() const
+	{
+		return LastUpdateTimestamp;
+	}
+	void RefreshLastUpdateTimestamp(int64 Now);
+
+	int64 LastUpdateTimestamp = 0;
+	uint64 CountAtLastRefresh = 0;
+	bool bEvictable = true;
+
+	TArray<double> Quantiles;
+	TArray<FString> QuantileLabels;
+
+	TArray<TArray<uint8>> QuantilePrefixes;
+	TArray<uint8> SumPrefix;
+	TArray<uint8> CountPrefix;
+
+	const int32 WindowSize;
+	TUniquePtr<std::atomic<uint64>[]> Window;
+	std::atomic<uint64> NextSample{ 0 };
+
+	// One per quantile, only used once SetQuantiles() has been called.
+	TUniquePtr<std::atomic<uint64>[]> SetQuantileBits;
+	std::atomic<bool> bQuantilesSet{ false };
+
+	std::atomic<uint64> SumBits{ 0 };
+	std::atomic<uint64> Count{ 0 };
 };
 
-class METRICSSERVICEPROVIDER_API FPrometheusServer : public TSharedFromThis<FPrometheusServer>
+// Pre-rendered scrape response.  Body and GzipBody are immutable once published, so the route can read them without any locking
+// beyond the pointer swap.
+struct FPrometheusSnapshot
+{
+	TArray<uint8> Body;
+
+	// Gzip of Body, compressed once per snapshot.  Empty until a scraper has asked for gzip.
+	TArray<uint8> GzipBody;
+
+	// Spare copies of Body and GzipBody, made while publishing.  The first scrape of the snapshot moves one out as its response,
+	// so with a single scraper no scrape copies the body.  Only touched under SnapshotLock.
+	mutable TArray<uint8> SpareBody;
+	mutable TArray<uint8> SpareGzipBody;
+};
+
+class METRICSSERVICEPROVIDER_API FPrometheusServer : public TSharedFromThis<FPrometheusServer, ESPMode::ThreadSafe>
 {
 public:
-	FPrometheusServer(){};
+	FPrometheusServer();
 	virtual ~FPrometheusServer();
 	bool Initialize();
 
-	TSharedRef<FPrometheusMetric> GetMetric(const FString& Name, TArray<FPrometheusLabel> Labels);
+	// Publishes a fresh snapshot every SnapshotFrameInterval calls and periodically evicts idle series.  Game thread only.
+	void Tick();
+
+	TSharedRef<FPrometheusMetric, ESPMode::ThreadSafe> GetMetric(const FString& Name, TArray<FPrometheusLabel> Labels);
+
+	// Looks up (or creates) the series once and returns a handle to it.  Intended to be called at registration time, not per frame.
+	FPrometheusMetricHandle RegisterMetric(const FString& Name, const TArray<FPrometheusLabel>& Labels);
+
+	// Bucket bounds are only used when the series is first created, later calls return the existing histogram.
+	TSharedRef<FPrometheusHistogram, ESPMode::ThreadSafe> GetHistogram(const FString& Name, TArray<FPrometheusLabel> Labels, const TArray<double>& BucketBounds);
+
+	// Quantiles are only used when the series is first created, later calls return the existing summary.
+	TSharedRef<FPrometheusSummary, ESPMode::ThreadSafe> GetSummary(const FString& Name, TArray<FPrometheusLabel> Labels, const TArray<double>& Quantiles = FPrometheusSummary::DefaultQuantiles());
 
 private:
-	FString Serialize();
+#if WITH_DEV_AUTOMATION_TESTS
+	friend class FPrometheusSerializeBenchmark;
+	friend class FMetricsSerializeBenchmark;
+#endif // WITH_DEV_AUTOMATION_TESTS
+
+	// Renders the full exposition into ExpositionWriter.
+	void Serialize();
+
+	// Sorts the labels and builds the {a="b",c="d"} key a series is stored and exposed under.
+	static FString MakeLabelKey(TArray<FPrometheusLabel>& Labels);
 
 	bool ProcessPrometheusRequest(const FHttpServerRequest& Request, const FHttpResultCallback& OnComplete);
 
+	template <typename SeriesType>
+	using TSeriesMap = TMap<FString, TSharedRef<SeriesType, ESPMode::ThreadSafe>>;
+
+	// Every series of one type, by name then label key.
+	template <typename SeriesType>
+	struct TSeriesRegistry
+	{
+		// A series that was evicted while something outside the server still held it.  Weak, so it's forgotten once nobody
+		// does, and put back if it's updated again.
+		struct FDormantSeries
+		{
+			FString Name;
+			FString LabelKey;
+			TWeakPtr<SeriesType, ESPMode::ThreadSafe> Series;
+			int64 LastUpdateAtEviction;
+		};
+
+		TMap<FString, TSharedRef<TSeriesMap<SeriesType>, ESPMode::ThreadSafe>> Families;
+		TMap<FString, FDormantSeries> Dormant;
+	};
+
+	// Returns the live series, or puts back a dormant one, or adds the one Create makes. Lock must be held.
+	template <typename SeriesType>
+	TSharedRef<SeriesType, ESPMode::ThreadSafe> FindOrAddSeries(TSeriesRegistry<SeriesType>& Registry, const FString& Name, const FString& LabelKey,
+		TFunctionRef<TSharedRef<SeriesType, ESPMode::ThreadSafe>()> Create);
+
+	// Adds a series under Name, first evicting the least recently updated one if the name is at MaxSeriesPerName. Lock must be held.
+	template <typename SeriesType>
+	void AddSeries(TSeriesRegistry<SeriesType>& Registry, const FString& Name, TSeriesMap<SeriesType>& Entries, const FString& LabelKey,
+		const TSharedRef<SeriesType, ESPMode::ThreadSafe>& Series);
+
+	template <typename SeriesType>
+	static void MakeDormant(TSeriesRegistry<SeriesType>& Registry, const FString& Name, const FString& LabelKey, const TSharedRef<SeriesType, ESPMode::ThreadSafe>& Series);
+
+	// Evicts series last updated before IdleCutoff, or registered before NeverUpdatedCutoff and never updated. Returns how many
+	// series of this type are left.
+	template <typename SeriesType>
+	int32 EvictIdleSeries(TSeriesRegistry<SeriesType>& Registry, int64 Now, int64 IdleCutoff, int64 NeverUpdatedCutoff);
+	void EvictIdleSeries();
+
+	int32 MaxSeriesPerName = 1000;
+	int64 SeriesIdleTimeoutMS = 0;
+	double LastEvictionTime = 0.0;
+
+	FPrometheusMetricHandle SeriesEvictedIdle;
+	FPrometheusMetricHandle SeriesEvictedCap;
+	FPrometheusMetricHandle SeriesCount;
+
+	void ReadRecorderConfig();
+	void RecordSample();
+
+	TUniquePtr<FPrometheusRecorder> Recorder;
+
+	void PublishSnapshot();
+	void SetSnapshot(const TSharedPtr<const FPrometheusSnapshot, ESPMode::ThreadSafe>& NewSnapshot);
+
+	// Frames between snapshots, set with -prometheusSnapshotFrames=.
+	int32 SnapshotFrameInterval = 30;
+	int32 FramesSinceSnapshot = 0;
+
+	// Only touched by the thread publishing snapshots, kept so its buffer is reused from one snapshot to the next (or becomes the
+	// snapshot's spare body).
+	TUniquePtr<FPrometheusExpositionWriter> ExpositionWriter;
+
+#if STATS
+	void ReadStatExportConfig();
+	void SerializeStats(FPrometheusExpositionWriter& Writer);
+
+	// Filter decision and escaped line prefixes for a stat, worked out the first time we see its name.
+	struct FCachedStat
+	{
+		bool bExported = false;
+		TArray<uint8> CountPrefix;
+		TArray<uint8> IncAvePrefix;
+		TArray<uint8> IncMaxPrefix;
+	};
+
+	TArray<FString> StatPrefixes;
+	double StatExportIntervalSeconds = 0.0;
+	double LastStatExportTime = 0.0;
+	TMap<FName, FCachedStat> CachedStats;
+
+	// The last rendered stat block, re-sent as is until StatExportIntervalSeconds has passed.
+	TUniquePtr<FPrometheusExpositionWriter> StatsWriter;
+#endif
+
+	FCriticalSection SnapshotLock;
+	TSharedPtr<const FPrometheusSnapshot, ESPMode::ThreadSafe> Snapshot;
+
+	// Set by the route once a scraper sends Accept-Encoding: gzip, from then on every snapshot is compressed.
+	std::atomic<bool> bGzipRequested{ false };
+
+	// Snapshot being compressed on the thread pool. Only one at a time, Tick() publishes it once it's done.
+	TFuture<TSharedPtr<const FPrometheusSnapshot, ESPMode::ThreadSafe>> PendingSnapshot;
+
 	TSharedPtr<IHttpRouter> Router = nullptr;
 	FHttpRouteHandle MetricsHandle;
 
-	TMap<const FString, TSharedRef<TMap<const FString, TSharedRef<FPrometheusMetric>>>> Metrics;
+	// Guards the series maps, they can be added to by any thread while the HTTP route walks them.
+	FCriticalSection MetricsLock;
+	TSeriesRegistry<FPrometheusMetric> Metrics;
+	TSeriesRegistry<FPrometheusHistogram> Histograms;
+	TSeriesRegistry<FPrometheusSummary> Summaries;
 };
@@ -18,6 +18,7 @@
 #include "Misc/CommandLine.h"
 #include "Misc/Crc.h"
 #include "NFRConstants.h"
+#include "NFRFlightRecorder.h"
 #include "Utils/SpatialMetrics.h"
 #include "Utils/SpatialStatics.h"
 
@@ -295,6 +296,10 @@ ABenchmarkGymGameMode::ABenchmarkGymGameMode()
 	, PlayerDensity(0) // PlayerDensity is invalid until set via command line arg or worker flag.
 	, PlayersSpawned(0)
 	, NPCSToSpawn(0)
+	, NPCsSpawned(0)
+	, LastTotalNPCs(0)
+	, bNPCTopUpPending(false)
+	, NPCTopUpTime(0.0)
 	, bIsUsingZoning(false)
 	, bHasActorMigrationCheckFailed(false)
 	, PreviousTickMigration(0)
@@ -332,15 +337,16 @@ void ABenchmarkGymGameMode::Tick(float DeltaSeconds)
 	{
 		TryStartCustomNPCSpawning();
 		TickNPCSpawning();
+		TickNPCTopUp();
 		TickSimPlayerBlackboardValues();
 	}
 }
 
 void ABenchmarkGymGameMode::TickNPCSpawning()
 {
-	if (NPCSToSpawn > 0)
+	if (NPCSToSpawn > 0 && NPCRunPoints.Num() > 0)
 	{
-		const int32 NPCIndex = TotalNPCs - NPCSToSpawn;
+		const int32 NPCIndex = NPCsSpawned;
 		const AActor* SpawnPoint = SpawnManager->GetSpawnPointActorByIndex(NPCIndex);
 		if (SpawnPoint != nullptr)
 		{
@@ -348,11 +354,44 @@ void ABenchmarkGymGameMode::TickNPCSpawning()
 			if (SpawnNPC(SpawnLocation, NPCRunPoints[NPCIndex % NPCRunPoints.Num()]))
 			{
 				NPCSToSpawn--;
+				NPCsSpawned++;
 			}
 		}
 	}
 }
 
+void ABenchmarkGymGameMode::TickNPCTopUp()
+{
+	if (!bNPCTopUpPending)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (NPCSToSpawn > 0)
+	{
+		// The reports have to catch up with these too before the count means anything.
+		NPCTopUpTime = Now + GetActorCountSettleSeconds();
+		return;
+	}
+	if (Now < NPCTopUpTime)
+	{
+		return;
+	}
+	bNPCTopUpPending = false;
+
+	const int32 CountedNPCs = GetTotalActorCount(NPCClass);
+	if (CountedNPCs == INDEX_NONE || CountedNPCs >= TotalNPCs)
+	{
+		return;
+	}
+
+	// Spawning carries on from the counted total, so it uses the same spawn and run points the removed NPCs did.
+	UE_LOG(LogBenchmarkGymGameMode, Log, TEXT("Counted %d NPCs after removing down to %d, respawning the difference"), CountedNPCs, TotalNPCs);
+	NPCsSpawned = CountedNPCs;
+	NPCSToSpawn = TotalNPCs - CountedNPCs;
+}
+
 void ABenchmarkGymGameMode::TickSimPlayerBlackboardValues()
 {
 	for (int32 i = AIControlledPlayers.Num() - 1; i >= 0; i--)
@@ -427,6 +466,7 @@ void ABenchmarkGymGameMode::TickActorMigration(float DeltaSeconds)
 					bHasActorMigrationCheckFailed = true;
 					NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s: Actor migration check failed. Migration=%.8f MinActorMigrationPerSecond=%.8f MigrationExactlyWindowSeconds=%.8f"),
 						*NFRFailureString, Migration, MinActorMigrationPerSecond, MigrationSeconds);
+					FNFRFlightRecorder::Get().Dump(TEXT("Actor migration check failed"), true);
 				}
 				else
 				{
@@ -508,7 +548,9 @@ void ABenchmarkGymGameMode::GenerateTestScenarioLocations()
 	{
 		FRandomStream NPCStream;
 		NPCStream.Initialize(FCrc::MemCrc32(&TotalNPCs, sizeof(TotalNPCs)));
-		for (int32 i = 0; i < TotalNPCs; i++)
+		// Enough for the top of a capacity search, NPCs beyond it reuse points.
+		const int32 NumNPCRunPoints = FMath::Max(TotalNPCs, GetCapacitySearchMaxNPCs());
+		for (int32 i = 0; i < NumNPCRunPoints; i++)
 		{
 			FVector PointA = NPCStream.VRand()*RoamRadius;
 			FVector PointB = NPCStream.VRand()*RoamRadius;
@@ -571,7 +613,40 @@ void ABenchmarkGymGameMode::GenerateSpawnPoints()
 
 void ABenchmarkGymGameMode::SpawnNPCs(int NumNPCs)
 {
-	NPCSToSpawn = NumNPCs;
+	// NumNPCs is the new total, only the difference is spawned. Decreases are handled by RemoveNPCs.
+	NPCsSpawned = FMath::Min(NPCsSpawned, NumNPCs);
+	NPCSToSpawn = NumNPCs - NPCsSpawned;
+}
+
+void ABenchmarkGymGameMode::RemoveNPCs(int32 OldTotalNPCs, int32 NewTotalNPCs)
+{
+	if (OldTotalNPCs <= 0 || NPCClass == nullptr)
+	{
+		return;
+	}
+
+	// Every worker gets the new total, and removes the same share of the NPCs it has authority over.  Rounding up means no worker
+	// leaves extras behind, any shortfall from that or from NPCs that were mid handover is respawned by TickNPCTopUp().
+	TArray<APawn*> AuthNPCs;
+	for (TActorIterator<APawn> It(GetWorld(), NPCClass); It; ++It)
+	{
+		if (It->HasAuthority())
+		{
+			AuthNPCs.Add(*It);
+		}
+	}
+
+	const int32 NumToRemove = FMath::Min(AuthNPCs.Num(), FMath::DivideAndRoundUp(AuthNPCs.Num() * (OldTotalNPCs - NewTotalNPCs), OldTotalNPCs));
+	for (int32 i = 0; i < NumToRemove; i++)
+	{
+		APawn* NPC = AuthNPCs[AuthNPCs.Num() - 1 - i];
+		if (AController* Controller = NPC->GetController())
+		{
+			Controller->Destroy();
+		}
+		NPC->Destroy();
+	}
+	UE_LOG(LogBenchmarkGymGameMode, Log, TEXT("Removed %d of %d authoritative NPCs for the total going from %d to %d"), NumToRemove, AuthNPCs.Num(), OldTotalNPCs, NewTotalNPCs);
 }
 
 bool ABenchmarkGymGameMode::SpawnNPC(const FVector& SpawnLocation, const FBlackboardValues& BlackboardValues)
@@ -642,6 +717,16 @@ AActor* ABenchmarkGymGameMode::FindPlayerStart_Implementation(AController* Playe
 void ABenchmarkGymGameMode::OnTotalNPCsUpdated_Implementation(int32 Value)
 {
 	Super::OnTotalNPCsUpdated_Implementation(Value);
+	if (Value < LastTotalNPCs)
+	{
+		RemoveNPCs(LastTotalNPCs, Value);
+		if (HasAuthority())
+		{
+			bNPCTopUpPending = true;
+			NPCTopUpTime = FPlatformTime::Seconds() + GetActorCountSettleSeconds();
+		}
+	}
+	LastTotalNPCs = Value;
 	SpawnNPCs(Value);
 }
 
@@ -129,6 +129,7 @@ protected:
 	virtual void AddSpatialMetrics(USpatialMetrics* SpatialMetrics) override;
 
 	virtual void OnTotalNPCsUpdated_Implementation(int32 Value) override;
+	virtual bool IsNPCSpawningComplete() const override { return NPCSToSpawn == 0 && !bNPCTopUpPending; }
 
 private:
 
@@ -144,6 +145,13 @@ private:
 	int32 PlayerDensity;
 	int32 PlayersSpawned;
 	int32 NPCSToSpawn;
+	int32 NPCsSpawned;
+	int32 LastTotalNPCs; // To tell how many NPCs a decrease in TotalNPCs removes
+
+	// After a decrease the counted total is checked against TotalNPCs once the reports have caught up, and any NPCs removed
+	// beyond it respawned.
+	bool bNPCTopUpPending;
+	double NPCTopUpTime;
 
 	// Actor migration members
 	bool bIsUsingZoning;
@@ -171,9 +179,11 @@ private:
 
 	void TickActorMigration(float DeltaSeconds);
 	void TickNPCSpawning();
+	void TickNPCTopUp();
 	void TickSimPlayerBlackboardValues();
 
 	void SpawnNPCs(int NumNPCs);
+	void RemoveNPCs(int32 OldTotalNPCs, int32 NewTotalNPCs);
 	bool SpawnNPC(const FVector& SpawnLocation, const FBlackboardValues& BlackboardValues);
 
 	double GetTotalMigrationValid() const { return !bHasActorMigrationCheckFailed ? 1.0 : 0.0; }
@@ -17,10 +17,13 @@
 #include "LoadBalancing/GridBasedLBStrategy.h"
 #include "Misc/CommandLine.h"
 #include "Net/UnrealNetwork.h"
+#include "NFRFlightRecorder.h"
 #include "SpatialConstants.h"
 #include "SpatialView/EntityView.h"
 #include "TimerManager.h"
+#include "ActorCountSubsystem.h"
 #include "UserExperienceComponent.h"
+#include "UserExperienceReporterSubsystem.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Utils/SpatialMetrics.h"
 #include "Utils/SpatialStatics.h"
@@ -37,11 +40,45 @@ namespace
 	const FString AverageClientFPSValid = TEXT("UnrealClientFPSValid");
 	const FString ActorCountValidMetricName = TEXT("UnrealActorCountValid");
 	const FString PlayerMovementMetricName = TEXT("UnrealPlayerMovement");
+	const FString MemoryGrowthValidMetricName = TEXT("UnrealMemoryGrowthValid");
+	const FString CapacityMetricName = TEXT("UnrealCapacityNPCs");
+	const FString GlobalClientRTTSummaryName = TEXT("unreal_global_client_rtt_ms");
+	const FString GlobalClientUpdateTimeDeltaSummaryName = TEXT("unreal_global_client_update_time_delta_ms");
+	const FPrometheusLabel EnginePlatformLabel(TEXT("engine_platform"), TEXT("UnrealWorker"));
+	const TArray<double> GlobalClientUXQuantiles = { 0.5, 0.95, 0.99 };
+
+	// The client UX thresholds apply to this percentile over every client in the deployment.
+	const float UXCheckQuantile = 0.95f;
 
 	const FString MaxRoundTripWorkerFlag = TEXT("max_round_trip");
 	const FString MaxUpdateTimeDeltaWorkerFlag = TEXT("max_update_time_delta");
 	const FString MaxRoundTripCommandLineKey = TEXT("-MaxRoundTrip=");
 	const FString MaxUpdateTimeDeltaCommandLineKey = TEXT("-MaxUpdateTimeDelta=");
+	const FString UXReportIntervalCommandLineKey = TEXT("-UXReportInterval=");
+
+	// Clients report to their server once a second, reporting on from there any faster would just send empty sketches.
+	const float MinUXReportIntervalInSeconds = 1.0f;
+
+	const FString MaxMemoryGrowthWorkerFlag = TEXT("max_memory_growth");
+	const FString MaxMemoryGrowthCommandLineKey = TEXT("-MaxMemoryGrowth=");
+	const FString MemorySampleIntervalCommandLineKey = TEXT("-MemorySampleInterval=");
+
+	// Growth is fitted over this much history, and not checked until there's at least MinMemoryGrowthHistoryInSeconds of it.
+	const double MemoryGrowthWindowInSeconds = 30 * 60;
+	const double MinMemoryGrowthHistoryInSeconds = 10 * 60;
+	const float MinMemorySampleIntervalInSeconds = 1.0f;
+
+	// NPC range to search for capacity in, as "Min&Max".
+	const FString CapacitySearchWorkerFlag = TEXT("capacity_search_npcs");
+	const FString CapacitySearchCommandLineKey = TEXT("-CapacitySearchNPCs=");
+	const FString CapacitySearchResolutionCommandLineKey = TEXT("-CapacitySearchResolution=");
+	const FString CapacitySearchStepCommandLineKey = TEXT("-CapacitySearchStepSeconds=");
+
+	// Each step is judged on the checks sampled over its last CapacityMeasureInSeconds, the window the server FPS average covers,
+	// and passes if no more than CapacityMaxFailedSampleFraction of those samples failed.
+	const float CapacitySampleIntervalInSeconds = 5.0f;
+	const float CapacityMeasureInSeconds = 2 * 60;
+	const float CapacityMaxFailedSampleFraction = 0.1f;
 
 	const FString TestLiftimeWorkerFlag = TEXT("test_lifetime");
 	const FString TestLiftimeCommandLineKey = TEXT("-TestLifetime=");
@@ -90,6 +127,8 @@ ABenchmarkGymGameModeBase::ABenchmarkGymGameModeBase()
 	, ZoneHeight(1000000.0f)
 	, AveragedClientRTTMS(0.0)
 	, AveragedClientUpdateTimeDeltaMS(0.0)
+	, ClientRTTQuantileMS(0.0f)
+	, ClientUpdateTimeDeltaQuantileMS(0.0f)
 	, MaxClientRoundTripMS(150)
 	, MaxClientUpdateTimeDeltaMS(300)
 	, bHasUxFailed(false)
@@ -97,23 +136,35 @@ ABenchmarkGymGameModeBase::ABenchmarkGymGameModeBase()
 	, bHasClientFpsFailed(false)
 	, bHasActorCountFailed(false)
 	, bActorCountFailureState(false)
-	, UXAuthActorCount(0)
-	, PrintMetricsTimer(10)
+	, UXReportIntervalInSeconds(5.0f)
+	, bPrintUXMetrics(false)
+	, MemorySampler(MemoryGrowthWindowInSeconds)
+	, MemorySampleIntervalInSeconds(10.0f)
+	, MaxMemoryGrowthMBPerHour(0)
+	, bHasMemoryGrowthFailed(false)
+	, CapacitySearchMinNPCs(0)
+	, CapacitySearchMaxNPCs(0)
+	, CapacitySearchResolution(0)
+	, CapacitySearchStepSeconds(4 * 60)
+	, bCapacityStepSpawned(false)
+	, CapacityStepStartTime(0.0)
+	, CapacityStepSamples(0)
+	, CapacityStepFailedSamples(0)
+	, CapacityNPCs(0)
 	, TestLifetimeTimer(0)
+	, LastAggregatedActorCountReportIdx(0)
 	, TimeSinceLastCheckedTotalActorCounts(0.0f)
 	, bHasRequiredPlayersCheckFailed(false)
-	, RequiredPlayerCheckTimer(11*60) // all clients should have joined by this point (seconds)
-	, DeploymentValidTimer(16*60) // time to finish RequiredPlayerCheckTimer, to allow workers to disconnect without failing test (seconds)
+	, DeploymentValidTimer(16*60) // time to finish the required player checks, to allow workers to disconnect without failing test (seconds)
 	, CurrentPlayerAvgVelocity(0.0f)
 	, RecentPlayerAvgVelocity(0.0f)
-	, RequiredPlayerMovementReportTimer(5 * 60)
-	, RequiredPlayerMovementCheckTimer(6 * 60)
 	, CubeRespawnBaseTime(10.0f)
 	, CubeRespawnRandomRangeTime(10.0f)
 #if	STATS
-	, StatStartFileTimer(60 * 60 * 24)
-	, StatStopFileTimer(60)
-	, MemReportIntervalTimer(60 * 60 * 24)
+	, CPUProfileInterval(0)
+#endif
+#if !UE_BUILD_SHIPPING
+	, MemReportInterval(0)
 #endif
 {
 	PrimaryActorTick.bCanEverTick = true;
@@ -130,6 +181,8 @@ void ABenchmarkGymGameModeBase::GetLifetimeReplicatedProps(TArray<FLifetimePrope
 
 	DOREPLIFETIME(ABenchmarkGymGameModeBase, TotalNPCs);
 	DOREPLIFETIME(ABenchmarkGymGameModeBase, ActorCountReportIdx);
+	DOREPLIFETIME(ABenchmarkGymGameModeBase, ActorCountClasses);
+	DOREPLIFETIME(ABenchmarkGymGameModeBase, ActorCountAcks);
 }
 
 void ABenchmarkGymGameModeBase::BeginPlay()
@@ -143,6 +196,24 @@ void ABenchmarkGymGameModeBase::BeginPlay()
 
 	InitialiseActorCountCheckTimer();
 
+	// All clients should have joined by the first required player check.
+	const float RequiredPlayerCheckDelayInSeconds = bLongFormScenario ? 17 * 60 : 11 * 60;
+	RequiredPlayerCheckHandle = NFRScheduler.ScheduleRepeating(RequiredPlayerCheckDelayInSeconds, 10.0f, [this]() { CheckRequiredPlayers(); });
+	NFRScheduler.ScheduleRepeating(5 * 60, 29.0f, [this]() { GetVelocityForMovementReport(); });
+	NFRScheduler.ScheduleRepeating(6 * 60, 30.0f, [this]() { CheckVelocityForPlayerMovement(); });
+
+	// Client UX is accumulated as it arrives, so there's nothing to do between reports.
+	NFRScheduler.ScheduleRepeating(UXReportIntervalInSeconds, UXReportIntervalInSeconds, [this]() { ReportUXMetrics(); });
+	NFRScheduler.ScheduleRepeating(10.0f, 10.0f, [this]() { bPrintUXMetrics = true; });
+
+	// Memory is sampled for the whole run, but growth only counts once everyone has joined.
+	NFRScheduler.ScheduleRepeating(MemorySampleIntervalInSeconds, MemorySampleIntervalInSeconds, [this]() { MemorySampler.Sample(FPlatformTime::Seconds()); });
+	NFRScheduler.Schedule(RequiredPlayerCheckDelayInSeconds, [this]() { MemorySampler.ResetGrowthHistory(); });
+	NFRScheduler.ScheduleRepeating(RequiredPlayerCheckDelayInSeconds + MinMemoryGrowthHistoryInSeconds, 60.0f, [this]() { CheckMemoryGrowth(); });
+
+	// The UX and movement checks a capacity step is judged on only mean something once the players are in.
+	NFRScheduler.Schedule(RequiredPlayerCheckDelayInSeconds, [this]() { StartCapacitySearch(); });
+
 	if (bEnableDensityBucketOutput && GetDefault<UGeneralProjectSettings>()->UsesSpatialNetworking())
 	{
 		OutputPlayerDensity();
@@ -151,7 +222,6 @@ void ABenchmarkGymGameModeBase::BeginPlay()
 	if (bLongFormScenario)
 	{
 		// Extend timers to handle longer expected deployment lifetime (required for current long form disco performance test)
-		RequiredPlayerCheckTimer.SetTimer(17 * 60);
 		DeploymentValidTimer.SetTimer(38 * 60);
 		UNFRConstants* NFRConstants = const_cast<UNFRConstants*>(UNFRConstants::Get(GetWorld()));
 		NFRConstants->ActorCheckDelay.SetTimer(16*60);
@@ -178,6 +248,10 @@ void ABenchmarkGymGameModeBase::InitialiseActorCountCheckTimer()
 			if (ABenchmarkGymGameModeBase* GameMode = WeakThis.Get())
 			{
 				GameMode->BuildExpectedActorCounts();
+				if (GameMode->HasAuthority())
+				{
+					GameMode->BuildActorCountClasses();
+				}
 			}
 		},
 		InitialiseExpectedActorCountsDelayInSeconds, false);
@@ -238,6 +312,9 @@ void ABenchmarkGymGameModeBase::UpdateActorCountCheck()
 {
 	if (HasAuthority())
 	{
+		// Workers that didn't all make the last round still count, as long as their latest report is recent enough.
+		TryAggregateActorCounts(false);
+
 		ActorCountReportIdx++;
 		UpdateAndReportActorCounts();
 
@@ -254,7 +331,7 @@ void ABenchmarkGymGameModeBase::UpdateActorCountCheck()
 					}
 				},
 				FailActorCountTimeout, false);
-			GetMetrics(MetricLeftLabel, ActorCountValidMetricName, MetricName, &ABenchmarkGymGameModeBase::GetActorCountValid);
+			UpdateMetric(ActorCountValidMetric, ActorCountValidMetricName, &ABenchmarkGymGameModeBase::GetActorCountValid);
 		}
 	}
 }
@@ -266,6 +343,7 @@ void ABenchmarkGymGameModeBase::FailActorCountDueToTimeout()
 	{
 		bHasActorCountFailed = true;
 		NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s: Actor count was not checked at reasonable frequency."), *NFRFailureString);
+		FNFRFlightRecorder::Get().Dump(TEXT("Actor count check timed out"), true);
 	}
 }
 
@@ -279,6 +357,10 @@ void ABenchmarkGymGameModeBase::AddExpectedActorCount(const TSubclassOf<AActor>&
 
 	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Adding NFR actor count expectation - ActorClass: %s, MinCount: %d, MaxCount: %d"), *ActorClass->GetName(), MinCount, MaxCount);
 	ExpectedActorCounts.Add(ActorClass, FExpectedActorCountConfig(MinCount, MaxCount));
+
+	UActorCountSubsystem* ActorCounts = GetWorld()->GetSubsystem<UActorCountSubsystem>();
+	check(ActorCounts);
+	ActorCounts->TrackClass(ActorClass);
 }
 
 void ABenchmarkGymGameModeBase::TryBindWorkerFlagsDelegates()
@@ -332,6 +414,16 @@ void ABenchmarkGymGameModeBase::BindWorkerFlagDelegates(USpatialWorkerFlags* Spa
 		WorkerFlagDelegate.BindDynamic(this, &ABenchmarkGymGameModeBase::OnMaxUpdateTimeDeltaFlagUpdate);
 		SpatialWorkerFlags->RegisterFlagUpdatedCallback(MaxUpdateTimeDeltaWorkerFlag, WorkerFlagDelegate);
 	}
+	{
+		FOnWorkerFlagUpdatedBP WorkerFlagDelegate;
+		WorkerFlagDelegate.BindDynamic(this, &ABenchmarkGymGameModeBase::OnMaxMemoryGrowthFlagUpdate);
+		SpatialWorkerFlags->RegisterFlagUpdatedCallback(MaxMemoryGrowthWorkerFlag, WorkerFlagDelegate);
+	}
+	{
+		FOnWorkerFlagUpdatedBP WorkerFlagDelegate;
+		WorkerFlagDelegate.BindDynamic(this, &ABenchmarkGymGameModeBase::OnCapacitySearchFlagUpdate);
+		SpatialWorkerFlags->RegisterFlagUpdatedCallback(CapacitySearchWorkerFlag, WorkerFlagDelegate);
+	}
 	{
 		FOnWorkerFlagUpdatedBP WorkerFlagDelegate;
 		WorkerFlagDelegate.BindDynamic(this, &ABenchmarkGymGameModeBase::OnTestLiftimeFlagUpdate);
@@ -425,109 +517,84 @@ void ABenchmarkGymGameModeBase::AddSpatialMetrics(USpatialMetrics* SpatialMetric
 
 void ABenchmarkGymGameModeBase::Tick(float DeltaSeconds)
 {
+	NFR_FLIGHT_SCOPE("BenchmarkGymGameModeBase::Tick");
+
 	Super::Tick(DeltaSeconds);
 
+	NFRScheduler.Tick();
+
 	TickServerFPSCheck(DeltaSeconds);
 	TickClientFPSCheck(DeltaSeconds);
-	TickPlayersConnectedCheck(DeltaSeconds);
-	TickPlayersMovementCheck(DeltaSeconds);
-	TickUXMetricCheck(DeltaSeconds);
-	
-	// PrintMetricsTimer needs to be reset at the the end of ABenchmarkGymGameModeBase::Tick.
-	// This is so that the above function have a chance to run logic dependant on PrintMetricsTimer.HasTimerGoneOff().
-	if (PrintMetricsTimer.HasTimerGoneOff())
-	{
-		PrintMetricsTimer.SetTimer(10);
-	}
+}
+
 #if	STATS
-	if (CPUProfileInterval > 0)
+void ABenchmarkGymGameModeBase::StartStatFile()
+{
+	FString Cmd(TEXT("stat startfile"));
+	if (GetDefault<UGeneralProjectSettings>()->UsesSpatialNetworking())
 	{
-		if (StatStartFileTimer.HasTimerGoneOff())
-		{
-			FString Cmd(TEXT("stat startfile"));
-			if (GetDefault<UGeneralProjectSettings>()->UsesSpatialNetworking())
-			{
-				USpatialNetDriver* SpatialDriver = Cast<USpatialNetDriver>(GetNetDriver());
-				if (ensure(SpatialDriver != nullptr))
-				{
-					FString InFileName = FString::Printf(TEXT("%s-%s"), *SpatialDriver->Connection->GetWorkerId(), *FDateTime::Now().ToString(TEXT("%m.%d-%H.%M.%S")));
-					const FString Filename = CreateProfileFilename(InFileName, TEXT(".ue4stats"), true);
-					Cmd.Append(FString::Printf(TEXT(" %s"), *Filename));
-				}
-			}
-			GEngine->Exec(GetWorld(), *Cmd);
-			StatStartFileTimer.SetTimer(CPUProfileInterval);
-		}
-		if (StatStopFileTimer.HasTimerGoneOff())
+		USpatialNetDriver* SpatialDriver = Cast<USpatialNetDriver>(GetNetDriver());
+		if (ensure(SpatialDriver != nullptr))
 		{
-			GEngine->Exec(GetWorld(), TEXT("stat stopfile"));
-			StatStopFileTimer.SetTimer(CPUProfileInterval);
+			FString InFileName = FString::Printf(TEXT("%s-%s"), *SpatialDriver->Connection->GetWorkerId(), *FDateTime::Now().ToString(TEXT("%m.%d-%H.%M.%S")));
+			const FString Filename = CreateProfileFilename(InFileName, TEXT(".ue4stats"), true);
+			Cmd.Append(FString::Printf(TEXT(" %s"), *Filename));
 		}
 	}
+	GEngine->Exec(GetWorld(), *Cmd);
+}
 #endif
 #if !UE_BUILD_SHIPPING
-	if (MemReportInterval > 0 && MemReportIntervalTimer.HasTimerGoneOff())
+void ABenchmarkGymGameModeBase::WriteMemReport()
+{
+	FString Cmd = TEXT("memreport -full");
+	if (GetDefault<UGeneralProjectSettings>()->UsesSpatialNetworking())
 	{
-		FString Cmd = TEXT("memreport -full");
-		if (GetDefault<UGeneralProjectSettings>()->UsesSpatialNetworking())
+		USpatialNetDriver* SpatialDriver = Cast<USpatialNetDriver>(GetNetDriver());
+		if (ensure(SpatialDriver != nullptr))
 		{
-			USpatialNetDriver* SpatialDriver = Cast<USpatialNetDriver>(GetNetDriver());
-			if (ensure(SpatialDriver != nullptr))
-			{
-				Cmd.Append(FString::Printf(TEXT(" NAME=%s-%s"), *SpatialDriver->Connection->GetWorkerId(), *FDateTime::Now().ToString(TEXT("%m.%d-%H.%M.%S"))));
-			}
+			Cmd.Append(FString::Printf(TEXT(" NAME=%s-%s"), *SpatialDriver->Connection->GetWorkerId(), *FDateTime::Now().ToString(TEXT("%m.%d-%H.%M.%S"))));
 		}
-		GEngine->Exec(nullptr, *Cmd);
-		MemReportIntervalTimer.SetTimer(MemReportInterval);
 	}
-#endif
+	GEngine->Exec(nullptr, *Cmd);
 }
+#endif
 
-void ABenchmarkGymGameModeBase::TickPlayersConnectedCheck(float DeltaSeconds)
+void ABenchmarkGymGameModeBase::CheckRequiredPlayers()
 {
-	if (!HasAuthority())
+	// Only check players once, and stop once workers are allowed to disconnect.
+	if (bHasRequiredPlayersCheckFailed || DeploymentValidTimer.HasTimerGoneOff())
 	{
+		NFRScheduler.Cancel(RequiredPlayerCheckHandle);
 		return;
 	}
 
-	// Only check players once
-	if (bHasRequiredPlayersCheckFailed)
+	if (!HasAuthority())
 	{
 		return;
 	}
 
-	if (RequiredPlayerCheckTimer.HasTimerGoneOff() && !DeploymentValidTimer.HasTimerGoneOff())
-	{
-		const int32* ActorCount = TotalActorCounts.Find(SimulatedPawnClass);
+	const int32* ActorCount = TotalActorCounts.Find(SimulatedPawnClass);
 
-		if (ActorCount == nullptr)
-		{
-			bHasRequiredPlayersCheckFailed = true;
-			NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s: Could not get Simulated Player actor count."), *NFRFailureString);
-		}
-		else if (*ActorCount >= RequiredPlayers)
-		{
-			RequiredPlayerCheckTimer.SetTimer(10);
-			// Useful for NFR log inspection
-			NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("All clients successfully connected. Required %d, got %d"), RequiredPlayers, *ActorCount);
-		}
-		else
-		{
-			bHasRequiredPlayersCheckFailed = true;
-			// This log is used by the NFR pipeline to indicate if a client failed to connect
-			NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s: Client connection dropped. Required %d, got %d"), *NFRFailureString, RequiredPlayers, *ActorCount);
-		}
-		GetMetrics(MetricLeftLabel, ExpectedPlayersValidMetricName, MetricName, &ABenchmarkGymGameModeBase::GetRequiredPlayersValid);
+	if (ActorCount == nullptr)
+	{
+		bHasRequiredPlayersCheckFailed = true;
+		NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s: Could not get Simulated Player actor count."), *NFRFailureString);
+		FNFRFlightRecorder::Get().Dump(TEXT("Required players check failed"), true);
 	}
-}
-
-void ABenchmarkGymGameModeBase::TickPlayersMovementCheck(float DeltaSeconds)
-{
-	// Get velocity and report 
-	GetVelocityForMovementReport();
-	
-	// Check velocity
-	CheckVelocityForPlayerMovement();
+	else if (*ActorCount >= RequiredPlayers)
+	{
+		// Useful for NFR log inspection
+		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("All clients successfully connected. Required %d, got %d"), RequiredPlayers, *ActorCount);
+	}
+	else
+	{
+		bHasRequiredPlayersCheckFailed = true;
+		// This log is used by the NFR pipeline to indicate if a client failed to connect
+		NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s: Client connection dropped. Required %d, got %d"), *NFRFailureString, RequiredPlayers, *ActorCount);
+		FNFRFlightRecorder::Get().Dump(TEXT("Required players check failed"), true);
+	}
+	UpdateMetric(RequiredPlayersValidMetric, ExpectedPlayersValidMetricName, &ABenchmarkGymGameModeBase::GetRequiredPlayersValid);
 }
 
 void ABenchmarkGymGameModeBase::TickServerFPSCheck(float DeltaSeconds)
@@ -554,10 +621,14 @@ void ABenchmarkGymGameModeBase::TickServerFPSCheck(float DeltaSeconds)
 		Constants->ServerFPSMetricDelay.HasTimerGoneOff())
 	{
 		bHasFpsFailed = true;
-		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("%s: Server FPS check. FPS: %.8f"), *NFRFailureString, FPS);
+		const FServerFrameBreakdown& Breakdown = GameInstance->GetFrameBreakdown();
+		const FServerFrameBreakdown::EPhase DominantPhase = Breakdown.GetDominantPhase();
+		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("%s: Server FPS check. FPS: %.8f, 1%% low FPS: %.8f, p99 frame time: %.1fms, dominant phase: %s (%.1fms). Frame breakdown: %s"), *NFRFailureString,
+			FPS, GameInstance->GetOnePercentLowFPS(), GameInstance->GetP99FrameTimeMS(), FServerFrameBreakdown::GetPhaseName(DominantPhase), Breakdown.GetAveragePhaseMS(DominantPhase), *Breakdown.ToString());
+		FNFRFlightRecorder::Get().Dump(TEXT("Server FPS check failed"), true);
 	}
 
-	GetMetrics(MetricLeftLabel, AverageFPSValid, MetricName, &ABenchmarkGymGameModeBase::GetFPSValid);
+	UpdateMetric(FPSValidMetric, AverageFPSValid, &ABenchmarkGymGameModeBase::GetFPSValid);
 }
 
 void ABenchmarkGymGameModeBase::TickClientFPSCheck(float DeltaSeconds)
@@ -574,13 +645,11 @@ void ABenchmarkGymGameModeBase::TickClientFPSCheck(float DeltaSeconds)
 	}
 
 	bool bClientFpsWasValid = true;
-	for (TObjectIterator<UUserExperienceReporter> Itr; Itr; ++Itr) // These exist on player characters
+	const UUserExperienceReporterSubsystem* Registry = GetWorld()->GetSubsystem<UUserExperienceReporterSubsystem>();
+	check(Registry);
+	for (const UUserExperienceReporter* Component : Registry->GetReporters()) // These exist on player characters
 	{
-		UUserExperienceReporter* Component = *Itr;
-		if (Component->GetOwner() != nullptr && Component->GetWorld() == GetWorld())
-		{
-			bClientFpsWasValid = bClientFpsWasValid && Component->bFrameRateValid; // Frame rate wait period is performed by the client and returned valid until then
-		}
+		bClientFpsWasValid = bClientFpsWasValid && Component->bFrameRateValid; // Frame rate wait period is performed by the client and returned valid until then
 	}
 
 	const UNFRConstants* Constants = UNFRConstants::Get(GetWorld());
@@ -591,54 +660,230 @@ void ABenchmarkGymGameModeBase::TickClientFPSCheck(float DeltaSeconds)
 	{
 		bHasClientFpsFailed = true;
 		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("%s: Client FPS check."), *NFRFailureString);
+		FNFRFlightRecorder::Get().Dump(TEXT("Client FPS check failed"), true);
 	}
-	GetMetrics(MetricLeftLabel, AverageClientFPSValid, MetricName, &ABenchmarkGymGameModeBase::GetClientFPSValid);
+	UpdateMetric(ClientFPSValidMetric, AverageClientFPSValid, &ABenchmarkGymGameModeBase::GetClientFPSValid);
 }
 
-void ABenchmarkGymGameModeBase::TickUXMetricCheck(float DeltaSeconds)
+void ABenchmarkGymGameModeBase::ReportUXMetrics()
 {
-	UXAuthActorCount = 0;
-	int ValidRTTCount = 0;
-	int ValidUpdateTimeDeltaCount = 0;
-	float ClientRTTMS = 0.0f;
-	float ClientUpdateTimeDeltaMS = 0.0f;
-	for (TObjectIterator<UUserExperienceReporter> Itr; Itr; ++Itr) // These exist on player characters
+	NFR_FLIGHT_SCOPE("ReportUXMetrics");
+
+	UUserExperienceReporterSubsystem* Registry = GetWorld()->GetSubsystem<UUserExperienceReporterSubsystem>();
+	check(Registry);
+
+	FLatencySketch RTTSketch;
+	FLatencySketch UpdateTimeSketch;
+	Registry->TakeClientUX(RTTSketch, UpdateTimeSketch);
+
+	if (bPrintUXMetrics)
+	{
+		bPrintUXMetrics = false;
+		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("UX metric values. RTT: %.8f(%d), UpdateDelta: %.8f(%d)"), RTTSketch.GetMean(), RTTSketch.GetCount(), UpdateTimeSketch.GetMean(), UpdateTimeSketch.GetCount());
+	}
+
+	ReportUserExperience(GetGameInstance()->GetSpatialWorkerId(), RTTSketch, UpdateTimeSketch);
+}
+
+void ABenchmarkGymGameModeBase::CheckMemoryGrowth()
+{
+	// Each worker checks its own memory, it's the worker that leaks rather than the deployment.
+	if (!bHasMemoryGrowthFailed && MaxMemoryGrowthMBPerHour > 0 && MemorySampler.GetGrowthHistorySeconds() >= MinMemoryGrowthHistoryInSeconds)
 	{
-		UUserExperienceReporter* Component = *Itr;
-		if (Component->GetOwner() != nullptr && Component->HasBegunPlay() && Component->GetWorld() == GetWorld())
+		const double GrowthMBPerHour = MemorySampler.GetGrowthRateMBPerHour();
+		if (GrowthMBPerHour > MaxMemoryGrowthMBPerHour)
 		{
-			if (Component->ServerRTTMS > 0.f)
-			{
-				ClientRTTMS += Component->ServerRTTMS;
-				ValidRTTCount++;
-			}
+			bHasMemoryGrowthFailed = true;
+			NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("%s: Memory growth check. Growth: %.1fMB/hour over %.0fs, Max: %dMB/hour, Total: %.1fMB (%s)"), *NFRFailureString,
+				GrowthMBPerHour, MemorySampler.GetGrowthHistorySeconds(), MaxMemoryGrowthMBPerHour, MemorySampler.GetTotalMB(), FMemorySampler::IsUsingLLM() ? TEXT("LLM tracked") : TEXT("used physical"));
+			FNFRFlightRecorder::Get().Dump(TEXT("Memory growth check failed"), true);
+		}
+	}
 
-			if (Component->ServerUpdateTimeDeltaMS > 0.f)
-			{
-				ClientUpdateTimeDeltaMS += Component->ServerUpdateTimeDeltaMS;
-				ValidUpdateTimeDeltaCount++;
-			}
+	UpdateMetric(MemoryGrowthValidMetric, MemoryGrowthValidMetricName, &ABenchmarkGymGameModeBase::GetMemoryGrowthValid);
+}
 
-			if (Component->GetOwner()->HasAuthority())
-			{
-				UXAuthActorCount++;
-			}
+void ABenchmarkGymGameModeBase::InitCapacitySearch(const FString& CapacitySearchString)
+{
+	if (CapacitySearch.IsSet())
+	{
+		UE_LOG(LogBenchmarkGymGameModeBase, Warning, TEXT("Capacity search has already started, ignoring new NPC range %s"), *CapacitySearchString);
+		return;
+	}
+
+	FString MinNPCsString, MaxNPCsString;
+	if (CapacitySearchString.Split(TEXT("&"), &MinNPCsString, &MaxNPCsString))
+	{
+		CapacitySearchMinNPCs = FMath::Max(0, FCString::Atoi(*MinNPCsString));
+		CapacitySearchMaxNPCs = FMath::Max(0, FCString::Atoi(*MaxNPCsString));
+		UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Capacity search NPC range is set to %d to %d"), CapacitySearchMinNPCs, CapacitySearchMaxNPCs);
+	}
+	else
+	{
+		UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Please ensure the capacity search NPC range is set as Min&Max"));
+	}
+}
+
+void ABenchmarkGymGameModeBase::StartCapacitySearch()
+{
+	if (!HasAuthority() || CapacitySearchMaxNPCs <= 0 || CapacitySearch.IsSet())
+	{
+		return;
+	}
+
+	// Default to finding capacity within 5% of the range.
+	const int32 Resolution = CapacitySearchResolution > 0 ? CapacitySearchResolution : FMath::Max(1, (CapacitySearchMaxNPCs - CapacitySearchMinNPCs) / 20);
+	CapacitySearch.Emplace(CapacitySearchMinNPCs, CapacitySearchMaxNPCs, Resolution);
+	NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Starting capacity search. NPCs: %d to %d, Resolution: %d, Players: %d, Step: %.0fs"),
+		CapacitySearchMinNPCs, CapacitySearchMaxNPCs, Resolution, ExpectedPlayers, CapacitySearchStepSeconds);
+
+	StartCapacityStep();
+	NFRScheduler.ScheduleRepeating(CapacitySampleIntervalInSeconds, CapacitySampleIntervalInSeconds, [this]() { TickCapacitySearch(); });
+}
+
+void ABenchmarkGymGameModeBase::StartCapacityStep()
+{
+	// The actor count check is paused until this has spawned, see IsCapacityStepTransitioning().
+	SetTotalNPCs(CapacitySearch->GetCurrentLoad());
+
+	bCapacityStepSpawned = false;
+	CapacityStepSamples = 0;
+	CapacityStepFailedSamples = 0;
+	CapacityStepFailure.Reset();
+}
+
+void ABenchmarkGymGameModeBase::TickCapacitySearch()
+{
+	NFR_FLIGHT_SCOPE("TickCapacitySearch");
+
+	const double Now = FPlatformTime::Seconds();
+	if (!bCapacityStepSpawned)
+	{
+		if (!IsNPCSpawningComplete())
+		{
+			return;
+		}
+		bCapacityStepSpawned = true;
+		CapacityStepStartTime = Now;
+
+		// Only now do the workers' counts match the new load, so that's when the actor count check moves over to it.
+		if (ExpectedActorCounts.Num() > 0)
+		{
+			BuildExpectedActorCounts();
 		}
-	}	
+	}
 
-	ClientRTTMS /= static_cast<float>(ValidRTTCount) + 0.00001f; // Avoid div 0
-	ClientUpdateTimeDeltaMS /= static_cast<float>(ValidUpdateTimeDeltaCount) + 0.00001f; // Avoid div 0
+	if (CapacitySearch->IsFinished())
+	{
+		// Settled on the capacity found, nothing left to measure. Keep re-publishing it so the result stays on the scrape for
+		// the rest of the run, even if quiet series are being evicted.
+		UpdateMetric(CapacityMetric, CapacityMetricName, &ABenchmarkGymGameModeBase::GetCapacityNPCs);
+		return;
+	}
+
+	// Let the load settle before sampling, the FPS average in particular still covers the previous step until then.
+	const double StepElapsed = Now - CapacityStepStartTime;
+	if (StepElapsed < CapacitySearchStepSeconds - CapacityMeasureInSeconds)
+	{
+		return;
+	}
+
+	FString Failure;
+	CapacityStepSamples++;
+	if (!IsCapacityStepPassing(Failure))
+	{
+		CapacityStepFailedSamples++;
+		CapacityStepFailure = Failure;
+	}
+
+	if (StepElapsed < CapacitySearchStepSeconds)
+	{
+		return;
+	}
+
+	const int32 StepNPCs = CapacitySearch->GetCurrentLoad();
+	const bool bPassed = CapacityStepFailedSamples <= CapacityStepSamples * CapacityMaxFailedSampleFraction;
+	NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Capacity search step %s. NPCs: %d, Failed samples: %d/%d%s%s"), bPassed ? TEXT("passed") : TEXT("failed"),
+		StepNPCs, CapacityStepFailedSamples, CapacityStepSamples, CapacityStepFailure.IsEmpty() ? TEXT("") : TEXT(", Last failure: "), *CapacityStepFailure);
+
+	CapacitySearch->ReportResult(bPassed);
+	if (!CapacitySearch->IsFinished())
+	{
+		StartCapacityStep();
+		return;
+	}
 
-	if (PrintMetricsTimer.HasTimerGoneOff())
+	CapacityNPCs = FMath::Max(0, CapacitySearch->GetCapacity());
+	if (CapacitySearch->GetCapacity() == INDEX_NONE)
+	{
+		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Capacity search finished. Even the minimum of %d NPCs failed with %d players"), CapacitySearchMinNPCs, ExpectedPlayers);
+	}
+	else
 	{
-		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("UX metric values. RTT: %.8f(%d), UpdateDelta: %.8f(%d)"), ClientRTTMS, ValidRTTCount, ClientUpdateTimeDeltaMS, ValidUpdateTimeDeltaCount);
+		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Capacity search finished. Capacity: %d NPCs with %d players"), CapacityNPCs, ExpectedPlayers);
 	}
+	UpdateMetric(CapacityMetric, CapacityMetricName, &ABenchmarkGymGameModeBase::GetCapacityNPCs);
 
-	if (PrintMetricsTimer.HasTimerGoneOff() || HasAuthority())
+	// Hold the capacity found for the rest of the run. Keep ticking until it's spawned, so the actor count check follows it.
+	SetTotalNPCs(CapacityNPCs);
+	bCapacityStepSpawned = false;
+}
+
+bool ABenchmarkGymGameModeBase::IsCapacityStepTransitioning() const
+{
+	// Worker reports trail the spawning by up to a check period, so give them a couple to catch up too.
+	return CapacitySearch.IsSet() && (!bCapacityStepSpawned || FPlatformTime::Seconds() - CapacityStepStartTime < GetActorCountSettleSeconds());
+}
+
+bool ABenchmarkGymGameModeBase::IsCapacityStepPassing(FString& OutFailure) const
+{
+	const UNFRConstants* Constants = UNFRConstants::Get(GetWorld());
+	check(Constants);
+
+	// The client FPS flag latches once a client drops below the threshold, so it can't judge a later, lighter step and isn't used.
+	const UGDKTestGymsGameInstance* GameInstance = GetGameInstance<UGDKTestGymsGameInstance>();
+	if (GameInstance != nullptr && GameInstance->GetAveragedFPS() < Constants->GetMinServerFPS())
+	{
+		OutFailure = FString::Printf(TEXT("Server FPS %.1f"), GameInstance->GetAveragedFPS());
+		return false;
+	}
+	if (ClientRTTQuantileMS > MaxClientRoundTripMS)
 	{
-		ReportUserExperience(GetGameInstance()->GetSpatialWorkerId(), ClientRTTMS, ClientUpdateTimeDeltaMS);
+		OutFailure = FString::Printf(TEXT("Client RTT %.1fms"), ClientRTTQuantileMS);
+		return false;
 	}
+	if (ClientUpdateTimeDeltaQuantileMS > MaxClientUpdateTimeDeltaMS)
+	{
+		OutFailure = FString::Printf(TEXT("Client update time delta %.1fms"), ClientUpdateTimeDeltaQuantileMS);
+		return false;
+	}
+	if (CurrentPlayerAvgVelocity <= Constants->GetMinPlayerAvgVelocity())
+	{
+		OutFailure = FString::Printf(TEXT("Player velocity %.1f"), CurrentPlayerAvgVelocity);
+		return false;
+	}
+	return true;
+}
 
+int32 ABenchmarkGymGameModeBase::GetTotalActorCount(const TSubclassOf<AActor>& ActorClass) const
+{
+	const int32* ActorCount = TotalActorCounts.Find(ActorClass);
+	return ActorCount != nullptr ? *ActorCount : INDEX_NONE;
+}
+
+int32 ABenchmarkGymGameModeBase::GetUXAuthActorCount() const
+{
+	int32 AuthActorCount = 0;
+	const UUserExperienceReporterSubsystem* Registry = GetWorld()->GetSubsystem<UUserExperienceReporterSubsystem>();
+	check(Registry);
+	for (const UUserExperienceReporter* Component : Registry->GetReporters()) // These exist on player characters
+	{
+		if (Component->GetOwner()->HasAuthority())
+		{
+			AuthActorCount++;
+		}
+	}
+	return AuthActorCount;
 }
 
 void ABenchmarkGymGameModeBase::ParsePassedValues()
@@ -672,6 +917,26 @@ void ABenchmarkGymGameModeBase::ParsePassedValues()
 
 #endif
 
+	if (FParse::Value(*CommandLine, *UXReportIntervalCommandLineKey, UXReportIntervalInSeconds))
+	{
+		UXReportIntervalInSeconds = FMath::Max(UXReportIntervalInSeconds, MinUXReportIntervalInSeconds);
+		UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("UX report interval is set to %.1fs"), UXReportIntervalInSeconds);
+	}
+
+	if (FParse::Value(*CommandLine, *MemorySampleIntervalCommandLineKey, MemorySampleIntervalInSeconds))
+	{
+		MemorySampleIntervalInSeconds = FMath::Max(MemorySampleIntervalInSeconds, MinMemorySampleIntervalInSeconds);
+		UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Memory sample interval is set to %.1fs"), MemorySampleIntervalInSeconds);
+	}
+
+	FString CapacitySearchString;
+	if (FParse::Value(*CommandLine, *CapacitySearchCommandLineKey, CapacitySearchString))
+	{
+		InitCapacitySearch(CapacitySearchString);
+	}
+	FParse::Value(*CommandLine, *CapacitySearchResolutionCommandLineKey, CapacitySearchResolution);
+	FParse::Value(*CommandLine, *CapacitySearchStepCommandLineKey, CapacitySearchStepSeconds);
+
 	if (FParse::Param(*CommandLine, *ReadFromCommandLineKey))
 	{
 		ReadCommandLineArgs(CommandLine);
@@ -707,18 +972,19 @@ void ABenchmarkGymGameModeBase::ReadCommandLineArgs(const FString& CommandLine)
 
 	FParse::Value(*CommandLine, *MaxRoundTripCommandLineKey, MaxClientRoundTripMS);
 	FParse::Value(*CommandLine, *MaxUpdateTimeDeltaCommandLineKey, MaxClientUpdateTimeDeltaMS);
+	FParse::Value(*CommandLine, *MaxMemoryGrowthCommandLineKey, MaxMemoryGrowthMBPerHour);
 
 	FParse::Value(*CommandLine, *CubeRespawnBaseTimeCommandLineKey, CubeRespawnBaseTime);
 	FParse::Value(*CommandLine, *CubeRespawnRandomRangeCommandLineKey, CubeRespawnRandomRangeTime);
 
-	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Players %d, RequiredPlayers %d, NPCs %d, RoundTrip %d, UpdateTimeDelta %d, CubeRespawnBaseTime %f, CubeRespawnRandomRangeTime %f"),
-		ExpectedPlayers, RequiredPlayers, TotalNPCs, MaxClientRoundTripMS, MaxClientUpdateTimeDeltaMS, CubeRespawnBaseTime, CubeRespawnRandomRangeTime);
+	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Players %d, RequiredPlayers %d, NPCs %d, RoundTrip %d, UpdateTimeDelta %d, CubeRespawnBaseTime %f, CubeRespawnRandomRangeTime %f, MaxMemoryGrowth %d"),
+		ExpectedPlayers, RequiredPlayers, TotalNPCs, MaxClientRoundTripMS, MaxClientUpdateTimeDeltaMS, CubeRespawnBaseTime, CubeRespawnRandomRangeTime, MaxMemoryGrowthMBPerHour);
 }
 
 void ABenchmarkGymGameModeBase::ReadWorkerFlagValues(USpatialWorkerFlags* SpatialWorkerFlags)
 {
 	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Using worker flags to load custom spawning parameters."));
-	FString ExpectedPlayersString, RequiredPlayersString, TotalNPCsString, MaxRoundTrip, MaxUpdateTimeDelta, LifetimeString, NumWorkersString, CubeRespawnBaseTimeString, CubeRespawnRandomRangeTimeString;
+	FString ExpectedPlayersString, RequiredPlayersString, TotalNPCsString, MaxRoundTrip, MaxUpdateTimeDelta, MaxMemoryGrowth, LifetimeString, NumWorkersString, CubeRespawnBaseTimeString, CubeRespawnRandomRangeTimeString;
 
 	if (SpatialWorkerFlags->GetWorkerFlag(TotalPlayerWorkerFlag, ExpectedPlayersString))
 	{
@@ -745,6 +1011,17 @@ void ABenchmarkGymGameModeBase::ReadWorkerFlagValues(USpatialWorkerFlags* Spatia
 		MaxClientUpdateTimeDeltaMS = FCString::Atoi(*MaxUpdateTimeDelta);
 	}
 
+	if (SpatialWorkerFlags->GetWorkerFlag(MaxMemoryGrowthWorkerFlag, MaxMemoryGrowth))
+	{
+		MaxMemoryGrowthMBPerHour = FCString::Atoi(*MaxMemoryGrowth);
+	}
+
+	FString CapacitySearchString;
+	if (SpatialWorkerFlags->GetWorkerFlag(CapacitySearchWorkerFlag, CapacitySearchString))
+	{
+		InitCapacitySearch(CapacitySearchString);
+	}
+
 	if (SpatialWorkerFlags->GetWorkerFlag(TestLiftimeWorkerFlag, LifetimeString))
 	{
 		SetLifetime(FCString::Atoi(*LifetimeString));
@@ -774,8 +1051,8 @@ void ABenchmarkGymGameModeBase::ReadWorkerFlagValues(USpatialWorkerFlags* Spatia
 	}
 #endif
 
-	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Players %d, RequiredPlayers %d, NPCs %d, RoundTrip %d, UpdateTimeDelta %d, CubeRespawnBaseTime %f, CubeRespawnRandomRangeTime %f"),
-		ExpectedPlayers, RequiredPlayers, TotalNPCs, MaxClientRoundTripMS, MaxClientUpdateTimeDeltaMS, CubeRespawnBaseTime, CubeRespawnRandomRangeTime);
+	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Players %d, RequiredPlayers %d, NPCs %d, RoundTrip %d, UpdateTimeDelta %d, CubeRespawnBaseTime %f, CubeRespawnRandomRangeTime %f, MaxMemoryGrowth %d"),
+		ExpectedPlayers, RequiredPlayers, TotalNPCs, MaxClientRoundTripMS, MaxClientUpdateTimeDeltaMS, CubeRespawnBaseTime, CubeRespawnRandomRangeTime, MaxMemoryGrowthMBPerHour);
 }
 
 void ABenchmarkGymGameModeBase::SetTotalNPCs(int32 Value)
@@ -799,6 +1076,8 @@ void ABenchmarkGymGameModeBase::OnActorCountReportIdx()
 
 void ABenchmarkGymGameModeBase::UpdateAndReportActorCounts()
 {
+	NFR_FLIGHT_SCOPE("UpdateAndReportActorCounts");
+
 	const UWorld* World = GetWorld();
 	bool bSpatialEnabled = USpatialStatics::IsSpatialNetworkingEnabled();
 	const FString WorkerID = bSpatialEnabled ? GetGameInstance()->GetSpatialWorkerId() : TEXT("Worker1");
@@ -808,61 +1087,117 @@ void ABenchmarkGymGameModeBase::UpdateAndReportActorCounts()
 		return;
 	}
 
-	ActorCountMap& ThisWorkerActorCounts = WorkerActorCounts.FindOrAdd(WorkerID);
-	for (auto const& Pair : ExpectedActorCounts)
+	// Wait until the class table has replicated and we're counting every class in it.
+	if (ActorCountClasses.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<int32> Counts;
+	Counts.SetNumZeroed(ActorCountClasses.Num());
+	for (int32 ClassIndex = 0; ClassIndex < ActorCountClasses.Num(); ++ClassIndex)
 	{
-		const TSubclassOf<AActor>& ActorClass = Pair.Key;
-		const FExpectedActorCountConfig& Config = Pair.Value;
-		if (Config.MinCount > 0)
+		const TSubclassOf<AActor>& ActorClass = ActorCountClasses[ClassIndex];
+		if (ActorClass == nullptr || !ExpectedActorCounts.Contains(ActorClass))
 		{
-			int32 TotalCount = 0;
-			int32& AuthCount = ThisWorkerActorCounts.FindOrAdd(ActorClass);
-			GetActorCount(ActorClass, TotalCount, AuthCount);
-			NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Local Actor Count - ActorClass: %s Count: %d, AuthCount: %d"), *ActorClass->GetName(), TotalCount, AuthCount);
+			return;
 		}
+
+		int32 TotalCount = 0;
+		GetActorCount(ActorClass, TotalCount, Counts[ClassIndex]);
+		NFR_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Local Actor Count - ActorClass: %s Count: %d, AuthCount: %d"), *ActorClass->GetName(), TotalCount, Counts[ClassIndex]);
 	}
 
-	TArray<FActorCount> ActorCountArray;
-	ActorCountArray.Reserve(ThisWorkerActorCounts.Num());
+	// Only send what changed since the report the authority last applied. Without one, the full counts go out.
+	int32 BaseReportIdx = GetActorCountAck(WorkerID);
+	const TArray<int32>* BaseCounts = SentActorCounts.Find(BaseReportIdx);
+	if (BaseCounts == nullptr || BaseCounts->Num() != Counts.Num())
+	{
+		BaseReportIdx = 0;
+		BaseCounts = nullptr;
+	}
 
-	for (const auto& Pair : ThisWorkerActorCounts)
+	TArray<FActorCountDelta> CountDeltas;
+	for (int32 ClassIndex = 0; ClassIndex < Counts.Num(); ++ClassIndex)
 	{
-		ActorCountArray.Add(FActorCount(Pair.Key, Pair.Value));
+		const int32 Delta = Counts[ClassIndex] - (BaseCounts != nullptr ? (*BaseCounts)[ClassIndex] : 0);
+		if (Delta != 0)
+		{
+			CountDeltas.Add(FActorCountDelta(static_cast<uint8>(ClassIndex), Delta));
+		}
+	}
+
+	// Nothing older than the acknowledged report can be a base again.
+	for (auto It = SentActorCounts.CreateIterator(); It; ++It)
+	{
+		if (It->Key < BaseReportIdx || It->Key >= ActorCountReportIdx)
+		{
+			It.RemoveCurrent();
+		}
 	}
+	SentActorCounts.Add(ActorCountReportIdx, MoveTemp(Counts));
 
-	ReportAuthoritativeActorCount(ActorCountReportIdx, WorkerID, ActorCountArray);
+	ReportAuthoritativeActorCount(ActorCountReportIdx, BaseReportIdx, WorkerID, CountDeltas);
 }
 
-void ABenchmarkGymGameModeBase::GetActorCount(const TSubclassOf<AActor>& ActorClass, int32& OutTotalCount, int32& OutAuthCount) const
+void ABenchmarkGymGameModeBase::BuildActorCountClasses()
 {
-	const UWorld* World = GetWorld();
-	USpatialNetDriver* SpatialDriver = Cast<USpatialNetDriver>(World->GetNetDriver());
-
-	TArray<AActor*> Actors;
-	UGameplayStatics::GetAllActorsOfClass(World, ActorClass, Actors);
-
-	OutAuthCount = 0;
-	for (const AActor* Actor : Actors)
+	ActorCountClasses.Reset();
+	for (const auto& Pair : ExpectedActorCounts)
 	{
-		if (Actor->HasAuthority())
+		if (Pair.Value.MinCount > 0)
 		{
-			OutAuthCount++;
+			ActorCountClasses.Add(Pair.Key);
 		}
-		else if (SpatialDriver != nullptr)
+	}
+	check(ActorCountClasses.Num() <= MAX_uint8 + 1);
+}
+
+int32 ABenchmarkGymGameModeBase::GetActorCountAck(const FString& WorkerID) const
+{
+	const FActorCountAck* Ack = ActorCountAcks.FindByPredicate([&WorkerID](const FActorCountAck& Entry) { return Entry.WorkerID == WorkerID; });
+	return Ack != nullptr ? Ack->ReportIdx : 0;
+}
+
+void ABenchmarkGymGameModeBase::SetActorCountAck(const FString& WorkerID, int32 ReportIdx)
+{
+	if (FActorCountAck* Ack = ActorCountAcks.FindByPredicate([&WorkerID](const FActorCountAck& Entry) { return Entry.WorkerID == WorkerID; }))
+	{
+		Ack->ReportIdx = ReportIdx;
+	}
+	else
+	{
+		ActorCountAcks.Add(FActorCountAck(WorkerID, ReportIdx));
+	}
+}
+
+void ABenchmarkGymGameModeBase::TryAggregateActorCounts(bool bRequireCurrentReport)
+{
+	if (LastAggregatedActorCountReportIdx >= ActorCountReportIdx || WorkerActorCounts.Num() < NumWorkers)
+	{
+		return;
+	}
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	for (const auto& Pair : WorkerActorCounts)
+	{
+		const FWorkerActorCounts& Worker = Pair.Value;
+		if (Now - Worker.ReceivedTime > ActorCountReportWindowInSeconds || (bRequireCurrentReport && Worker.ReportIdx != ActorCountReportIdx))
 		{
-			// During actor authority handover, there's a period where no server will believe it has authority over
-			// the Unreal actor, but will still have authority over the entity. To better minimize this period, use
-			// the spatial authority as a fallback validation.
-			Worker_EntityId EntityId = SpatialDriver->PackageMap->GetEntityIdFromObject(Actor);
-			const SpatialGDK::EntityViewElement* Element = SpatialDriver->Connection->GetView().Find(EntityId);
-			if (Element != nullptr && Element->Authority.Contains(SpatialConstants::SERVER_AUTH_COMPONENT_SET_ID))
-			{
-				OutAuthCount++;
-			}
+			return;
 		}
 	}
 
-	OutTotalCount = Actors.Num();
+	LastAggregatedActorCountReportIdx = ActorCountReportIdx;
+	UpdateAndCheckTotalActorCounts();
+}
+
+void ABenchmarkGymGameModeBase::GetActorCount(const TSubclassOf<AActor>& ActorClass, int32& OutTotalCount, int32& OutAuthCount) const
+{
+	// Maintained as actors spawn, end play and change authority, see UActorCountSubsystem.
+	UActorCountSubsystem* ActorCounts = GetWorld()->GetSubsystem<UActorCountSubsystem>();
+	check(ActorCounts);
+	ActorCounts->GetActorCount(ActorClass, OutTotalCount, OutAuthCount);
 }
 
 void ABenchmarkGymGameModeBase::SetLifetime(int32 Lifetime)
@@ -898,30 +1233,50 @@ void ABenchmarkGymGameModeBase::ReportAuthoritativePlayerMovement_Implementation
 	CurrentPlayerAvgVelocity = TotalVelocity / TotalPlayers;
 }
 
-void ABenchmarkGymGameModeBase::ReportUserExperience_Implementation(const FString& WorkerID, float RTTime, float UpdateTime)
+void ABenchmarkGymGameModeBase::ReportUserExperience_Implementation(const FString& WorkerID, const FLatencySketch& RTTSketch, const FLatencySketch& UpdateTimeSketch)
 {
 	check(HasAuthority());
 
 	if (!WorkerID.IsEmpty())
 	{
-		LatestClientUXMap.Emplace(WorkerID, UX{RTTime, UpdateTime});
+		LatestClientUXMap.Emplace(WorkerID, UX{RTTSketch, UpdateTimeSketch});
 	}
 
-	AveragedClientRTTMS = 0.f;
-	AveragedClientUpdateTimeDeltaMS = 0.f;
-
-	// To extend this functionality to multi-worker, we store each server's averaged client UX metrics individually, and then iterate through
-	// each averaged value identifying the worst/max UX metric. We then check that worse averaged value against the failure threshold.
+	// Each server sends a sketch of its own clients. Merging them gives percentiles over every client in the deployment,
+	// which a max of per-server averages can't.
+	FLatencySketch GlobalRTT;
+	FLatencySketch GlobalUpdateTime;
 	for (const auto& Entry : LatestClientUXMap)
 	{
-		AveragedClientRTTMS = FMath::Max(AveragedClientRTTMS, Entry.Value.RTT);
-		AveragedClientUpdateTimeDeltaMS = FMath::Max(AveragedClientUpdateTimeDeltaMS, Entry.Value.UpdateTime);
+		GlobalRTT.Merge(Entry.Value.RTT);
+		GlobalUpdateTime.Merge(Entry.Value.UpdateTime);
 	}
 
-	GetMetrics(MetricLeftLabel, AverageClientRTTMetricName, MetricName, &ABenchmarkGymGameModeBase::GetClientRTT);
-	GetMetrics(MetricLeftLabel, AverageClientUpdateTimeDeltaMetricName, MetricName, &ABenchmarkGymGameModeBase::GetClientUpdateTimeDelta);
+	AveragedClientRTTMS = GlobalRTT.GetMean();
+	AveragedClientUpdateTimeDeltaMS = GlobalUpdateTime.GetMean();
+	ClientRTTQuantileMS = GlobalRTT.GetQuantile(UXCheckQuantile);
+	ClientUpdateTimeDeltaQuantileMS = GlobalUpdateTime.GetQuantile(UXCheckQuantile);
 
-	const bool bUXMetricValid = AveragedClientRTTMS <= MaxClientRoundTripMS && AveragedClientUpdateTimeDeltaMS <= MaxClientUpdateTimeDeltaMS;
+	UpdateMetric(ClientRTTMetric, AverageClientRTTMetricName, &ABenchmarkGymGameModeBase::GetClientRTT);
+	UpdateMetric(ClientUpdateTimeDeltaMetric, AverageClientUpdateTimeDeltaMetricName, &ABenchmarkGymGameModeBase::GetClientUpdateTimeDelta);
+
+	if (!GlobalClientRTTSummary.IsValid())
+	{
+		GlobalClientRTTSummary = UMetricsBlueprintLibrary::GetSummary(GlobalClientRTTSummaryName, { EnginePlatformLabel }, GlobalClientUXQuantiles);
+		GlobalClientUpdateTimeDeltaSummary = UMetricsBlueprintLibrary::GetSummary(GlobalClientUpdateTimeDeltaSummaryName, { EnginePlatformLabel }, GlobalClientUXQuantiles);
+	}
+	// Quantiles are over every server's latest sketch, but each report is a fresh interval, so only this one's samples are new
+	// to the lifetime _sum and _count.
+	if (GlobalClientRTTSummary.IsValid() && GlobalRTT.GetCount() > 0)
+	{
+		GlobalClientRTTSummary->SetQuantiles([&GlobalRTT](double Quantile) { return GlobalRTT.GetQuantile(Quantile); }, RTTSketch.GetSum(), RTTSketch.GetCount());
+	}
+	if (GlobalClientUpdateTimeDeltaSummary.IsValid() && GlobalUpdateTime.GetCount() > 0)
+	{
+		GlobalClientUpdateTimeDeltaSummary->SetQuantiles([&GlobalUpdateTime](double Quantile) { return GlobalUpdateTime.GetQuantile(Quantile); }, UpdateTimeSketch.GetSum(), UpdateTimeSketch.GetCount());
+	}
+
+	const bool bUXMetricValid = ClientRTTQuantileMS <= MaxClientRoundTripMS && ClientUpdateTimeDeltaQuantileMS <= MaxClientUpdateTimeDeltaMS;
 
 	const UNFRConstants* Constants = UNFRConstants::Get(GetWorld());
 	check(Constants);
@@ -930,7 +1285,8 @@ void ABenchmarkGymGameModeBase::ReportUserExperience_Implementation(const FStrin
 		Constants->UXMetricDelay.HasTimerGoneOff())
 	{
 		bHasUxFailed = true;
-		NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s: UX metric check. RTT: %.8f, UpdateDelta: %.8f"), *NFRFailureString, AveragedClientRTTMS, AveragedClientUpdateTimeDeltaMS);
+		NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s: UX metric check. p%.0f RTT: %.8f, p%.0f UpdateDelta: %.8f"), *NFRFailureString, UXCheckQuantile * 100.0f, ClientRTTQuantileMS, UXCheckQuantile * 100.0f, ClientUpdateTimeDeltaQuantileMS);
+		FNFRFlightRecorder::Get().Dump(TEXT("UX metric check failed"), true);
 	}
 }
 
@@ -942,9 +1298,14 @@ void ABenchmarkGymGameModeBase::InitStatTimer(const FString& CPUProfileString)
 	{
 		int32 FirstStartCPUProfile = FCString::Atoi(*CPUProfileIntervalString);
 		int32 CPUProfileDuration = FCString::Atoi(*CPUProfileDurationString);
-		StatStartFileTimer.SetTimer(FirstStartCPUProfile);
-		StatStopFileTimer.SetTimer(FirstStartCPUProfile + CPUProfileDuration);
 		CPUProfileInterval = FirstStartCPUProfile + CPUProfileDuration;
+		NFRScheduler.Cancel(StatStartFileHandle);
+		NFRScheduler.Cancel(StatStopFileHandle);
+		if (CPUProfileInterval > 0)
+		{
+			StatStartFileHandle = NFRScheduler.ScheduleRepeating(FirstStartCPUProfile, CPUProfileInterval, [this]() { StartStatFile(); });
+			StatStopFileHandle = NFRScheduler.ScheduleRepeating(FirstStartCPUProfile + CPUProfileDuration, CPUProfileInterval, [this]() { GEngine->Exec(GetWorld(), TEXT("stat stopfile")); });
+		}
 		UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("CPU profile interval is set to %ds, duration is set to %ds"), FirstStartCPUProfile, CPUProfileDuration);
 	}
 	else
@@ -957,41 +1318,67 @@ void ABenchmarkGymGameModeBase::InitStatTimer(const FString& CPUProfileString)
 void ABenchmarkGymGameModeBase::InitMemReportTimer(const FString& MemReportIntervalString)
 {
 	MemReportInterval = FCString::Atoi(*MemReportIntervalString);
-	MemReportIntervalTimer.SetTimer(MemReportInterval);
+	NFRScheduler.Cancel(MemReportHandle);
+	if (MemReportInterval > 0)
+	{
+		MemReportHandle = NFRScheduler.ScheduleRepeating(MemReportInterval, MemReportInterval, [this]() { WriteMemReport(); });
+	}
 	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("MemReport Interval is set to %d seconds"), MemReportInterval);
 }
 #endif
 
-void ABenchmarkGymGameModeBase::ReportAuthoritativeActorCount_Implementation(const int32 WorkerActorCountReportIdx, const FString& WorkerID, const TArray<FActorCount>& ActorCounts)
+void ABenchmarkGymGameModeBase::ReportAuthoritativeActorCount_Implementation(const int32 WorkerActorCountReportIdx, const int32 BaseReportIdx, const FString& WorkerID, const TArray<FActorCountDelta>& CountDeltas)
 {
-	ActorCountMap& ActorCountMap = WorkerActorCounts.FindOrAdd(WorkerID);
-	for (const FActorCount& ActorCount : ActorCounts)
+	const int32 MaxActorCountHistory = 4;
+
+	FWorkerActorCounts& Worker = WorkerActorCounts.FindOrAdd(WorkerID);
+	if (WorkerActorCountReportIdx <= Worker.ReportIdx)
 	{
-		ActorCountMap.FindOrAdd(ActorCount.ActorClass) = ActorCount.Count;
+		return;
 	}
 
-	ActorCountReportedIdxs.FindOrAdd(WorkerID) = WorkerActorCountReportIdx;
-	if (ActorCountReportedIdxs.Num() == NumWorkers)
+	TArray<int32> Counts;
+	if (BaseReportIdx == 0)
 	{
-		bool bAllWorkersInSync = true;
-		for (const auto& Pair : ActorCountReportedIdxs)
-		{
-			if (Pair.Value != WorkerActorCountReportIdx)
-			{
-				bAllWorkersInSync = false;
-				break;
-			}
-		}
+		Counts.SetNumZeroed(ActorCountClasses.Num());
+	}
+	else if (const TPair<int32, TArray<int32>>* Base = Worker.History.FindByPredicate([BaseReportIdx](const TPair<int32, TArray<int32>>& Entry) { return Entry.Key == BaseReportIdx; }))
+	{
+		Counts = Base->Value;
+	}
+	else
+	{
+		// We no longer have what the deltas are relative to, ask for a full report next time.
+		SetActorCountAck(WorkerID, 0);
+		return;
+	}
 
-		if (bAllWorkersInSync)
+	for (const FActorCountDelta& CountDelta : CountDeltas)
+	{
+		if (Counts.IsValidIndex(CountDelta.ClassIndex))
 		{
-			UpdateAndCheckTotalActorCounts();
+			Counts[CountDelta.ClassIndex] += CountDelta.Delta;
 		}
 	}
+
+	Worker.ReportIdx = WorkerActorCountReportIdx;
+	Worker.ReceivedTime = GetWorld()->GetTimeSeconds();
+	Worker.Counts = Counts;
+	Worker.History.Emplace(WorkerActorCountReportIdx, MoveTemp(Counts));
+	if (Worker.History.Num() > MaxActorCountHistory)
+	{
+		Worker.History.RemoveAt(0);
+	}
+	SetActorCountAck(WorkerID, WorkerActorCountReportIdx);
+
+	// Don't wait for the next period if everyone is already in.
+	TryAggregateActorCounts(true);
 }
 
 void ABenchmarkGymGameModeBase::UpdateAndCheckTotalActorCounts()
 {
+	NFR_FLIGHT_SCOPE("UpdateAndCheckTotalActorCounts");
+
 	// Clear the failure timer as we are able to calculate actor count totals.
 	FTimerManager& TimerManager = GetWorld()->GetTimerManager();
 	TimerManager.ClearTimer(FailActorCountTimeoutTimerHandle);
@@ -1013,14 +1400,14 @@ void ABenchmarkGymGameModeBase::UpdateAndCheckTotalActorCounts()
 	for (const auto& WorkerPair : WorkerActorCounts)
 	{
 		const FString& WorkerId = WorkerPair.Key;
-		const ActorCountMap& SpecificWorkerActorCounts = WorkerPair.Value;
+		const FWorkerActorCounts& SpecificWorkerActorCounts = WorkerPair.Value;
 
-		UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("--- Actor Count for Worker: %s ---"), *WorkerId);
+		UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("--- Actor Count for Worker: %s (report %d) ---"), *WorkerId, SpecificWorkerActorCounts.ReportIdx);
 
-		for (const auto& ActorCountPair : SpecificWorkerActorCounts)
+		for (int32 ClassIndex = 0; ClassIndex < SpecificWorkerActorCounts.Counts.Num() && ClassIndex < ActorCountClasses.Num(); ++ClassIndex)
 		{
-			const TSubclassOf<AActor>& ActorClass = ActorCountPair.Key;
-			const int32& ActorCount = ActorCountPair.Value;
+			const TSubclassOf<AActor>& ActorClass = ActorCountClasses[ClassIndex];
+			const int32& ActorCount = SpecificWorkerActorCounts.Counts[ClassIndex];
 
 			int32& TotalActorCount = TempTotalActorCounts.FindOrAdd(ActorClass);
 			TotalActorCount += ActorCount;
@@ -1040,7 +1427,7 @@ void ABenchmarkGymGameModeBase::UpdateAndCheckTotalActorCounts()
 		TotalActorCounts.FindOrAdd(ActorClass) = TotalActorCount;
 		UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("Class: %s, Total: %d"), *ActorClass->GetName(), TotalActorCount);
 
-		const bool bIsReadyToConsiderActorCount = Constants->ActorCheckDelay.HasTimerGoneOff() && !TestLifetimeTimer.HasTimerGoneOff();
+		const bool bIsReadyToConsiderActorCount = Constants->ActorCheckDelay.HasTimerGoneOff() && !TestLifetimeTimer.HasTimerGoneOff() && !IsCapacityStepTransitioning();
 		if (bIsReadyToConsiderActorCount)
 		{
 			// Check for test failure
@@ -1057,30 +1444,25 @@ void ABenchmarkGymGameModeBase::UpdateAndCheckTotalActorCounts()
 						ExpectedActorCount.MinCount,
 						ExpectedActorCount.MaxCount,
 						TotalActorCount);
+					FNFRFlightRecorder::Get().Dump(TEXT("Actor count check failed"), true);
 				}
 			}
-			GetMetrics(MetricLeftLabel, ActorCountValidMetricName, MetricName, &ABenchmarkGymGameModeBase::GetActorCountValid);
+			UpdateMetric(ActorCountValidMetric, ActorCountValidMetricName, &ABenchmarkGymGameModeBase::GetActorCountValid);
 		}
 	}
 }
 
 void ABenchmarkGymGameModeBase::GetVelocityForMovementReport()
 {
-	// Report logic
-	if (RequiredPlayerMovementReportTimer.HasTimerGoneOff())
-	{
-		FVector2D AvgVelocity = FVector2D(0.0f, 0.000001f);
-		// Loop each players
-		GetPlayersVelocitySum(AvgVelocity);
+	FVector2D AvgVelocity = FVector2D(0.0f, 0.000001f);
+	// Loop each players
+	GetPlayersVelocitySum(AvgVelocity);
 
-		// Avg
-		AvgVelocity.X /= AvgVelocity.Y;
+	// Avg
+	AvgVelocity.X /= AvgVelocity.Y;
 
-		// Report
-		ReportAuthoritativePlayerMovement(GetGameInstance()->GetSpatialWorkerId(), AvgVelocity);
-
-		RequiredPlayerMovementReportTimer.SetTimer(29);
-	}
+	// Report
+	ReportAuthoritativePlayerMovement(GetGameInstance()->GetSpatialWorkerId(), AvgVelocity);
 }
 
 void ABenchmarkGymGameModeBase::GetPlayersVelocitySum(FVector2D& Velocity)
@@ -1104,7 +1486,7 @@ void ABenchmarkGymGameModeBase::GetPlayersVelocitySum(FVector2D& Velocity)
 
 void ABenchmarkGymGameModeBase::CheckVelocityForPlayerMovement()
 {
-	if (!HasAuthority() || !RequiredPlayerMovementCheckTimer.HasTimerGoneOff())
+	if (!HasAuthority())
 		return;
 
 	AvgVelocityHistory.Add(CurrentPlayerAvgVelocity);
@@ -1118,9 +1500,7 @@ void ABenchmarkGymGameModeBase::CheckVelocityForPlayerMovement()
 		RecentPlayerAvgVelocity += Velocity;
 	}
 	RecentPlayerAvgVelocity /= (AvgVelocityHistory.Num() + 0.01f);
-	GetMetrics(MetricLeftLabel, PlayerMovementMetricName, MetricName, &ABenchmarkGymGameModeBase::GetPlayerMovement);
-
-	RequiredPlayerMovementCheckTimer.SetTimer(30);
+	UpdateMetric(PlayerMovementMetric, PlayerMovementMetricName, &ABenchmarkGymGameModeBase::GetPlayerMovement);
 	
 	// Extra step for native scenario.
 	const UWorld* World = GetWorld();
@@ -1136,6 +1516,7 @@ void ABenchmarkGymGameModeBase::CheckVelocityForPlayerMovement()
 		else
 		{
 			NFR_LOG(LogBenchmarkGymGameModeBase, Error, TEXT("%s:Players' average velocity is too small. Current velocity=%.1f"), *NFRFailureString, RecentPlayerAvgVelocity);
+			FNFRFlightRecorder::Get().Dump(TEXT("Player movement check failed"), true);
 		}
 	}
 }
@@ -1257,6 +1638,17 @@ void ABenchmarkGymGameModeBase::OnMaxUpdateTimeDeltaFlagUpdate(const FString& Fl
 	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("MaxClientUpdateTimeDeltaMS %d"), MaxClientUpdateTimeDeltaMS);
 }
 
+void ABenchmarkGymGameModeBase::OnMaxMemoryGrowthFlagUpdate(const FString& FlagName, const FString& FlagValue)
+{
+	MaxMemoryGrowthMBPerHour = FCString::Atoi(*FlagValue);
+	UE_LOG(LogBenchmarkGymGameModeBase, Log, TEXT("MaxMemoryGrowthMBPerHour %d"), MaxMemoryGrowthMBPerHour);
+}
+
+void ABenchmarkGymGameModeBase::OnCapacitySearchFlagUpdate(const FString& FlagName, const FString& FlagValue)
+{
+	InitCapacitySearch(FlagValue);
+}
+
 void ABenchmarkGymGameModeBase::OnTestLiftimeFlagUpdate(const FString& FlagName, const FString& FlagValue)
 {
 	SetLifetime(FCString::Atoi(*FlagValue));
@@ -1286,12 +1678,16 @@ void ABenchmarkGymGameModeBase::OnMemReportFlagUpdate(const FString& FlagName, c
 #endif
 }
 
-void ABenchmarkGymGameModeBase::GetMetrics(const FString& LeftLabel, const FString& RightLabel, const FString& MetricsName, ABenchmarkGymGameModeBase::FunctionPtrType Func)
+void ABenchmarkGymGameModeBase::UpdateMetric(FPrometheusMetricHandle& Handle, const FString& MetricLabel, ABenchmarkGymGameModeBase::FunctionPtrType Func)
 {
-	TSharedPtr<FPrometheusMetric> MetricsPtr = UMetricsBlueprintLibrary::GetMetric(MetricsName, TArray<FPrometheusLabel>{ TPair<FString, FString>(LeftLabel, RightLabel), TPair<FString,FString>(MetricEnginePlatformLeftLabel,MetricEnginePlatformRightLabel) });
-	if (MetricsPtr.IsValid())
+	// Resolve the series on first use and keep the handle, the lookup builds a sorted label key which is too slow to do every tick.
+	if (!Handle.IsValid())
+	{
+		Handle = UMetricsBlueprintLibrary::RegisterMetric(MetricName, TArray<FPrometheusLabel>{ TPair<FString, FString>(MetricLeftLabel, MetricLabel), TPair<FString,FString>(MetricEnginePlatformLeftLabel,MetricEnginePlatformRightLabel) });
+	}
+	if (Handle.IsValid())
 	{
 		auto Value = (this->*(Func))();
-		MetricsPtr->Set(Value);
+		Handle.Set(Value);
 	}
 }
@@ -3,9 +3,13 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "CapacitySearch.h"
 #include "GameFramework/GameModeBase.h"
+#include "LatencySketch.h"
+#include "MemorySampler.h"
 #include "UserExperienceReporter.h"
 #include "NFRConstants.h"
+#include "NFRScheduler.h"
 #include "MetricsBlueprintLibrary.h"
 #include "BenchmarkGymGameModeBase.generated.h"
 
@@ -14,26 +18,50 @@ DECLARE_LOG_CATEGORY_EXTERN(LogBenchmarkGymGameModeBase, Log, All);
 class USpatialWorkerFlags;
 class USpatialMetrics;
 
+// Change in a worker's authoritative count for one class, since the report the authority last acknowledged.
 USTRUCT()
-struct FActorCount
+struct FActorCountDelta
 {
 	GENERATED_BODY()
 
-	explicit FActorCount()
-		: ActorClass()
-		, Count()
+	explicit FActorCountDelta()
+		: ClassIndex(0)
+		, Delta(0)
 	{}
 
-	explicit FActorCount(const TSubclassOf<AActor>& InActorClass, int32 InCount)
-		: ActorClass(InActorClass)
-		, Count(InCount)
+	explicit FActorCountDelta(uint8 InClassIndex, int32 InDelta)
+		: ClassIndex(InClassIndex)
+		, Delta(InDelta)
 	{}
 
+	// Index into ActorCountClasses.
 	UPROPERTY()
-	TSubclassOf<AActor> ActorClass;
+	uint8 ClassIndex;
 
 	UPROPERTY()
-	int32 Count;
+	int32 Delta;
+};
+
+// Last actor count report the authority has applied for a worker. Deltas are sent relative to it, 0 asks for a full report.
+USTRUCT()
+struct FActorCountAck
+{
+	GENERATED_BODY()
+
+	explicit FActorCountAck()
+		: ReportIdx(0)
+	{}
+
+	explicit FActorCountAck(const FString& InWorkerID, int32 InReportIdx)
+		: WorkerID(InWorkerID)
+		, ReportIdx(InReportIdx)
+	{}
+
+	UPROPERTY()
+	FString WorkerID;
+
+	UPROPERTY()
+	int32 ReportIdx;
 };
 
 UCLASS()
@@ -84,6 +112,9 @@ protected:
 	bool bLongFormScenario;
 
 	virtual void BuildExpectedActorCounts();
+
+	// Whether the NPCs asked for by the last TotalNPCs change have all been spawned, the capacity search waits on it.
+	virtual bool IsNPCSpawningComplete() const { return true; }
 	void AddExpectedActorCount(const TSubclassOf<AActor>& ActorClass, const int32 MinCount, const int32 MaxCount);
 
 	UFUNCTION(BlueprintNativeEvent)
@@ -97,7 +128,7 @@ protected:
 	float GetCubeRespawnRandomRangeTime() const { return CubeRespawnRandomRangeTime; }
 
 	UFUNCTION(CrossServer, Reliable)
-	virtual void ReportAuthoritativeActorCount(const int32 WorkerActorCountReportIdx, const FString& WorkerID, const TArray<FActorCount>& ActorCounts);
+	virtual void ReportAuthoritativeActorCount(const int32 WorkerActorCountReportIdx, const int32 BaseReportIdx, const FString& WorkerID, const TArray<FActorCountDelta>& CountDeltas);
 
 	virtual void BeginPlay() override;
 	virtual void OnAuthorityLost() override;
@@ -115,14 +146,21 @@ protected:
 	virtual void ReportAuthoritativePlayerMovement(const FString& WorkerID, const FVector2D& AverageData);
 
 	UFUNCTION(CrossServer, Reliable)
-	virtual void ReportUserExperience(const FString& WorkerID, float RTTime, float UpdateTime);
+	virtual void ReportUserExperience(const FString& WorkerID, const FLatencySketch& RTTSketch, const FLatencySketch& UpdateTimeSketch);
 
 	int32 GetNumWorkers() const { return NumWorkers; }
 	int32 GetZoningCols() const { return ZoningCols; }
 	int32 GetZoningRows() const { return ZoningRows; }
 	float GetZoneWidth() const { return ZoneWidth; }
 	float GetZoneHeight() const { return ZoneHeight; }
-	int32 GetUXAuthActorCount() const { return UXAuthActorCount; }
+	int32 GetUXAuthActorCount() const;
+	int32 GetCapacitySearchMaxNPCs() const { return CapacitySearchMaxNPCs; }
+
+	// Authority only. Total across the workers' latest actor count reports, INDEX_NONE until one has come in.
+	int32 GetTotalActorCount(const TSubclassOf<AActor>& ActorClass) const;
+
+	// How long after a change in actor numbers the workers' reports can still be catching up.
+	float GetActorCountSettleSeconds() const { return 2.0f * UpdateActorCountCheckPeriodInSeconds; }
 
 	const FString NFRFailureString = TEXT("NFR scenario failed");
 
@@ -136,12 +174,14 @@ private:
 
 	struct UX
 	{
-		float RTT;
-		float UpdateTime;
+		FLatencySketch RTT;
+		FLatencySketch UpdateTime;
 	};
 	TMap<FString, UX> LatestClientUXMap;	// <worker id, UX>
 	float AveragedClientRTTMS; // The stored average of all the client RTTs
 	float AveragedClientUpdateTimeDeltaMS; // The stored average of the client view delta.
+	float ClientRTTQuantileMS; // UXCheckQuantile of all the client RTTs, checked against MaxClientRoundTripMS
+	float ClientUpdateTimeDeltaQuantileMS; // UXCheckQuantile of all the client view deltas, checked against MaxClientUpdateTimeDeltaMS
 	int32 MaxClientRoundTripMS; // Maximum allowed roundtrip
 	int32 MaxClientUpdateTimeDeltaMS;
 	bool bHasUxFailed;
@@ -149,24 +189,64 @@ private:
 	bool bHasClientFpsFailed;
 	bool bHasActorCountFailed;	// Stores if the actor count check has ever failed.
 	bool bActorCountFailureState; // Stores the *current* failure state of the Actor Count checks.
-	int32 UXAuthActorCount;
+	float UXReportIntervalInSeconds;
+	bool bPrintUXMetrics;
+
+	// For memory growth
+	FMemorySampler MemorySampler;
+	float MemorySampleIntervalInSeconds;
+	int32 MaxMemoryGrowthMBPerHour; // 0 disables the check, the samples are exported regardless
+	bool bHasMemoryGrowthFailed;
+
+	// For capacity search, enabled by setting an NPC range. Run by the authority once everyone has joined.
+	int32 CapacitySearchMinNPCs;
+	int32 CapacitySearchMaxNPCs; // 0 disables the search
+	int32 CapacitySearchResolution;
+	float CapacitySearchStepSeconds; // How long each load is held once its NPCs have spawned
+	TOptional<FCapacitySearch> CapacitySearch;
+	bool bCapacityStepSpawned;
+	double CapacityStepStartTime;
+	int32 CapacityStepSamples;
+	int32 CapacityStepFailedSamples;
+	FString CapacityStepFailure; // The last failed check, for the step log
+	int32 CapacityNPCs;
+
+	// Periodic checks and reports, ticked at the start of Tick().
+	FNFRScheduler NFRScheduler;
 
-	FMetricTimer PrintMetricsTimer;
 	FMetricTimer TestLifetimeTimer;
 
 	UPROPERTY(ReplicatedUsing = OnActorCountReportIdx)
 	int32 ActorCountReportIdx;
 
-	TMap<FString, int32> ActorCountReportedIdxs;
+	// Classes whose counts are reported, built by the authority so every worker indexes them the same way.
+	UPROPERTY(Replicated)
+	TArray<TSubclassOf<AActor>> ActorCountClasses;
+
+	UPROPERTY(Replicated)
+	TArray<FActorCountAck> ActorCountAcks;
+
+	// Authority side, the latest report from each worker plus a few earlier ones that deltas may still be based on.
+	struct FWorkerActorCounts
+	{
+		int32 ReportIdx = 0;
+		float ReceivedTime = 0.0f;
+		TArray<int32> Counts;
+		TArray<TPair<int32, TArray<int32>>> History;
+	};
+	TMap<FString, FWorkerActorCounts> WorkerActorCounts;
+	int32 LastAggregatedActorCountReportIdx;
+
+	// Worker side, counts we've sent that haven't been superseded by an acknowledged report.
+	TMap<int32, TArray<int32>> SentActorCounts;
 
 	float TimeSinceLastCheckedTotalActorCounts;
 	ActorCountMap TotalActorCounts;
-	TMap<FString, ActorCountMap> WorkerActorCounts;
 	TMap<TSubclassOf<AActor>, FExpectedActorCountConfig> ExpectedActorCounts;
 
 	// For total player
 	bool bHasRequiredPlayersCheckFailed;
-	FMetricTimer RequiredPlayerCheckTimer;
+	FNFRTimerHandle RequiredPlayerCheckHandle;
 	FMetricTimer DeploymentValidTimer;
 
 	// For sim player movement metrics
@@ -174,21 +254,19 @@ private:
 	float CurrentPlayerAvgVelocity;	// Each report will update this value.
 	float RecentPlayerAvgVelocity; // Recent 30 Avg for metrics check
 	TArray<float> AvgVelocityHistory;	// Each check will push cur avg value into this queue, and cal avg value.
-	FMetricTimer RequiredPlayerMovementReportTimer;
-	FMetricTimer RequiredPlayerMovementCheckTimer;
 	float CubeRespawnBaseTime;
 	float CubeRespawnRandomRangeTime;
 
 #if	STATS
 	// For stat profile
 	int32 CPUProfileInterval;
-	FMetricTimer StatStartFileTimer;
-	FMetricTimer StatStopFileTimer;
+	FNFRTimerHandle StatStartFileHandle;
+	FNFRTimerHandle StatStopFileHandle;
 #endif
 #if !UE_BUILD_SHIPPING
 	//For MemReport profile
 	int32 MemReportInterval;
-	FMetricTimer MemReportIntervalTimer;
+	FNFRTimerHandle MemReportHandle;
 #endif
 
 	void GatherWorkerConfiguration();
@@ -200,15 +278,29 @@ private:
 	FTimerHandle UpdateActorCountCheckTimerHandle;
 	const float UpdateActorCountCheckPeriodInSeconds = 10.0f;
 	const float UpdateActorCountCheckInitialDelayInSeconds = 60.0f;
+	// Reports older than this aren't used for totals.
+	const float ActorCountReportWindowInSeconds = 2.5f * UpdateActorCountCheckPeriodInSeconds;
 	void InitialiseActorCountCheckTimer();
+	void BuildActorCountClasses();
+	void SetActorCountAck(const FString& WorkerID, int32 ReportIdx);
+	int32 GetActorCountAck(const FString& WorkerID) const;
+	void TryAggregateActorCounts(bool bRequireCurrentReport);
 	void UpdateActorCountCheck();
 	void FailActorCountDueToTimeout();
 
-	void TickPlayersConnectedCheck(float DeltaSeconds);
-	void TickPlayersMovementCheck(float DeltaSeconds);
+	void CheckRequiredPlayers();
 	void TickServerFPSCheck(float DeltaSeconds);
 	void TickClientFPSCheck(float DeltaSeconds);
-	void TickUXMetricCheck(float DeltaSeconds);
+	void ReportUXMetrics();
+	void CheckMemoryGrowth();
+
+	void InitCapacitySearch(const FString& CapacitySearchString);
+	void StartCapacitySearch();
+	void StartCapacityStep();
+	void TickCapacitySearch();
+	bool IsCapacityStepPassing(FString& OutFailure) const;
+	// True from a step changing the NPC count until the actor counts have caught up with it.
+	bool IsCapacityStepTransitioning() const;
 
 	void SetTotalNPCs(int32 Value);
 
@@ -219,13 +311,17 @@ private:
 	double GetClientFPSValid() const { return !bHasClientFpsFailed ? 1.0 : 0.0; }
 	double GetActorCountValid() const { return !bActorCountFailureState ? 1.0 : 0.0; }
 	double GetPlayerMovement() const { return RecentPlayerAvgVelocity; }
+	double GetMemoryGrowthValid() const { return !bHasMemoryGrowthFailed ? 1.0 : 0.0; }
+	double GetCapacityNPCs() const { return CapacityNPCs; }
 
 	void SetLifetime(int32 Lifetime);
 #if	STATS
 	void InitStatTimer(const FString& CPUProfileString);
+	void StartStatFile();
 #endif
 #if !UE_BUILD_SHIPPING
 	void InitMemReportTimer(const FString& MemReportIntervalString);
+	void WriteMemReport();
 #endif
 
 	UFUNCTION()
@@ -259,6 +355,12 @@ private:
 	UFUNCTION()
 	void OnMaxUpdateTimeDeltaFlagUpdate(const FString& FlagName, const FString& FlagValue);
 
+	UFUNCTION()
+	void OnMaxMemoryGrowthFlagUpdate(const FString& FlagName, const FString& FlagValue);
+
+	UFUNCTION()
+	void OnCapacitySearchFlagUpdate(const FString& FlagName, const FString& FlagValue);
+
 	UFUNCTION()
 	void OnTestLiftimeFlagUpdate(const FString& FlagName, const FString& FlagValue);
 
@@ -275,5 +377,17 @@ private:
 	void OnMemReportFlagUpdate(const FString& FlagName, const FString& FlagValue);
 	// Metrics
 	typedef double (ABenchmarkGymGameModeBase::* FunctionPtrType)(void) const;
-	void GetMetrics(const FString& LeftLabel, const FString& RightLabel, const FString& MetricsName, ABenchmarkGymGameModeBase::FunctionPtrType Func);
+	void UpdateMetric(FPrometheusMetricHandle& Handle, const FString& MetricLabel, ABenchmarkGymGameModeBase::FunctionPtrType Func);
+
+	FPrometheusMetricHandle ClientRTTMetric;
+	FPrometheusMetricHandle ClientUpdateTimeDeltaMetric;
+	TSharedPtr<FPrometheusSummary, ESPMode::ThreadSafe> GlobalClientRTTSummary;
+	TSharedPtr<FPrometheusSummary, ESPMode::ThreadSafe> GlobalClientUpdateTimeDeltaSummary;
+	FPrometheusMetricHandle RequiredPlayersValidMetric;
+	FPrometheusMetricHandle FPSValidMetric;
+	FPrometheusMetricHandle ClientFPSValidMetric;
+	FPrometheusMetricHandle ActorCountValidMetric;
+	FPrometheusMetricHandle PlayerMovementMetric;
+	FPrometheusMetricHandle MemoryGrowthValidMetric;
+	FPrometheusMetricHandle CapacityMetric;
 };
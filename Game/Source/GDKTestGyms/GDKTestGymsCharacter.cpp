@@ -64,6 +64,18 @@ void AGDKTestGymsCharacter::PostInitializeComponents()
 	TestGymsMovementComponent->bClientAuthMovement = bClientAuthMovement;
 }
 
+void AGDKTestGymsCharacter::OnAuthorityGained()
+{
+	Super::OnAuthorityGained();
+	UActorCountSubsystem::NotifyAuthorityChanged(this);
+}
+
+void AGDKTestGymsCharacter::OnAuthorityLost()
+{
+	Super::OnAuthorityLost();
+	UActorCountSubsystem::NotifyAuthorityChanged(this);
+}
+
 void AGDKTestGymsCharacter::ClientAuthServerMove_Implementation(const FVector_NetQuantize100& ClientLocation, const FVector_NetQuantize10& ClientVelocity, const uint32 PackedPitchYaw)
 {
 	TestGymsMovementComponent->ClientAuthServerMove_Implementation(ClientLocation, ClientVelocity, PackedPitchYaw);
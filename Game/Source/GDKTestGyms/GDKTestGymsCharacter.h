@@ -3,13 +3,14 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "ActorCountSubsystem.h"
 #include "GameFramework/Character.h"
 #include "GDKTestGymsCharacter.generated.h"
 
 class UTestGymsCharacterMovementComp;
 
 UCLASS(config=Game, SpatialType)
-class AGDKTestGymsCharacter : public ACharacter
+class AGDKTestGymsCharacter : public ACharacter, public IActorCountAuthorityReporter
 {
 	GENERATED_BODY()
 
@@ -25,6 +26,8 @@ public:
 
 	virtual void BeginPlay() override;
 	virtual void PostInitializeComponents() override;
+	virtual void OnAuthorityGained() override;
+	virtual void OnAuthorityLost() override;
 
 	UFUNCTION(Server, Unreliable)
 	void ClientAuthServerMove(const FVector_NetQuantize100& ClientLocation, const FVector_NetQuantize10& ClientVelocity, const uint32 PackedPitchYaw);
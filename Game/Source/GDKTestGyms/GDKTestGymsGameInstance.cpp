@@ -14,6 +14,16 @@
 #include "EngineMinimal.h"
 #include "Engine/Engine.h"
 #include "LatencyTracer.h"
+#include "MetricsBlueprintLibrary.h"
+#include "NFRFlightRecorder.h"
+
+namespace
+{
+	const FString FrameTimeHistogramName = TEXT("unreal_frame_time_ms");
+
+	// Buckets around the 60/30/20 FPS frame budgets, then coarser for hitches.
+	const TArray<double> FrameTimeBucketsMS = { 8.0, 16.7, 20.0, 25.0, 33.3, 50.0, 66.7, 100.0, 200.0, 500.0, 1000.0 };
+}
 
 void UGDKTestGymsGameInstance::Init()
 {
@@ -21,7 +31,6 @@ void UGDKTestGymsGameInstance::Init()
 
 	TickDelegate = FTickerDelegate::CreateUObject(this, &UGDKTestGymsGameInstance::Tick);
 	TickDelegateHandle = FTicker::GetCoreTicker().AddTicker(TickDelegate);
-	TickWindowTotal = 0;
 	GetEngine()->NetworkFailureEvent.AddUObject(this, &UGDKTestGymsGameInstance::NetworkFailureEventCallback);
 	NFRConstants = NewObject<UNFRConstants>(this);
 	NFRConstants->InitWithWorld(GetWorld());
@@ -62,7 +71,10 @@ void UGDKTestGymsGameInstance::Shutdown()
 	{
 		UE_LOG(LogTemp, Warning, TEXT("StopSession: Failed to get the default analytics provider. Double check your [Analytics] configuration in your INI"));
 	}
-	
+
+	FrameBreakdown.Unbind();
+	FNFRFlightRecorder::Get().Unbind();
+
 	Super::Shutdown();
 }
 
@@ -98,41 +110,6 @@ void UGDKTestGymsGameInstance::OnStart()
 	}
 }
 
-float UGDKTestGymsGameInstance::AddAndCalcFps(int64 NowReal, float DeltaS)
-{
-	int64 DeltaTicks = FTimespan::FromSeconds(DeltaS).GetTicks();
-	TicksForFPS.Push(TPair<int64, int64>(NowReal, DeltaTicks)); 
-	TickWindowTotal += DeltaTicks;
-
-	int64 MinRange = NowReal - FTimespan::FromMinutes(2.0).GetTicks();
-	
-	// Trim samples
-	int NumToRemove = 0;
-	for(int i = 0; i < TicksForFPS.Num(); i++)
-	{
-		const FPSTimePoint& TimePoint = TicksForFPS[i];
-		if (TimePoint.Key > MinRange) // Find the first valid sample
-		{
-			NumToRemove = i;
-			break;
-		}
-	}
-	if (NumToRemove > 0)
-	{
-		for (int i = 0; i < NumToRemove; i++)
-		{
-			TickWindowTotal -= TicksForFPS[i].Value;
-		}
-		memmove(&TicksForFPS[0], &TicksForFPS[NumToRemove], (TicksForFPS.Num() - NumToRemove) * sizeof(FPSTimePoint));
-		TicksForFPS.SetNum(TicksForFPS.Num() - NumToRemove);
-	}
-	if (TicksForFPS.Num() > 0)
-	{
-		return static_cast<float>(TicksForFPS.Num()) / FTimespan(TickWindowTotal).GetTotalSeconds(); // 1.0f / Total / Samples 
-	}
-	return 60.0f; // If there are no samples return the ideal
-}
-
 void UGDKTestGymsGameInstance::NetworkFailureEventCallback(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString)
 {
 	UE_LOG(LogTemp, Warning, TEXT("UGDKTestGymsGameInstance: Network Failure (%s)"), *ErrorString);
@@ -154,13 +131,41 @@ void UGDKTestGymsGameInstance::NetworkFailureEventCallback(UWorld* World, UNetDr
 
 bool UGDKTestGymsGameInstance::Tick(float DeltaSeconds)
 {	
-	AverageFPS = AddAndCalcFps(FDateTime::Now().GetTicks(), DeltaSeconds);
+	const double NowSeconds = FPlatformTime::Seconds();
+	FPSWindow.AddFrame(NowSeconds, DeltaSeconds);
+	UWorld* World = GetWorld();
+	FNFRFlightRecorder::Get().EndFrame(DeltaSeconds, World != nullptr ? World->GetNetDriver() : nullptr);
+	FNFRFlightRecorder::Get().Bind(World);
+
+	if (World != nullptr && (World->GetNetMode() == NM_DedicatedServer || World->GetNetMode() == NM_ListenServer))
+	{
+		// Rebinds after a server travel.
+		FrameBreakdown.Bind(World);
+	}
+	FrameBreakdown.EndFrame(NowSeconds, DeltaSeconds);
+
+	// Clients record frame times too, so label them apart from the workers' the same way the latency tracer does.  The net
+	// mode isn't known until there's a world, and can change on travel.
+	if (World != nullptr)
+	{
+		const ENetMode NetMode = World->GetNetMode();
+		const TCHAR* EnginePlatform = NetMode == NM_Client || NetMode == NM_Standalone ? TEXT("UnrealClient") : TEXT("UnrealWorker");
+		if (FrameTimeHistogramPlatform != EnginePlatform)
+		{
+			FrameTimeHistogramPlatform = EnginePlatform;
+			FrameTimeHistogram = UMetricsBlueprintLibrary::GetHistogram(FrameTimeHistogramName, { FPrometheusLabel(TEXT("engine_platform"), EnginePlatform) }, FrameTimeBucketsMS);
+		}
+	}
+	if (FrameTimeHistogram.IsValid())
+	{
+		FrameTimeHistogram->Observe(DeltaSeconds * 1000.0);
+	}
 	SecondsSinceFPSLog += DeltaSeconds;
 
 	if (SecondsSinceFPSLog > 10.0f) 
 	{
 		SecondsSinceFPSLog = 0.0f;
-		NFR_LOG(LogTemp, Log, TEXT("FramesPerSecond is %f, 2 min avg is %f"), 1.f / DeltaSeconds, AverageFPS);
+		NFR_LOG(LogTemp, Log, TEXT("FramesPerSecond is %f, 2 min avg is %f, 1%% low is %f, p99 frame time is %.1fms"), 1.f / DeltaSeconds, GetAveragedFPS(), GetOnePercentLowFPS(), GetP99FrameTimeMS());
 	}
 
 	return true;
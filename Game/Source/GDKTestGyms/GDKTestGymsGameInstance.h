@@ -4,6 +4,8 @@
 
 #include "NFRConstants.h"
 #include "EngineClasses/SpatialGameInstance.h"
+#include "FrameBreakdown.h"
+#include "FrameTimeWindow.h"
 
 #include "CoreMinimal.h"
 #include "Engine/NetDriver.h"
@@ -19,6 +21,7 @@
 #define NFR_LOG(...) 0
 #endif
 
+class FPrometheusHistogram;
 class ULatencyTracer;
 
 UCLASS()
@@ -32,7 +35,11 @@ public:
 
 	bool Tick(float DeltaSeconds);
 	virtual void OnStart() override;
-	float GetAveragedFPS() const { return AverageFPS; }
+	float GetAveragedFPS() const { return FPSWindow.GetAverageFPS(); }
+	float GetOnePercentLowFPS() const { return FPSWindow.GetOnePercentLowFPS(); }
+	float GetP99FrameTimeMS() const { return FPSWindow.GetFrameTimePercentileMS(0.99f); }
+	FServerFrameBreakdown& GetFrameBreakdown() { return FrameBreakdown; }
+	const FServerFrameBreakdown& GetFrameBreakdown() const { return FrameBreakdown; }
 	void NetworkFailureEventCallback(UWorld* World, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString);
 
 	const UNFRConstants* GetNFRConstants() const { return NFRConstants; }
@@ -41,10 +48,11 @@ public:
 	ULatencyTracer* GetOrCreateLatencyTracer();
 
 private:
-	using FPSTimePoint = TPair<int64, int64>; // Real, FrameDelta
-	int64 TickWindowTotal;
-	TArray<FPSTimePoint> TicksForFPS;
-	float AddAndCalcFps(int64 NowReal, float DeltaS);
+	// The last 2 minutes of frames, sized for up to 120 FPS.
+	FFrameTimeWindow FPSWindow{ 2.0 * 60.0, 2 * 60 * 120 };
+
+	// Where the server's frames went over the same 2 minutes.
+	FServerFrameBreakdown FrameBreakdown{ 2 * 60 };
 
 	UFUNCTION()
 	void SpatialConnected();
@@ -57,6 +65,9 @@ private:
 	UPROPERTY()
 	ULatencyTracer* Tracer;
 
-	float AverageFPS = 60.0f;
 	float SecondsSinceFPSLog = 10.0f;
+
+	// Frame time distribution, exported so hitches show up in the tail instead of being averaged away.
+	TSharedPtr<FPrometheusHistogram, ESPMode::ThreadSafe> FrameTimeHistogram;
+	FString FrameTimeHistogramPlatform;
 };
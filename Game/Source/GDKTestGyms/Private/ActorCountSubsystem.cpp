@@ -0,0 +1,220 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "ActorCountSubsystem.h"
+
+#include "Engine/World.h"
+#include "EngineClasses/SpatialNetDriver.h"
+#include "EngineClasses/SpatialPackageMapClient.h"
+#include "EngineUtils.h"
+#include "Interop/Connection/SpatialWorkerConnection.h"
+#include "SpatialView/EntityView.h"
+
+void UActorCountSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UActorCountSubsystem::OnActorSpawned));
+}
+
+void UActorCountSubsystem::Deinitialize()
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	TrackedActors.Empty();
+	PendingActors.Empty();
+	TrackedClasses.Empty();
+	Super::Deinitialize();
+}
+
+void UActorCountSubsystem::TrackClass(const TSubclassOf<AActor>& ActorClass)
+{
+	if (ActorClass == nullptr || TrackedClasses.ContainsByPredicate([&ActorClass](const FTrackedClass& Tracked) { return Tracked.ActorClass == ActorClass; }))
+	{
+		return;
+	}
+
+	if (!ensureMsgf(TrackedClasses.Num() < 32, TEXT("Too many actor classes tracked, %s won't be counted"), *ActorClass->GetName()))
+	{
+		return;
+	}
+
+	const int32 ClassIndex = TrackedClasses.AddDefaulted();
+	TrackedClasses[ClassIndex].ActorClass = ActorClass;
+
+	// One walk to pick up what's already in the world, spawns keep it up to date from here.
+	for (TActorIterator<AActor> It(GetWorld(), ActorClass); It; ++It)
+	{
+		AActor* Actor = *It;
+		if (Actor->IsActorBeingDestroyed())
+		{
+			continue;
+		}
+
+		if (FTrackedActor* Tracked = TrackedActors.Find(Actor))
+		{
+			// Already counted towards another class.
+			Tracked->ClassMask |= 1u << ClassIndex;
+			FTrackedClass& TrackedClass = TrackedClasses[ClassIndex];
+			TrackedClass.TotalCount++;
+			TrackedClass.AuthCount += Tracked->bAuthoritative ? 1 : 0;
+		}
+		else
+		{
+			AddActor(Actor, 1u << ClassIndex);
+		}
+	}
+}
+
+void UActorCountSubsystem::GetActorCount(const TSubclassOf<AActor>& ActorClass, int32& OutTotalCount, int32& OutAuthCount)
+{
+	const int32 ClassIndex = TrackedClasses.IndexOfByPredicate([&ActorClass](const FTrackedClass& Tracked) { return Tracked.ActorClass == ActorClass; });
+	if (ClassIndex == INDEX_NONE)
+	{
+		OutTotalCount = 0;
+		OutAuthCount = 0;
+		return;
+	}
+
+	// Rechecking can settle an actor, which removes it from the set.
+	const uint32 ClassBit = 1u << ClassIndex;
+	for (AActor* Actor : PendingActors.Array())
+	{
+		FTrackedActor& Tracked = TrackedActors.FindChecked(Actor);
+		if ((Tracked.ClassMask & ClassBit) != 0)
+		{
+			UpdateAuthority(Actor, Tracked);
+		}
+	}
+
+	OutTotalCount = TrackedClasses[ClassIndex].TotalCount;
+	OutAuthCount = TrackedClasses[ClassIndex].AuthCount;
+}
+
+void UActorCountSubsystem::NotifyAuthorityChanged(AActor* Actor)
+{
+	UWorld* World = Actor->GetWorld();
+	if (World == nullptr)
+	{
+		return;
+	}
+
+	if (UActorCountSubsystem* Subsystem = World->GetSubsystem<UActorCountSubsystem>())
+	{
+		if (FTrackedActor* Tracked = Subsystem->TrackedActors.Find(Actor))
+		{
+			Subsystem->UpdateAuthority(Actor, *Tracked);
+		}
+	}
+}
+
+void UActorCountSubsystem::OnActorSpawned(AActor* Actor)
+{
+	const uint32 ClassMask = GetClassMask(Actor);
+	if (ClassMask != 0)
+	{
+		AddActor(Actor, ClassMask);
+	}
+}
+
+void UActorCountSubsystem::OnActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+	FTrackedActor Tracked;
+	if (!TrackedActors.RemoveAndCopyValue(Actor, Tracked))
+	{
+		return;
+	}
+	PendingActors.Remove(Actor);
+
+	for (int32 ClassIndex = 0; ClassIndex < TrackedClasses.Num(); ++ClassIndex)
+	{
+		if ((Tracked.ClassMask & (1u << ClassIndex)) != 0)
+		{
+			TrackedClasses[ClassIndex].TotalCount--;
+			TrackedClasses[ClassIndex].AuthCount -= Tracked.bAuthoritative ? 1 : 0;
+		}
+	}
+}
+
+void UActorCountSubsystem::AddActor(AActor* Actor, uint32 ClassMask)
+{
+	FTrackedActor& Tracked = TrackedActors.Add(Actor);
+	Tracked.ClassMask = ClassMask;
+	Tracked.bReportsAuthority = Actor->Implements<UActorCountAuthorityReporter>();
+
+	for (int32 ClassIndex = 0; ClassIndex < TrackedClasses.Num(); ++ClassIndex)
+	{
+		if ((ClassMask & (1u << ClassIndex)) != 0)
+		{
+			TrackedClasses[ClassIndex].TotalCount++;
+		}
+	}
+
+	Actor->OnEndPlay.AddUniqueDynamic(this, &UActorCountSubsystem::OnActorEndPlay);
+	UpdateAuthority(Actor, Tracked);
+}
+
+void UActorCountSubsystem::UpdateAuthority(AActor* Actor, FTrackedActor& Tracked)
+{
+	const bool bUnrealAuthority = Actor->HasAuthority();
+	const bool bEntityAuthority = !bUnrealAuthority && HasEntityAuthority(Actor, Tracked);
+	SetAuthoritative(Tracked, bUnrealAuthority || bEntityAuthority);
+
+	// Only settled once the actor will tell us about its next change. Without SpatialOS authority never moves.
+	const bool bSpatial = Cast<USpatialNetDriver>(GetWorld()->GetNetDriver()) != nullptr;
+	if (!bSpatial || (Tracked.bReportsAuthority && !bEntityAuthority))
+	{
+		PendingActors.Remove(Actor);
+	}
+	else
+	{
+		PendingActors.Add(Actor);
+	}
+}
+
+void UActorCountSubsystem::SetAuthoritative(FTrackedActor& Tracked, bool bAuthoritative)
+{
+	if (Tracked.bAuthoritative == bAuthoritative)
+	{
+		return;
+	}
+	Tracked.bAuthoritative = bAuthoritative;
+
+	const int32 Delta = bAuthoritative ? 1 : -1;
+	for (int32 ClassIndex = 0; ClassIndex < TrackedClasses.Num(); ++ClassIndex)
+	{
+		if ((Tracked.ClassMask & (1u << ClassIndex)) != 0)
+		{
+			TrackedClasses[ClassIndex].AuthCount += Delta;
+		}
+	}
+}
+
+bool UActorCountSubsystem::HasEntityAuthority(const AActor* Actor, FTrackedActor& Tracked) const
+{
+	const USpatialNetDriver* SpatialDriver = Cast<USpatialNetDriver>(GetWorld()->GetNetDriver());
+	if (SpatialDriver == nullptr || SpatialDriver->PackageMap == nullptr || SpatialDriver->Connection == nullptr)
+	{
+		return false;
+	}
+
+	// During actor authority handover, there's a period where no server will believe it has authority over
+	// the Unreal actor, but will still have authority over the entity. To better minimize this period, use
+	// the spatial authority as a fallback validation.
+	if (Tracked.EntityId == SpatialConstants::INVALID_ENTITY_ID)
+	{
+		Tracked.EntityId = SpatialDriver->PackageMap->GetEntityIdFromObject(Actor);
+	}
+	const SpatialGDK::EntityViewElement* Element = SpatialDriver->Connection->GetView().Find(Tracked.EntityId);
+	return Element != nullptr && Element->Authority.Contains(SpatialConstants::SERVER_AUTH_COMPONENT_SET_ID);
+}
+
+uint32 UActorCountSubsystem::GetClassMask(const AActor* Actor) const
+{
+	uint32 ClassMask = 0;
+	for (int32 ClassIndex = 0; ClassIndex < TrackedClasses.Num(); ++ClassIndex)
+	{
+		if (Actor->IsA(TrackedClasses[ClassIndex].ActorClass))
+		{
+			ClassMask |= 1u << ClassIndex;
+		}
+	}
+	return ClassMask;
+}
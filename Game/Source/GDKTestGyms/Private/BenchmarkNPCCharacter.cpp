@@ -2,10 +2,19 @@
 
 #include "BenchmarkNPCCharacter.h"
 
+void ABenchmarkNPCCharacter::OnAuthorityGained()
+{
+	Super::OnAuthorityGained();
+
+	UActorCountSubsystem::NotifyAuthorityChanged(this);
+}
+
 void ABenchmarkNPCCharacter::OnAuthorityLost()
 {
 	Super::OnAuthorityLost();
 
+	UActorCountSubsystem::NotifyAuthorityChanged(this);
+
 	if (Controller)
 	{
 		Controller->Destroy();
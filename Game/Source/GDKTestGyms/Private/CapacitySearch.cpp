@@ -0,0 +1,54 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "CapacitySearch.h"
+
+FCapacitySearch::FCapacitySearch(int32 InMinLoad, int32 InMaxLoad, int32 InResolution)
+	: MinLoad(FMath::Max(0, InMinLoad))
+	, MaxLoad(FMath::Max(MinLoad, InMaxLoad))
+	, Resolution(FMath::Max(1, InResolution))
+	, CurrentLoad(MinLoad)
+{
+}
+
+void FCapacitySearch::ReportResult(bool bPassed)
+{
+	if (bFinished)
+	{
+		return;
+	}
+
+	if (bPassed)
+	{
+		HighestPass = CurrentLoad;
+	}
+	else
+	{
+		LowestFailure = CurrentLoad;
+	}
+
+	if (LowestFailure == INDEX_NONE)
+	{
+		// Still ramping.
+		if (CurrentLoad >= MaxLoad)
+		{
+			bFinished = true;
+			return;
+		}
+		CurrentLoad = FMath::Min(MaxLoad, FMath::Max(CurrentLoad + Resolution, CurrentLoad * 2));
+		return;
+	}
+
+	if (HighestPass == INDEX_NONE)
+	{
+		// MinLoad itself failed, there's nothing lower to try.
+		bFinished = true;
+		return;
+	}
+
+	if (LowestFailure - HighestPass <= Resolution)
+	{
+		bFinished = true;
+		return;
+	}
+	CurrentLoad = HighestPass + (LowestFailure - HighestPass) / 2;
+}
@@ -0,0 +1,260 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "FrameBreakdown.h"
+
+#include "Engine/World.h"
+#include "HAL/PlatformTime.h"
+#include "MetricsBlueprintLibrary.h"
+#include "PrometheusServer.h"
+#include "UObject/UObjectGlobals.h"
+
+namespace
+{
+	const FString PhaseHistogramName = TEXT("unreal_frame_phase_ms");
+}
+
+FServerFrameBreakdown::FServerFrameBreakdown(int32 InWindowSeconds)
+{
+	Buckets.SetNum(FMath::Max(1, InWindowSeconds));
+}
+
+FServerFrameBreakdown::~FServerFrameBreakdown()
+{
+	Unbind();
+}
+
+void FServerFrameBreakdown::Bind(UWorld* World)
+{
+	if (World == nullptr || BoundWorld.Get() == World)
+	{
+		return;
+	}
+	Unbind();
+
+	BoundWorld = World;
+	TickStartHandle = FWorldDelegates::OnWorldTickStart.AddRaw(this, &FServerFrameBreakdown::OnWorldTickStart);
+	PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddRaw(this, &FServerFrameBreakdown::OnPreActorTick);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddRaw(this, &FServerFrameBreakdown::OnPostActorTick);
+	PostTickDispatchHandle = World->PostTickDispatchEvent.AddRaw(this, &FServerFrameBreakdown::OnPostTickDispatch);
+	PostTickFlushHandle = World->PostTickFlushEvent.AddRaw(this, &FServerFrameBreakdown::OnPostTickFlush);
+	PreGarbageCollectHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddRaw(this, &FServerFrameBreakdown::OnPreGarbageCollect);
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &FServerFrameBreakdown::OnPostGarbageCollect);
+
+	for (int32 Phase = 0; Phase < NumPhases; ++Phase)
+	{
+		if (!PhaseHistograms[Phase].IsValid())
+		{
+			// Fine grained under a 30 FPS budget, where most phases sit, then coarser for hitches.
+			const TArray<double> PhaseBucketsMS = { 0.5, 1.0, 2.0, 4.0, 8.0, 16.7, 33.3, 66.7, 100.0, 250.0, 1000.0 };
+			PhaseHistograms[Phase] = UMetricsBlueprintLibrary::GetHistogram(PhaseHistogramName, {
+				FPrometheusLabel(TEXT("engine_platform"), TEXT("UnrealWorker")),
+				FPrometheusLabel(TEXT("phase"), GetPhaseName(static_cast<EPhase>(Phase))) }, PhaseBucketsMS);
+		}
+	}
+}
+
+void FServerFrameBreakdown::Unbind()
+{
+	FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGarbageCollectHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+	if (UWorld* World = BoundWorld.Get())
+	{
+		World->PostTickDispatchEvent.Remove(PostTickDispatchHandle);
+		World->PostTickFlushEvent.Remove(PostTickFlushHandle);
+	}
+	BoundWorld.Reset();
+	bPhaseOpen = false;
+}
+
+void FServerFrameBreakdown::AddReplicationGraphTime(double Seconds)
+{
+	FramePhaseSeconds[static_cast<int32>(EPhase::ReplicationGraph)] += Seconds;
+	NestedSeconds += Seconds;
+}
+
+void FServerFrameBreakdown::EndFrame(double NowSeconds, float DeltaSeconds)
+{
+	if (!IsBound())
+	{
+		return;
+	}
+
+	double TrackedSeconds = 0.0;
+	for (int32 Phase = 0; Phase < NumPhases; ++Phase)
+	{
+		TrackedSeconds += FramePhaseSeconds[Phase];
+	}
+	FramePhaseSeconds[static_cast<int32>(EPhase::Other)] = FMath::Max(0.0, DeltaSeconds - TrackedSeconds);
+
+	const int64 Second = FMath::FloorToInt(NowSeconds);
+	FSecondBucket& Bucket = Buckets[Second % Buckets.Num()];
+	if (Bucket.Second != Second)
+	{
+		Bucket = FSecondBucket();
+		Bucket.Second = Second;
+	}
+	Bucket.NumFrames++;
+
+	for (int32 Phase = 0; Phase < NumPhases; ++Phase)
+	{
+		Bucket.PhaseSeconds[Phase] += FramePhaseSeconds[Phase];
+		if (PhaseHistograms[Phase].IsValid())
+		{
+			PhaseHistograms[Phase]->Observe(FramePhaseSeconds[Phase] * 1000.0);
+		}
+		FramePhaseSeconds[Phase] = 0.0;
+	}
+}
+
+float FServerFrameBreakdown::GetAveragePhaseMS(EPhase Phase) const
+{
+	double PhaseSeconds[NumPhases];
+	int32 NumFrames;
+	GetWindowTotals(PhaseSeconds, NumFrames);
+	return NumFrames > 0 ? static_cast<float>(PhaseSeconds[static_cast<int32>(Phase)] * 1000.0 / NumFrames) : 0.0f;
+}
+
+FServerFrameBreakdown::EPhase FServerFrameBreakdown::GetDominantPhase() const
+{
+	double PhaseSeconds[NumPhases];
+	int32 NumFrames;
+	GetWindowTotals(PhaseSeconds, NumFrames);
+
+	int32 Dominant = 0;
+	for (int32 Phase = 1; Phase < static_cast<int32>(EPhase::Other); ++Phase)
+	{
+		if (PhaseSeconds[Phase] > PhaseSeconds[Dominant])
+		{
+			Dominant = Phase;
+		}
+	}
+	return static_cast<EPhase>(Dominant);
+}
+
+FString FServerFrameBreakdown::ToString() const
+{
+	double PhaseSeconds[NumPhases];
+	int32 NumFrames;
+	GetWindowTotals(PhaseSeconds, NumFrames);
+	if (NumFrames == 0)
+	{
+		return TEXT("no frames");
+	}
+
+	TArray<int32, TInlineAllocator<NumPhases>> Order;
+	for (int32 Phase = 0; Phase < NumPhases; ++Phase)
+	{
+		Order.Add(Phase);
+	}
+	Order.Sort([&PhaseSeconds](int32 A, int32 B) { return PhaseSeconds[A] > PhaseSeconds[B]; });
+
+	FString Result;
+	for (int32 Phase : Order)
+	{
+		Result += FString::Printf(TEXT("%s%s %.1fms"), Result.IsEmpty() ? TEXT("") : TEXT(", "), GetPhaseName(static_cast<EPhase>(Phase)), PhaseSeconds[Phase] * 1000.0 / NumFrames);
+	}
+	return Result;
+}
+
+const TCHAR* FServerFrameBreakdown::GetPhaseName(EPhase Phase)
+{
+	switch (Phase)
+	{
+	case EPhase::NetReceive:		return TEXT("NetReceive");
+	case EPhase::ActorTick:			return TEXT("ActorTick");
+	case EPhase::ReplicationGraph:	return TEXT("ReplicationGraph");
+	case EPhase::NetSend:			return TEXT("NetSend");
+	case EPhase::GarbageCollection:	return TEXT("GarbageCollection");
+	case EPhase::Other:				return TEXT("Other");
+	default:						return TEXT("Unknown");
+	}
+}
+
+void FServerFrameBreakdown::OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == BoundWorld.Get())
+	{
+		OpenPhase();
+	}
+}
+
+void FServerFrameBreakdown::OnPostTickDispatch()
+{
+	ClosePhase(EPhase::NetReceive);
+}
+
+void FServerFrameBreakdown::OnPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == BoundWorld.Get())
+	{
+		OpenPhase();
+	}
+}
+
+void FServerFrameBreakdown::OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == BoundWorld.Get())
+	{
+		ClosePhase(EPhase::ActorTick);
+		OpenPhase();
+	}
+}
+
+void FServerFrameBreakdown::OnPostTickFlush()
+{
+	ClosePhase(EPhase::NetSend);
+}
+
+void FServerFrameBreakdown::OnPreGarbageCollect()
+{
+	GarbageCollectStartTime = FPlatformTime::Seconds();
+}
+
+void FServerFrameBreakdown::OnPostGarbageCollect()
+{
+	const double Seconds = FPlatformTime::Seconds() - GarbageCollectStartTime;
+	FramePhaseSeconds[static_cast<int32>(EPhase::GarbageCollection)] += Seconds;
+	NestedSeconds += Seconds;
+}
+
+void FServerFrameBreakdown::OpenPhase()
+{
+	bPhaseOpen = true;
+	PhaseStartTime = FPlatformTime::Seconds();
+	PhaseStartNestedSeconds = NestedSeconds;
+}
+
+void FServerFrameBreakdown::ClosePhase(EPhase Phase)
+{
+	if (!bPhaseOpen)
+	{
+		return;
+	}
+	bPhaseOpen = false;
+
+	const double Seconds = FPlatformTime::Seconds() - PhaseStartTime - (NestedSeconds - PhaseStartNestedSeconds);
+	FramePhaseSeconds[static_cast<int32>(Phase)] += FMath::Max(0.0, Seconds);
+}
+
+void FServerFrameBreakdown::GetWindowTotals(double (&OutPhaseSeconds)[NumPhases], int32& OutNumFrames) const
+{
+	FMemory::Memzero(OutPhaseSeconds);
+	OutNumFrames = 0;
+
+	const int64 NowSecond = FMath::FloorToInt(FPlatformTime::Seconds());
+	for (const FSecondBucket& Bucket : Buckets)
+	{
+		if (Bucket.Second < 0 || NowSecond - Bucket.Second >= Buckets.Num())
+		{
+			continue;
+		}
+		OutNumFrames += Bucket.NumFrames;
+		for (int32 Phase = 0; Phase < NumPhases; ++Phase)
+		{
+			OutPhaseSeconds[Phase] += Bucket.PhaseSeconds[Phase];
+		}
+	}
+}
@@ -0,0 +1,96 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "FrameTimeWindow.h"
+
+namespace
+{
+	const float LogBucketGrowth = FMath::Loge(FFrameTimeWindow::BucketGrowth);
+}
+
+FFrameTimeWindow::FFrameTimeWindow(double InWindowSeconds, int32 InMaxFrames)
+	: WindowSeconds(InWindowSeconds)
+{
+	Frames.SetNumUninitialized(FMath::Max(1, InMaxFrames));
+}
+
+void FFrameTimeWindow::AddFrame(double NowSeconds, float DeltaSeconds)
+{
+	while (NumFrames > 0 && Frames[Head].Time <= NowSeconds - WindowSeconds)
+	{
+		RemoveOldest();
+	}
+	if (NumFrames == Frames.Num())
+	{
+		RemoveOldest();
+	}
+
+	const uint32 DeltaMicroseconds = static_cast<uint32>(FMath::Clamp(DeltaSeconds * 1000000.0, 0.0, static_cast<double>(MAX_uint32)));
+	const uint8 Bucket = GetBucket(DeltaSeconds * 1000.0f);
+
+	const int32 Tail = (Head + NumFrames) % Frames.Num();
+	Frames[Tail] = FFrame{ NowSeconds, DeltaMicroseconds, Bucket };
+	NumFrames++;
+
+	TotalMicroseconds += DeltaMicroseconds;
+	BucketCounts[Bucket]++;
+}
+
+float FFrameTimeWindow::GetAverageFPS(float IdealFPS) const
+{
+	if (NumFrames == 0 || TotalMicroseconds == 0)
+	{
+		return IdealFPS;
+	}
+	return static_cast<float>(NumFrames * 1000000.0 / TotalMicroseconds);
+}
+
+float FFrameTimeWindow::GetFrameTimePercentileMS(float Percentile) const
+{
+	if (NumFrames == 0)
+	{
+		return 0.0f;
+	}
+
+	// Walk down from the slowest bucket, the tail is what we're asked about and it's usually short.
+	const int32 NumAbove = NumFrames - FMath::Clamp(FMath::CeilToInt(Percentile * NumFrames), 1, NumFrames);
+	int32 Seen = 0;
+	for (int32 Bucket = NumBuckets - 1; Bucket > 0; --Bucket)
+	{
+		Seen += BucketCounts[Bucket];
+		if (Seen > NumAbove)
+		{
+			return GetBucketUpperBoundMS(Bucket);
+		}
+	}
+	return GetBucketUpperBoundMS(0);
+}
+
+float FFrameTimeWindow::GetOnePercentLowFPS(float IdealFPS) const
+{
+	const float FrameTimeMS = GetFrameTimePercentileMS(0.99f);
+	return FrameTimeMS > 0.0f ? 1000.0f / FrameTimeMS : IdealFPS;
+}
+
+void FFrameTimeWindow::RemoveOldest()
+{
+	const FFrame& Oldest = Frames[Head];
+	TotalMicroseconds -= Oldest.DeltaMicroseconds;
+	BucketCounts[Oldest.Bucket]--;
+	Head = (Head + 1) % Frames.Num();
+	NumFrames--;
+}
+
+uint8 FFrameTimeWindow::GetBucket(float FrameTimeMS)
+{
+	// Bucket 0 is everything up to MinBucketMS, bucket N up to MinBucketMS * BucketGrowth^N, the last is unbounded.
+	if (FrameTimeMS <= MinBucketMS)
+	{
+		return 0;
+	}
+	return static_cast<uint8>(FMath::Clamp(FMath::CeilToInt(FMath::Loge(FrameTimeMS / MinBucketMS) / LogBucketGrowth), 1, NumBuckets - 1));
+}
+
+float FFrameTimeWindow::GetBucketUpperBoundMS(int32 Bucket)
+{
+	return MinBucketMS * FMath::Exp(Bucket * LogBucketGrowth);
+}
@@ -0,0 +1,135 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "LatencySketch.h"
+
+namespace
+{
+	const float Gamma = (1.0f + FLatencySketch::RelativeAccuracy) / (1.0f - FLatencySketch::RelativeAccuracy);
+	const float LogGamma = FMath::Loge(Gamma);
+}
+
+void FLatencySketch::Add(float Value)
+{
+	Count++;
+	Sum += Value;
+	MaxValue = FMath::Max(MaxValue, Value);
+
+	if (Value <= MinTrackedValue)
+	{
+		ZeroCount++;
+		return;
+	}
+
+	AddToBin(GetBinIndex(Value), 1);
+	CollapseLowestBins();
+}
+
+void FLatencySketch::Merge(const FLatencySketch& Other)
+{
+	if (Other.Count == 0)
+	{
+		return;
+	}
+
+	Count += Other.Count;
+	Sum += Other.Sum;
+	MaxValue = FMath::Max(MaxValue, Other.MaxValue);
+	ZeroCount += Other.ZeroCount;
+
+	for (int32 Offset = 0; Offset < Other.Bins.Num(); ++Offset)
+	{
+		if (Other.Bins[Offset] != 0)
+		{
+			AddToBin(Other.MinIndex + Offset, Other.Bins[Offset]);
+		}
+	}
+	CollapseLowestBins();
+}
+
+void FLatencySketch::Reset()
+{
+	Bins.Reset();
+	MinIndex = 0;
+	ZeroCount = 0;
+	Count = 0;
+	Sum = 0.0f;
+	MaxValue = 0.0f;
+}
+
+float FLatencySketch::GetQuantile(float Quantile) const
+{
+	if (Count == 0)
+	{
+		return 0.0f;
+	}
+
+	const int32 Rank = FMath::Clamp(FMath::CeilToInt(Quantile * Count) - 1, 0, Count - 1);
+	int32 Seen = ZeroCount;
+	if (Rank < Seen)
+	{
+		return 0.0f;
+	}
+
+	for (int32 Offset = 0; Offset < Bins.Num(); ++Offset)
+	{
+		Seen += Bins[Offset];
+		if (Rank < Seen)
+		{
+			// The bin's midpoint can overshoot the largest value we actually saw.
+			return FMath::Min(GetBinValue(MinIndex + Offset), MaxValue);
+		}
+	}
+
+	return MaxValue;
+}
+
+void FLatencySketch::AddToBin(int32 Index, int32 BinCount)
+{
+	if (Bins.Num() == 0)
+	{
+		MinIndex = Index;
+		Bins.Add(BinCount);
+		return;
+	}
+
+	if (Index < MinIndex)
+	{
+		Bins.InsertZeroed(0, MinIndex - Index);
+		MinIndex = Index;
+	}
+	else if (Index >= MinIndex + Bins.Num())
+	{
+		Bins.AddZeroed(Index - MinIndex - Bins.Num() + 1);
+	}
+
+	Bins[Index - MinIndex] += BinCount;
+}
+
+void FLatencySketch::CollapseLowestBins()
+{
+	const int32 Excess = Bins.Num() - MaxBins;
+	if (Excess <= 0)
+	{
+		return;
+	}
+
+	int32 Collapsed = 0;
+	for (int32 Offset = 0; Offset <= Excess; ++Offset)
+	{
+		Collapsed += Bins[Offset];
+	}
+	Bins.RemoveAt(0, Excess, false);
+	Bins[0] = Collapsed;
+	MinIndex += Excess;
+}
+
+int32 FLatencySketch::GetBinIndex(float Value)
+{
+	return FMath::CeilToInt(FMath::Loge(Value) / LogGamma);
+}
+
+float FLatencySketch::GetBinValue(int32 Index)
+{
+	// Bin i covers (Gamma^(i-1), Gamma^i], this is the point with the same relative error to both ends.
+	return 2.0f * FMath::Exp(Index * LogGamma) / (Gamma + 1.0f);
+}
@@ -0,0 +1,152 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "MemorySampler.h"
+
+#include "HAL/LowLevelMemTracker.h"
+#include "HAL/PlatformMemory.h"
+#include "UObject/UObjectArray.h"
+
+DEFINE_LOG_CATEGORY(LogMemorySampler);
+
+namespace
+{
+	const FString MemoryMetricName = TEXT("unreal_memory_mb");
+	const FString UObjectCountMetricName = TEXT("unreal_uobject_count");
+	const FString MemoryGrowthMetricName = TEXT("unreal_memory_growth_mb_per_hour");
+	const FPrometheusLabel EnginePlatformLabel(TEXT("engine_platform"), TEXT("UnrealWorker"));
+
+	const double BytesPerMB = 1024.0 * 1024.0;
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	// The tags a leak in a gym is likely to show up under, the rest are left to a full memreport.
+	const ELLMTag SampledTags[] =
+	{
+		ELLMTag::TrackedTotal,
+		ELLMTag::Untracked,
+		ELLMTag::UObject,
+		ELLMTag::Networking,
+		ELLMTag::Meshes,
+		ELLMTag::Animation,
+		ELLMTag::Physics,
+		ELLMTag::NavigationRecast,
+		ELLMTag::AsyncLoading,
+		ELLMTag::FName,
+		ELLMTag::GC,
+		ELLMTag::Stats,
+		ELLMTag::EngineMisc,
+	};
+#endif
+}
+
+FMemorySampler::FMemorySampler(double InGrowthWindowSeconds)
+	: GrowthWindowSeconds(InGrowthWindowSeconds)
+{
+}
+
+bool FMemorySampler::IsUsingLLM()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	return FLowLevelMemTracker::Get().IsEnabled();
+#else
+	return false;
+#endif
+}
+
+void FMemorySampler::Sample(double NowSeconds)
+{
+	double TotalMB = 0.0;
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	if (IsUsingLLM())
+	{
+		FLowLevelMemTracker& Tracker = FLowLevelMemTracker::Get();
+		for (ELLMTag Tag : SampledTags)
+		{
+			Publish(LLMGetTagName(Tag), Tracker.GetTagAmountForTracker(ELLMTracker::Default, Tag) / BytesPerMB);
+		}
+		TotalMB = Tracker.GetTagAmountForTracker(ELLMTracker::Default, ELLMTag::TrackedTotal) / BytesPerMB;
+	}
+	else
+#endif
+	{
+		const FPlatformMemoryStats Stats = FPlatformMemory::GetStats();
+		Publish(TEXT("UsedPhysical"), Stats.UsedPhysical / BytesPerMB);
+		Publish(TEXT("PeakUsedPhysical"), Stats.PeakUsedPhysical / BytesPerMB);
+		Publish(TEXT("UsedVirtual"), Stats.UsedVirtual / BytesPerMB);
+		Publish(TEXT("AvailablePhysical"), Stats.AvailablePhysical / BytesPerMB);
+		TotalMB = Stats.UsedPhysical / BytesPerMB;
+	}
+
+	if (!UObjectCountMetric.IsValid())
+	{
+		UObjectCountMetric = UMetricsBlueprintLibrary::RegisterMetric(UObjectCountMetricName, { EnginePlatformLabel });
+	}
+	UObjectCountMetric.Set(GUObjectArray.GetObjectArrayNumMinusAvailable());
+
+	LastTotalMB = TotalMB;
+	TotalHistory.Emplace(NowSeconds, TotalMB);
+	int32 NumExpired = 0;
+	while (NumExpired < TotalHistory.Num() && TotalHistory[NumExpired].Key < NowSeconds - GrowthWindowSeconds)
+	{
+		NumExpired++;
+	}
+	TotalHistory.RemoveAt(0, NumExpired, false);
+
+	if (!GrowthRateMetric.IsValid())
+	{
+		GrowthRateMetric = UMetricsBlueprintLibrary::RegisterMetric(MemoryGrowthMetricName, { EnginePlatformLabel });
+	}
+	GrowthRateMetric.Set(GetGrowthRateMBPerHour());
+}
+
+double FMemorySampler::GetGrowthRateMBPerHour() const
+{
+	const int32 NumSamples = TotalHistory.Num();
+	if (NumSamples < 2)
+	{
+		return 0.0;
+	}
+
+	// Least squares fit, so one GC or level stream at either end of the window doesn't swing the rate. Times are taken relative
+	// to the first sample to keep the sums well conditioned.
+	const double StartTime = TotalHistory[0].Key;
+	double SumT = 0.0;
+	double SumMB = 0.0;
+	for (const TPair<double, double>& Sample : TotalHistory)
+	{
+		SumT += Sample.Key - StartTime;
+		SumMB += Sample.Value;
+	}
+	const double MeanT = SumT / NumSamples;
+	const double MeanMB = SumMB / NumSamples;
+
+	double Covariance = 0.0;
+	double Variance = 0.0;
+	for (const TPair<double, double>& Sample : TotalHistory)
+	{
+		const double T = Sample.Key - StartTime - MeanT;
+		Covariance += T * (Sample.Value - MeanMB);
+		Variance += T * T;
+	}
+	return Variance > 0.0 ? Covariance / Variance * 3600.0 : 0.0;
+}
+
+double FMemorySampler::GetGrowthHistorySeconds() const
+{
+	return TotalHistory.Num() >= 2 ? TotalHistory.Last().Key - TotalHistory[0].Key : 0.0;
+}
+
+void FMemorySampler::Publish(const TCHAR* Tag, double ValueMB)
+{
+	FPrometheusMetricHandle* Handle = TagMetrics.Find(Tag);
+	if (Handle == nullptr || !Handle->IsValid())
+	{
+		const FPrometheusMetricHandle NewHandle = UMetricsBlueprintLibrary::RegisterMetric(MemoryMetricName, { EnginePlatformLabel, FPrometheusLabel(TEXT("tag"), Tag) });
+		if (!NewHandle.IsValid())
+		{
+			return;
+		}
+		Handle = &TagMetrics.Add(Tag, NewHandle);
+	}
+	Handle->Set(ValueMB);
+}
@@ -17,7 +17,7 @@ bool FMetricTimer::SetTimer(int32 Seconds)
 {
 	if (!bLocked)
 	{
-		TimeToStart = FDateTime::Now().GetTicks() + FTimespan::FromSeconds(Seconds).GetTicks();
+		TimeToStart = static_cast<int64>(FPlatformTime::Cycles64()) + static_cast<int64>(Seconds / FPlatformTime::GetSecondsPerCycle64());
 	}
 	return !bLocked;
 }
@@ -29,13 +29,12 @@ void FMetricTimer::SetLock(bool bState)
 
 bool FMetricTimer::HasTimerGoneOff() const
 {
-	return FDateTime::Now().GetTicks() > TimeToStart;
+	return static_cast<int64>(FPlatformTime::Cycles64()) > TimeToStart;
 }
 
 int32 FMetricTimer::GetSecondsRemaining() const
 {
-	FTimespan Timespan = FTimespan(TimeToStart - FDateTime::Now().GetTicks());
-	int32 SecondsRemaining = Timespan.GetTotalSeconds();
+	int32 SecondsRemaining = static_cast<int32>((TimeToStart - static_cast<int64>(FPlatformTime::Cycles64())) * FPlatformTime::GetSecondsPerCycle64());
 	SecondsRemaining = SecondsRemaining < 0 ? 0 : SecondsRemaining;
 	return SecondsRemaining;
 }
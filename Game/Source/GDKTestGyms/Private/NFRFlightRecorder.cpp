@@ -0,0 +1,349 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "NFRFlightRecorder.h"
+
+#include "Async/Async.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+
+#if STATS
+#include "Stats/StatsData.h"
+#endif
+
+DEFINE_LOG_CATEGORY(LogNFRFlightRecorder);
+
+namespace
+{
+	const int32 DefaultMaxEvents = 1 << 16;
+	const int32 MinMaxEvents = 1024;
+	const double HitchArmDelaySeconds = 60.0;
+
+	const TCHAR* const WorldScopeNames[] = { TEXT("WorldTick"), TEXT("NetReceive"), TEXT("ActorTick"), TEXT("NetFlush") };
+}
+
+FNFRFlightRecorder& FNFRFlightRecorder::Get()
+{
+	static FNFRFlightRecorder Recorder;
+	return Recorder;
+}
+
+FNFRFlightRecorder::FNFRFlightRecorder()
+{
+	bEnabled = !FParse::Param(FCommandLine::Get(), TEXT("NoNFRFlightRecorder"));
+	if (!bEnabled)
+	{
+		return;
+	}
+
+	FParse::Value(FCommandLine::Get(), TEXT("NFRFlightRecorderSeconds="), WindowSeconds);
+	FParse::Value(FCommandLine::Get(), TEXT("NFRFlightRecorderHitchMS="), HitchThresholdMS);
+
+	int32 MaxEvents = DefaultMaxEvents;
+	FParse::Value(FCommandLine::Get(), TEXT("NFRFlightRecorderEvents="), MaxEvents);
+	Events.SetNumUninitialized(FMath::Max(MaxEvents, MinMaxEvents));
+
+	HitchArmTime = FPlatformTime::Seconds() + HitchArmDelaySeconds;
+
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddRaw(this, &FNFRFlightRecorder::OnPreGarbageCollect);
+	FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &FNFRFlightRecorder::OnPostGarbageCollect);
+
+#if STATS
+	FString StatSubstringList = TEXT("RPC,Replicat");
+	FParse::Value(FCommandLine::Get(), TEXT("NFRFlightRecorderStats="), StatSubstringList, false);
+	StatSubstringList.ParseIntoArray(StatSubstrings, TEXT(","));
+#endif
+
+	UE_LOG(LogNFRFlightRecorder, Log, TEXT("Flight recorder keeping the last %.1fs (up to %d events), dumping on frames over %.1fms"), WindowSeconds, Events.Num(), HitchThresholdMS);
+}
+
+void FNFRFlightRecorder::BeginScope(const TCHAR* Name)
+{
+	Record(EEventType::ScopeBegin, Name, 0.0);
+}
+
+void FNFRFlightRecorder::EndScope(const TCHAR* Name)
+{
+	Record(EEventType::ScopeEnd, Name, 0.0);
+}
+
+void FNFRFlightRecorder::RecordCounter(const TCHAR* Name, double Value)
+{
+	Record(EEventType::Counter, Name, Value);
+}
+
+void FNFRFlightRecorder::EndFrame(float DeltaSeconds, const UNetDriver* NetDriver)
+{
+	if (!bEnabled)
+	{
+		return;
+	}
+
+	Record(EEventType::Frame, TEXT("Frame"), DeltaSeconds);
+
+	const double Now = FPlatformTime::Seconds();
+	if (NetDriver != nullptr && Now - LastNetCounterTime >= 1.0)
+	{
+		LastNetCounterTime = Now;
+		RecordCounter(TEXT("NetInBytesPerSecond"), NetDriver->InBytesPerSecond);
+		RecordCounter(TEXT("NetOutBytesPerSecond"), NetDriver->OutBytesPerSecond);
+		RecordCounter(TEXT("NetInPackets"), NetDriver->InTotalPackets);
+		RecordCounter(TEXT("NetOutPackets"), NetDriver->OutTotalPackets);
+#if STATS
+		RecordStatCounters();
+#endif
+	}
+
+	const float FrameTimeMS = DeltaSeconds * 1000.0f;
+	if (FrameTimeMS > HitchThresholdMS && Now >= HitchArmTime)
+	{
+		Dump(FString::Printf(TEXT("Hitch of %.1fms"), FrameTimeMS));
+	}
+}
+
+void FNFRFlightRecorder::Bind(UWorld* World)
+{
+	if (!bEnabled || World == nullptr || BoundWorld.Get() == World)
+	{
+		return;
+	}
+	Unbind();
+
+	BoundWorld = World;
+	TickStartHandle = FWorldDelegates::OnWorldTickStart.AddRaw(this, &FNFRFlightRecorder::OnWorldTickStart);
+	PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddRaw(this, &FNFRFlightRecorder::OnPreActorTick);
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddRaw(this, &FNFRFlightRecorder::OnPostActorTick);
+	PostTickDispatchHandle = World->PostTickDispatchEvent.AddRaw(this, &FNFRFlightRecorder::OnPostTickDispatch);
+	PostTickFlushHandle = World->PostTickFlushEvent.AddRaw(this, &FNFRFlightRecorder::OnPostTickFlush);
+}
+
+void FNFRFlightRecorder::Unbind()
+{
+	FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+	FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	if (UWorld* World = BoundWorld.Get())
+	{
+		World->PostTickDispatchEvent.Remove(PostTickDispatchHandle);
+		World->PostTickFlushEvent.Remove(PostTickFlushHandle);
+	}
+	BoundWorld.Reset();
+	CloseWorldScopes(WorldTick);
+}
+
+void FNFRFlightRecorder::Dump(const FString& Reason, bool bForce)
+{
+	if (!bEnabled || NumDumps >= MaxDumps)
+	{
+		return;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	if (!bForce && LastDumpTime >= 0.0 && Now - LastDumpTime < MinSecondsBetweenDumps)
+	{
+		return;
+	}
+	LastDumpTime = Now;
+	NumDumps++;
+
+	const uint64 NowCycles = FPlatformTime::Cycles64();
+	const uint64 WindowCycles = static_cast<uint64>(WindowSeconds / FPlatformTime::GetSecondsPerCycle64());
+	const uint64 StartCycles = NowCycles > WindowCycles ? NowCycles - WindowCycles : 0;
+
+	// Copy out oldest first, the ring keeps recording while the copy is written.
+	TArray<FRecordedEvent> Window;
+	Window.Reserve(bWrapped ? Events.Num() : NextEvent);
+	auto CopyRange = [this, &Window, StartCycles](int32 From, int32 To)
+	{
+		for (int32 Index = From; Index < To; ++Index)
+		{
+			if (Events[Index].Cycles >= StartCycles)
+			{
+				Window.Add(Events[Index]);
+			}
+		}
+	};
+	if (bWrapped)
+	{
+		CopyRange(NextEvent, Events.Num());
+	}
+	CopyRange(0, NextEvent);
+
+	const FString Path = FPaths::ProfilingDir() / TEXT("FlightRecorder") / FString::Printf(TEXT("NFR_%s_%u_%d.json"),
+		*FDateTime::Now().ToString(TEXT("%Y%m%d-%H%M%S")), FPlatformProcess::GetCurrentProcessId(), NumDumps);
+	UE_LOG(LogNFRFlightRecorder, Log, TEXT("Writing flight recorder capture (%s) to %s"), *Reason, *Path);
+
+	Async(EAsyncExecution::ThreadPool, [Path, Reason, TraceEvents = MoveTemp(Window), StartCycles]() mutable
+	{
+		WriteTrace(Path, Reason, MoveTemp(TraceEvents), StartCycles);
+	});
+}
+
+void FNFRFlightRecorder::Record(EEventType Type, const TCHAR* Name, double Value)
+{
+	if (!bEnabled || !IsInGameThread())
+	{
+		return;
+	}
+
+	Events[NextEvent] = FRecordedEvent{ FPlatformTime::Cycles64(), Name, Value, Type };
+	if (++NextEvent == Events.Num())
+	{
+		NextEvent = 0;
+		bWrapped = true;
+	}
+}
+
+void FNFRFlightRecorder::OnPreGarbageCollect()
+{
+	BeginScope(TEXT("GarbageCollect"));
+}
+
+void FNFRFlightRecorder::OnPostGarbageCollect()
+{
+	EndScope(TEXT("GarbageCollect"));
+}
+
+// The net driver's TickDispatch runs straight after the tick starts, and its TickFlush (which calls ServerReplicateActors)
+// is the last thing before PostTickFlush, so these bracket them without needing hooks inside the net driver.
+void FNFRFlightRecorder::OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == BoundWorld.Get())
+	{
+		CloseWorldScopes(WorldTick);
+		OpenWorldScope(WorldTick);
+		OpenWorldScope(NetReceive);
+	}
+}
+
+void FNFRFlightRecorder::OnPostTickDispatch()
+{
+	CloseWorldScopes(NetReceive);
+}
+
+void FNFRFlightRecorder::OnPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == BoundWorld.Get())
+	{
+		CloseWorldScopes(NetReceive);
+		OpenWorldScope(ActorTick);
+	}
+}
+
+void FNFRFlightRecorder::OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == BoundWorld.Get())
+	{
+		CloseWorldScopes(NetReceive);
+		OpenWorldScope(NetFlush);
+	}
+}
+
+void FNFRFlightRecorder::OnPostTickFlush()
+{
+	CloseWorldScopes(WorldTick);
+}
+
+void FNFRFlightRecorder::OpenWorldScope(EWorldScope Scope)
+{
+	if (!bWorldScopeOpen[Scope])
+	{
+		bWorldScopeOpen[Scope] = true;
+		BeginScope(WorldScopeNames[Scope]);
+	}
+}
+
+void FNFRFlightRecorder::CloseWorldScopes(EWorldScope Outermost)
+{
+	for (int32 Scope = NumWorldScopes - 1; Scope >= Outermost; --Scope)
+	{
+		if (bWorldScopeOpen[Scope])
+		{
+			bWorldScopeOpen[Scope] = false;
+			EndScope(WorldScopeNames[Scope]);
+		}
+	}
+}
+
+#if STATS
+void FNFRFlightRecorder::RecordStatCounters()
+{
+	const FGameThreadStatsData* ViewData = FLatestGameThreadStatsData::Get().Latest;
+	if (ViewData == nullptr)
+	{
+		return;
+	}
+
+	for (const auto& Pair : ViewData->NameToStatMap)
+	{
+		if (!Pair.Value)
+		{
+			continue;
+		}
+
+		const FString* CounterName = StatCounterNames.Find(Pair.Key);
+		if (CounterName == nullptr)
+		{
+			const FString StatName = Pair.Key.ToString();
+			const bool bRecorded = StatSubstrings.ContainsByPredicate([&StatName](const FString& Substring) {
+				return StatName.Contains(Substring);
+			});
+			CounterName = &StatCounterNames.Add(Pair.Key, bRecorded ? StatName : FString());
+		}
+
+		if (!CounterName->IsEmpty())
+		{
+			RecordCounter(**CounterName, Pair.Value->GetValue_CallCount(EComplexStatField::IncAve));
+		}
+	}
+}
+#endif
+
+void FNFRFlightRecorder::WriteTrace(const FString& Path, const FString& Reason, TArray<FRecordedEvent> TraceEvents, uint64 StartCycles)
+{
+	const double MicrosecondsPerCycle = FPlatformTime::GetSecondsPerCycle64() * 1000000.0;
+	auto ToMicroseconds = [StartCycles, MicrosecondsPerCycle](uint64 Cycles)
+	{
+		return Cycles > StartCycles ? (Cycles - StartCycles) * MicrosecondsPerCycle : 0.0;
+	};
+
+	FString Json;
+	Json.Reserve(TraceEvents.Num() * 64);
+	Json += TEXT("{\"traceEvents\":[\n");
+	for (const FRecordedEvent& Event : TraceEvents)
+	{
+		const double Timestamp = ToMicroseconds(Event.Cycles);
+		switch (Event.Type)
+		{
+		case EEventType::Frame:
+		{
+			// Recorded at the end of the frame, the value is its length.
+			const double Duration = Event.Value * 1000000.0;
+			Json += FString::Printf(TEXT("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.1f,\"dur\":%.1f,\"pid\":0,\"tid\":1},\n"), Event.Name, FMath::Max(0.0, Timestamp - Duration), Duration);
+			break;
+		}
+		case EEventType::ScopeBegin:
+			Json += FString::Printf(TEXT("{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%.1f,\"pid\":0,\"tid\":0},\n"), Event.Name, Timestamp);
+			break;
+		case EEventType::ScopeEnd:
+			Json += FString::Printf(TEXT("{\"name\":\"%s\",\"ph\":\"E\",\"ts\":%.1f,\"pid\":0,\"tid\":0},\n"), Event.Name, Timestamp);
+			break;
+		case EEventType::Counter:
+			Json += FString::Printf(TEXT("{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.1f,\"pid\":0,\"args\":{\"value\":%f}},\n"), Event.Name, Timestamp, Event.Value);
+			break;
+		}
+	}
+	Json += FString::Printf(TEXT("{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.1f,\"pid\":0,\"tid\":0}\n"), *Reason.ReplaceCharWithEscapedChar(), TraceEvents.Num() > 0 ? ToMicroseconds(TraceEvents.Last().Cycles) : 0.0);
+	Json += TEXT("]}\n");
+
+	if (!FFileHelper::SaveStringToFile(Json, *Path))
+	{
+		UE_LOG(LogNFRFlightRecorder, Warning, TEXT("Failed to write flight recorder capture to %s"), *Path);
+	}
+}
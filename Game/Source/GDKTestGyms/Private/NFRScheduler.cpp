@@ -0,0 +1,178 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "NFRScheduler.h"
+
+#include "HAL/PlatformTime.h"
+
+FNFRScheduler::FNFRScheduler()
+	: StartCycles(FPlatformTime::Cycles64())
+	, CyclesPerTick(FMath::Max<uint64>(1, static_cast<uint64>(ResolutionSeconds / FPlatformTime::GetSecondsPerCycle64())))
+{
+	NextTickCycles = StartCycles + CyclesPerTick;
+}
+
+FNFRTimerHandle FNFRScheduler::Schedule(float DelaySeconds, TFunction<void()> Callback)
+{
+	return Add(SecondsToTicks(DelaySeconds), 0, MoveTemp(Callback));
+}
+
+FNFRTimerHandle FNFRScheduler::ScheduleRepeating(float FirstDelaySeconds, float PeriodSeconds, TFunction<void()> Callback)
+{
+	return Add(SecondsToTicks(FirstDelaySeconds), FMath::Max<uint64>(1, SecondsToTicks(PeriodSeconds)), MoveTemp(Callback));
+}
+
+void FNFRScheduler::Cancel(FNFRTimerHandle& Handle)
+{
+	if (IsScheduled(Handle))
+	{
+		Timers.RemoveAt(Handle.Index);
+	}
+	Handle = FNFRTimerHandle();
+}
+
+bool FNFRScheduler::IsScheduled(const FNFRTimerHandle& Handle) const
+{
+	return Handle.IsValid() && IsCurrent(FSlotEntry{ Handle.Index, Handle.Serial });
+}
+
+void FNFRScheduler::Tick()
+{
+	const uint64 NowCycles = FPlatformTime::Cycles64();
+	if (NowCycles < NextTickCycles)
+	{
+		return;
+	}
+
+	AdvanceTo((NowCycles - StartCycles) / CyclesPerTick);
+	NextTickCycles = StartCycles + (CurrentTick + 1) * CyclesPerTick;
+}
+
+void FNFRScheduler::AdvanceTo(uint64 InNowTick)
+{
+	// Catch up on every slot we passed, so nothing in a skipped slot is lost after a hitch.
+	NowTick = InNowTick;
+	while (CurrentTick < NowTick)
+	{
+		++CurrentTick;
+		Cascade();
+		RunDueSlot();
+	}
+}
+
+FNFRTimerHandle FNFRScheduler::Add(uint64 Delay, uint64 Period, TFunction<void()> Callback)
+{
+	FNFRTimerHandle Handle;
+	Handle.Serial = NextSerial++;
+	Handle.Index = Timers.Add(FTimer{ NowTick + FMath::Max<uint64>(1, Delay), Period, Handle.Serial, MoveTemp(Callback) });
+	Insert(Handle.Index);
+	return Handle;
+}
+
+void FNFRScheduler::Insert(int32 Index)
+{
+	FTimer& Timer = Timers[Index];
+	const uint64 Expiry = FMath::Max(Timer.Expiry, CurrentTick + 1);
+	const uint64 Delta = Expiry - CurrentTick;
+
+	// Level N holds timers due within NumSlots^(N+1) ticks, in the slot for their expiry at that level's granularity.
+	// Anything beyond the top level is parked there and re-inserted when its slot cascades.
+	int32 Level = 0;
+	while (Level < NumLevels - 1 && Delta >= (1ull << (SlotBits * (Level + 1))))
+	{
+		++Level;
+	}
+	const int32 Slot = static_cast<int32>((Expiry >> (SlotBits * Level)) & SlotMask);
+	Slots[Level][Slot].Add(FSlotEntry{ Index, Timer.Serial });
+}
+
+void FNFRScheduler::Cascade()
+{
+	// Each time the levels below wrap, spread the next slot of this level over the levels below.
+	for (int32 Level = 1; Level < NumLevels; ++Level)
+	{
+		if ((CurrentTick & ((1ull << (SlotBits * Level)) - 1)) != 0)
+		{
+			break;
+		}
+
+		const int32 Slot = static_cast<int32>((CurrentTick >> (SlotBits * Level)) & SlotMask);
+		TArray<FSlotEntry> Entries = MoveTemp(Slots[Level][Slot]);
+		Slots[Level][Slot].Reset();
+		for (const FSlotEntry& Entry : Entries)
+		{
+			if (!IsCurrent(Entry))
+			{
+				continue;
+			}
+
+			if (Timers[Entry.Index].Expiry <= CurrentTick)
+			{
+				// Due exactly on the boundary. RunDueSlot() runs right after us, so it goes out with this tick rather than the next.
+				Slots[0][CurrentTick & SlotMask].Add(Entry);
+			}
+			else
+			{
+				Insert(Entry.Index);
+			}
+		}
+	}
+}
+
+void FNFRScheduler::RunDueSlot()
+{
+	const int32 Slot = static_cast<int32>(CurrentTick & SlotMask);
+	if (Slots[0][Slot].Num() == 0)
+	{
+		return;
+	}
+
+	// Callbacks may schedule into this slot, those go in a fresh list and run next lap.
+	TArray<FSlotEntry> Entries = MoveTemp(Slots[0][Slot]);
+	Slots[0][Slot].Reset();
+	for (const FSlotEntry& Entry : Entries)
+	{
+		if (!IsCurrent(Entry))
+		{
+			continue;
+		}
+
+		if (Timers[Entry.Index].Expiry > CurrentTick)
+		{
+			Insert(Entry.Index);
+			continue;
+		}
+
+		// The callback can add timers, which may reallocate Timers, so it's run from a local.
+		TFunction<void()> Callback = MoveTemp(Timers[Entry.Index].Callback);
+		Callback();
+
+		// It may also have cancelled this timer.
+		if (!IsCurrent(Entry))
+		{
+			continue;
+		}
+
+		FTimer& Timer = Timers[Entry.Index];
+		if (Timer.Period == 0)
+		{
+			Timers.RemoveAt(Entry.Index);
+			continue;
+		}
+
+		// From the real tick rather than the one being caught up, so after a hitch the next run is a period from now instead of
+		// once for every period that was missed.
+		Timer.Callback = MoveTemp(Callback);
+		Timer.Expiry = NowTick + Timer.Period;
+		Insert(Entry.Index);
+	}
+}
+
+bool FNFRScheduler::IsCurrent(const FSlotEntry& Entry) const
+{
+	return Timers.IsValidIndex(Entry.Index) && Timers[Entry.Index].Serial == Entry.Serial;
+}
+
+uint64 FNFRScheduler::SecondsToTicks(float Seconds) const
+{
+	return Seconds > 0.0f ? static_cast<uint64>(FMath::CeilToDouble(Seconds / ResolutionSeconds)) : 0;
+}
@@ -21,6 +21,8 @@
 #include "Engine/LevelScriptActor.h"
 
 #include "BenchmarkNPCCharacter.h"
+#include "GDKTestGymsGameInstance.h"
+#include "NFRFlightRecorder.h"
 
 DEFINE_LOG_CATEGORY(LogTestGymsReplicationGraph);
 
@@ -103,6 +105,21 @@ void UTestGymsReplicationGraph::ResetGameWorldState()
 	}
 }
 
+int32 UTestGymsReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+	NFR_FLIGHT_SCOPE("ServerReplicateActors");
+
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 Result = Super::ServerReplicateActors(DeltaSeconds);
+
+	if (UGDKTestGymsGameInstance* GameInstance = GetWorld() != nullptr ? GetWorld()->GetGameInstance<UGDKTestGymsGameInstance>() : nullptr)
+	{
+		GameInstance->GetFrameBreakdown().AddReplicationGraphTime(FPlatformTime::Seconds() - StartTime);
+	}
+
+	return Result;
+}
+
 void UTestGymsReplicationGraph::InitGlobalActorClassSettings()
 {
 	Super::InitGlobalActorClassSettings();
@@ -0,0 +1,70 @@
+#include "CapacitySearch.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// Passes every load up to TrueCapacity, returns how many loads were tried.
+	int32 RunSearch(FCapacitySearch& Search, int32 TrueCapacity)
+	{
+		int32 NumTried = 0;
+		while (!Search.IsFinished() && NumTried < 1000)
+		{
+			Search.ReportResult(Search.GetCurrentLoad() <= TrueCapacity);
+			NumTried++;
+		}
+		return NumTried;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCapacitySearchTest, "GDKTestGyms.NFR.CapacitySearch",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FCapacitySearchTest::RunTest(const FString& Parameters)
+{
+	// Lands within Resolution below the true capacity wherever it is in the range.
+	for (const int32 TrueCapacity : { 10, 11, 37, 100, 640, 1000, 4095, 9990 })
+	{
+		FCapacitySearch Search(10, 10000, 10);
+		TestEqual(TEXT("Starts at MinLoad"), Search.GetCurrentLoad(), 10);
+
+		const int32 NumTried = RunSearch(Search, TrueCapacity);
+		const int32 Capacity = Search.GetCapacity();
+		TestTrue(*FString::Printf(TEXT("Search for %d finishes"), TrueCapacity), Search.IsFinished());
+		TestTrue(*FString::Printf(TEXT("Capacity %d is within resolution of %d"), Capacity, TrueCapacity),
+			Capacity <= TrueCapacity && Capacity > TrueCapacity - 10);
+		TestTrue(*FString::Printf(TEXT("Search for %d takes %d loads, a ramp then a bisection"), TrueCapacity, NumTried), NumTried <= 2 * 10 + 1);
+	}
+
+	// A build that passes everything stops at MaxLoad.
+	{
+		FCapacitySearch Search(10, 1000, 10);
+		RunSearch(Search, MAX_int32);
+		TestEqual(TEXT("Capacity is MaxLoad"), Search.GetCapacity(), 1000);
+	}
+
+	// A build that fails MinLoad has no capacity.
+	{
+		FCapacitySearch Search(10, 1000, 10);
+		TestEqual(TEXT("Only MinLoad is tried"), RunSearch(Search, 5), 1);
+		TestEqual(TEXT("No capacity"), Search.GetCapacity(), static_cast<int32>(INDEX_NONE));
+	}
+
+	// Ramping from zero still moves, and results after the search has finished are ignored.
+	{
+		FCapacitySearch Search(0, 100, 5);
+		RunSearch(Search, 42);
+		TestTrue(TEXT("Capacity from zero"), Search.GetCapacity() <= 42 && Search.GetCapacity() > 42 - 5);
+
+		const int32 Capacity = Search.GetCapacity();
+		Search.ReportResult(true);
+		Search.ReportResult(false);
+		TestEqual(TEXT("Late results don't change the capacity"), Search.GetCapacity(), Capacity);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
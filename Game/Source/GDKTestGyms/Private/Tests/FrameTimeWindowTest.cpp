@@ -0,0 +1,85 @@
+#include "FrameTimeWindow.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// Percentiles come back as the upper bound of a bucket, so at or just above the true frame time.
+	bool IsInBucketOf(float EstimateMS, float ExactMS)
+	{
+		return EstimateMS >= ExactMS * 0.999f && EstimateMS <= ExactMS * FFrameTimeWindow::BucketGrowth * 1.001f;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFrameTimeWindowTest, "GDKTestGyms.NFR.FrameTimeWindow",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FFrameTimeWindowTest::RunTest(const FString& Parameters)
+{
+	// Nothing to go on yet.
+	{
+		const FFrameTimeWindow Window(1.0, 100);
+		TestEqual(TEXT("Empty window reports the ideal FPS"), Window.GetAverageFPS(30.0f), 30.0f);
+		TestEqual(TEXT("Empty window has no percentile"), Window.GetFrameTimePercentileMS(0.99f), 0.0f);
+		TestEqual(TEXT("Empty window reports the ideal 1% low"), Window.GetOnePercentLowFPS(30.0f), 30.0f);
+	}
+
+	// Frames leave once they're older than the window.
+	{
+		FFrameTimeWindow Window(1.0, 1000);
+		for (int32 i = 0; i < 60; ++i)
+		{
+			Window.AddFrame(i / 60.0, 1.0f / 60.0f);
+		}
+		TestEqual(TEXT("Every frame is in the window"), Window.GetNumFrames(), 60);
+		TestEqual(TEXT("Average FPS"), Window.GetAverageFPS(), 60.0f, 0.1f);
+
+		Window.AddFrame(1.5, 0.1f);
+		TestEqual(TEXT("Frames older than the window are dropped"), Window.GetNumFrames(), 30);
+		Window.AddFrame(10.0, 0.05f);
+		TestEqual(TEXT("Only the newest frame is left"), Window.GetNumFrames(), 1);
+		TestEqual(TEXT("Average FPS is the newest frame's"), Window.GetAverageFPS(), 20.0f, 0.1f);
+		TestTrue(TEXT("Percentile is the newest frame's"), IsInBucketOf(Window.GetFrameTimePercentileMS(0.5f), 50.0f));
+	}
+
+	// Frames arriving faster than MaxFrames fit in the window drop the oldest early, around the ring more than once.
+	{
+		FFrameTimeWindow Window(100.0, 10);
+		for (int32 i = 0; i < 25; ++i)
+		{
+			Window.AddFrame(i * 0.01, i < 15 ? 0.01f : 0.02f);
+		}
+		TestEqual(TEXT("Window is capped at MaxFrames"), Window.GetNumFrames(), 10);
+		TestEqual(TEXT("Average FPS only counts the frames kept"), Window.GetAverageFPS(), 50.0f, 0.1f);
+		TestTrue(TEXT("Dropped frames leave the histogram"), IsInBucketOf(Window.GetFrameTimePercentileMS(0.01f), 20.0f));
+	}
+
+	// Percentiles and the 1% low from the slow tail.
+	{
+		FFrameTimeWindow Window(10.0, 1000);
+		for (int32 i = 0; i < 200; ++i)
+		{
+			const float DeltaSeconds = i % 100 == 0 ? 0.1f : (i % 50 == 0 ? 0.05f : 0.01f);
+			Window.AddFrame(i * 0.01, DeltaSeconds);
+		}
+
+		TestTrue(TEXT("Median is a typical frame"), IsInBucketOf(Window.GetFrameTimePercentileMS(0.5f), 10.0f));
+		TestTrue(TEXT("p99 is the second slowest pair"), IsInBucketOf(Window.GetFrameTimePercentileMS(0.99f), 50.0f));
+		TestTrue(TEXT("p100 is the slowest frame"), IsInBucketOf(Window.GetFrameTimePercentileMS(1.0f), 100.0f));
+
+		const float OnePercentLow = Window.GetOnePercentLowFPS();
+		TestTrue(TEXT("1% low is the FPS of the p99 frame time"), OnePercentLow <= 20.0f && OnePercentLow >= 20.0f / FFrameTimeWindow::BucketGrowth * 0.999f);
+
+		// Everything from sub millisecond to beyond the last bucket lands somewhere.
+		Window.AddFrame(2.0, 0.0001f);
+		Window.AddFrame(2.0, 1000.0f);
+		TestEqual(TEXT("Tiny frame counts as the fastest bucket"), Window.GetFrameTimePercentileMS(0.0f), FFrameTimeWindow::MinBucketMS, 0.001f);
+		TestTrue(TEXT("Huge frame lands in the last bucket"), Window.GetFrameTimePercentileMS(1.0f) > 1000.0f);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
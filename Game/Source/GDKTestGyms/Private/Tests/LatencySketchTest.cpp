@@ -0,0 +1,109 @@
+#include "LatencySketch.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// Nearest rank over 1, 2, ..., Num, the same ranking GetQuantile uses.
+	float GetExactQuantile(float Quantile, int32 Num)
+	{
+		return static_cast<float>(FMath::Clamp(FMath::CeilToInt(Quantile * Num), 1, Num));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLatencySketchTest, "GDKTestGyms.Metrics.LatencySketch",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FLatencySketchTest::RunTest(const FString& Parameters)
+{
+	const TArray<float> Quantiles = { 0.01f, 0.25f, 0.5f, 0.9f, 0.95f, 0.99f, 1.0f };
+
+	// Quantiles are within RelativeAccuracy of the exact ones, and never above the largest value.
+	{
+		FLatencySketch Sketch;
+		TestEqual(TEXT("Empty sketch has a zero quantile"), Sketch.GetQuantile(0.5f), 0.0f);
+
+		for (int32 Value = 1000; Value >= 1; --Value)
+		{
+			Sketch.Add(static_cast<float>(Value));
+		}
+		TestEqual(TEXT("Every value is counted"), Sketch.GetCount(), 1000);
+		TestEqual(TEXT("Mean is exact"), Sketch.GetMean(), 500.5f, 0.01f);
+
+		for (const float Quantile : Quantiles)
+		{
+			const float Exact = GetExactQuantile(Quantile, 1000);
+			const float Estimate = Sketch.GetQuantile(Quantile);
+			TestTrue(*FString::Printf(TEXT("p%g %g is within the relative accuracy of %g"), Quantile * 100.0f, Estimate, Exact),
+				FMath::Abs(Estimate - Exact) <= Exact * FLatencySketch::RelativeAccuracy * 1.001f);
+		}
+		TestTrue(TEXT("Max doesn't overshoot the largest value"), Sketch.GetQuantile(1.0f) <= 1000.0f);
+	}
+
+	// Values at or below MinTrackedValue rank below everything else.
+	{
+		FLatencySketch Sketch;
+		for (int32 i = 0; i < 10; ++i)
+		{
+			Sketch.Add(0.0f);
+			Sketch.Add(100.0f);
+		}
+		TestEqual(TEXT("Lower half is zero"), Sketch.GetQuantile(0.5f), 0.0f);
+		TestEqual(TEXT("Upper half is the tracked value"), Sketch.GetQuantile(0.51f), 100.0f, 100.0f * FLatencySketch::RelativeAccuracy);
+	}
+
+	// Merging sketches gives the same quantiles as sketching every value in one.
+	{
+		FLatencySketch Low;
+		FLatencySketch High;
+		FLatencySketch All;
+		for (int32 Value = 1; Value <= 1000; ++Value)
+		{
+			(Value % 3 == 0 ? High : Low).Add(static_cast<float>(Value));
+			All.Add(static_cast<float>(Value));
+		}
+		High.Add(0.0f);
+		All.Add(0.0f);
+
+		FLatencySketch Merged;
+		Merged.Merge(Low);
+		Merged.Merge(High);
+		Merged.Merge(FLatencySketch());
+
+		TestEqual(TEXT("Merged count"), Merged.GetCount(), All.GetCount());
+		TestEqual(TEXT("Merged sum"), Merged.GetSum(), All.GetSum(), 1.0f);
+		for (const float Quantile : Quantiles)
+		{
+			TestEqual(*FString::Printf(TEXT("Merged p%g"), Quantile * 100.0f), Merged.GetQuantile(Quantile), All.GetQuantile(Quantile));
+		}
+	}
+
+	// Past MaxBins the lowest bins fold together, which keeps the count and the upper quantiles but not the lowest values.
+	{
+		FLatencySketch Sketch;
+		for (int32 i = 0; i < 90; ++i)
+		{
+			Sketch.Add(1.0e9f);
+		}
+		for (int32 i = 0; i < 10; ++i)
+		{
+			Sketch.Add(0.1f);
+		}
+
+		const float Gamma = (1.0f + FLatencySketch::RelativeAccuracy) / (1.0f - FLatencySketch::RelativeAccuracy);
+		const float LowestBinValue = 1.0e9f / FMath::Pow(Gamma, FLatencySketch::MaxBins - 1);
+		TestTrue(TEXT("The values are further apart than MaxBins can cover"), LowestBinValue > 0.1f * Gamma);
+
+		TestEqual(TEXT("Collapsed values are still counted"), Sketch.GetCount(), 100);
+		const float Low = Sketch.GetQuantile(0.1f);
+		TestTrue(TEXT("Collapsed values rank below the rest"), Low > 0.0f && Low < 1.0e9f);
+		TestTrue(TEXT("Collapsed values move up to the lowest bin kept"), Low <= LowestBinValue * Gamma);
+		TestEqual(TEXT("Upper quantiles are unaffected"), Sketch.GetQuantile(0.11f), 1.0e9f, 1.0e9f * FLatencySketch::RelativeAccuracy);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
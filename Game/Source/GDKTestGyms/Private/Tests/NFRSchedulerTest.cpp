@@ -0,0 +1,98 @@
+#include "NFRScheduler.h"
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FNFRSchedulerTest, "GDKTestGyms.NFR.Scheduler",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FNFRSchedulerTest::RunTest(const FString& Parameters)
+{
+	// Timers cascading down through every level, including ones due exactly as a level wraps and one parked past the top level.
+	{
+		FNFRScheduler Scheduler;
+		Scheduler.AdvanceTo(37);
+
+		const uint64 Level1 = 1ull << FNFRScheduler::SlotBits;
+		const uint64 Level2 = Level1 << FNFRScheduler::SlotBits;
+		const uint64 Level3 = Level2 << FNFRScheduler::SlotBits;
+		const uint64 TopLevelEnd = Level3 << FNFRScheduler::SlotBits;
+		const TArray<uint64> Expiries = { 38, Level1 - 1, Level1, Level1 + 1, Level2 - 1, Level2, Level2 + 1, Level2 * 3 + 17,
+			Level3, Level3 + 1, Level3 * 5 + Level2 * 2 + 3, TopLevelEnd + 37 };
+
+		TArray<uint64> FiredAt;
+		FiredAt.Init(0, Expiries.Num());
+		TArray<int32> Runs;
+		Runs.Init(0, Expiries.Num());
+		for (int32 i = 0; i < Expiries.Num(); ++i)
+		{
+			Scheduler.Add(Expiries[i] - 37, 0, [&Scheduler, &FiredAt, &Runs, i]
+			{
+				FiredAt[i] = Scheduler.CurrentTick;
+				++Runs[i];
+			});
+		}
+
+		Scheduler.AdvanceTo(TopLevelEnd + Level3);
+		for (int32 i = 0; i < Expiries.Num(); ++i)
+		{
+			TestEqual(*FString::Printf(TEXT("Timer due at tick %llu runs once"), Expiries[i]), Runs[i], 1);
+			TestEqual(*FString::Printf(TEXT("Timer due at tick %llu runs on that tick"), Expiries[i]), static_cast<int64>(FiredAt[i]), static_cast<int64>(Expiries[i]));
+		}
+		TestEqual(TEXT("One shot timers are removed once they have run"), Scheduler.Timers.Num(), 0);
+	}
+
+	// A long hitch runs a repeating timer once rather than once per missed period, and every one shot timer in the skipped slots.
+	{
+		FNFRScheduler Scheduler;
+
+		int32 RepeatingRuns = 0;
+		const FNFRTimerHandle Repeating = Scheduler.Add(10, 10, [&RepeatingRuns] { ++RepeatingRuns; });
+		int32 OneShotRuns = 0;
+		Scheduler.Add(100, 0, [&OneShotRuns] { ++OneShotRuns; });
+		Scheduler.Add(200, 0, [&OneShotRuns] { ++OneShotRuns; });
+
+		Scheduler.AdvanceTo(10);
+		TestEqual(TEXT("Repeating timer runs at its first delay"), RepeatingRuns, 1);
+
+		Scheduler.AdvanceTo(500);
+		TestEqual(TEXT("Repeating timer runs once to catch up after a hitch"), RepeatingRuns, 2);
+		TestEqual(TEXT("One shot timers in the skipped slots still run"), OneShotRuns, 2);
+
+		Scheduler.AdvanceTo(509);
+		TestEqual(TEXT("Repeating timer is next due a period after the hitch"), RepeatingRuns, 2);
+		Scheduler.AdvanceTo(510);
+		TestEqual(TEXT("Repeating timer runs a period after the hitch"), RepeatingRuns, 3);
+		TestTrue(TEXT("Repeating timer stays scheduled"), Scheduler.IsScheduled(Repeating));
+	}
+
+	// Cancelling from inside a callback, both the running timer and another one due in the same slot.
+	{
+		FNFRScheduler Scheduler;
+
+		int32 SelfRuns = 0;
+		FNFRTimerHandle Self;
+		Self = Scheduler.Add(5, 5, [&Scheduler, &Self, &SelfRuns]
+		{
+			++SelfRuns;
+			Scheduler.Cancel(Self);
+		});
+
+		int32 OtherRuns = 0;
+		FNFRTimerHandle Other;
+		Scheduler.Add(8, 0, [&Scheduler, &Other] { Scheduler.Cancel(Other); });
+		Other = Scheduler.Add(8, 0, [&OtherRuns] { ++OtherRuns; });
+
+		Scheduler.AdvanceTo(100);
+		TestEqual(TEXT("Timer that cancels itself runs once"), SelfRuns, 1);
+		TestFalse(TEXT("Cancel resets the handle"), Self.IsValid());
+		TestEqual(TEXT("Timer cancelled earlier in its slot doesn't run"), OtherRuns, 0);
+		TestFalse(TEXT("Cancelled timer isn't scheduled"), Scheduler.IsScheduled(Other));
+		TestEqual(TEXT("Cancelled timers are removed"), Scheduler.Timers.Num(), 0);
+	}
+
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
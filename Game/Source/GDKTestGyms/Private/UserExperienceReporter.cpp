@@ -6,15 +6,22 @@
 #include "EngineClasses/SpatialNetDriver.h"
 #include "GDKTestGyms/GDKTestGymsGameInstance.h"
 #include "Interop/Connection/SpatialWorkerConnection.h"
+#include "MetricsBlueprintLibrary.h"
 #include "NFRConstants.h"
+#include "NFRFlightRecorder.h"
 #include "Net/UnrealNetwork.h"
 #include "UserExperienceComponent.h"
+#include "UserExperienceReporterSubsystem.h"
 #include "Utils/SpatialMetrics.h"
 
 DEFINE_LOG_CATEGORY(LogUserExperienceReporter);
 
 namespace
 {
+	const FString ClientRTTSummaryName = TEXT("unreal_client_rtt_ms");
+	const FString ClientUpdateTimeDeltaSummaryName = TEXT("unreal_client_update_time_delta_ms");
+	const FPrometheusLabel EnginePlatformLabel(TEXT("engine_platform"), TEXT("UnrealWorker"));
+
 	float CalculateAverage(const TArray<float>& Array)
 	{
 		float Avg = 0.0f;
@@ -45,6 +52,24 @@ void UUserExperienceReporter::InitializeComponent()
 	ServerUpdateTimeDeltaMS = 0.0f;
 }
 
+void UUserExperienceReporter::BeginPlay()
+{
+	Super::BeginPlay();
+	if (UUserExperienceReporterSubsystem* Registry = GetWorld()->GetSubsystem<UUserExperienceReporterSubsystem>())
+	{
+		Registry->RegisterReporter(this);
+	}
+}
+
+void UUserExperienceReporter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UUserExperienceReporterSubsystem* Registry = GetWorld()->GetSubsystem<UUserExperienceReporterSubsystem>())
+	{
+		Registry->UnregisterReporter(this);
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
 void UUserExperienceReporter::ReportMetrics()
 {
 	if (UUserExperienceComponent* UXComp = Cast<UUserExperienceComponent>(GetOwner()->FindComponentByClass(UUserExperienceComponent::StaticClass())))
@@ -103,7 +128,8 @@ void UUserExperienceReporter::ReportMetrics()
 					WorkerName = NetDriver->Connection->GetWorkerId();
 				}
 
-				NFR_LOG(LogTemp, Error, TEXT("Client %s failed with fps %f below min threshold %f"), *WorkerName, GameInstance->GetAveragedFPS(), Constants->GetMinClientFPS());
+				NFR_LOG(LogTemp, Error, TEXT("Client %s failed with fps %f below min threshold %f (1%% low %f, p99 frame time %.1fms)"), *WorkerName, GameInstance->GetAveragedFPS(), Constants->GetMinClientFPS(), GameInstance->GetOnePercentLowFPS(), GameInstance->GetP99FrameTimeMS());
+				FNFRFlightRecorder::Get().Dump(TEXT("Client FPS below threshold"));
 			}
 		}
 		ServerReportedMetrics(RoundTripTimeMS, UpdateTimeDeltaMS, bFrameRateValid);
@@ -114,6 +140,26 @@ void UUserExperienceReporter::ServerReportedMetrics_Implementation(float RTTMS,
 {
 	ServerRTTMS = RTTMS;
 	ServerUpdateTimeDeltaMS = UpdateTimeDeltaMS;
+
+	if (!RTTSummary.IsValid())
+	{
+		RTTSummary = UMetricsBlueprintLibrary::GetSummary(ClientRTTSummaryName, { EnginePlatformLabel });
+		UpdateTimeDeltaSummary = UMetricsBlueprintLibrary::GetSummary(ClientUpdateTimeDeltaSummaryName, { EnginePlatformLabel });
+	}
+
+	// Zero means the client doesn't have a full window yet.
+	if (RTTSummary.IsValid() && RTTMS > 0.f)
+	{
+		RTTSummary->Observe(RTTMS);
+	}
+	if (UpdateTimeDeltaSummary.IsValid() && UpdateTimeDeltaMS > 0.f)
+	{
+		UpdateTimeDeltaSummary->Observe(UpdateTimeDeltaMS);
+	}
+	if (UUserExperienceReporterSubsystem* Registry = GetWorld()->GetSubsystem<UUserExperienceReporterSubsystem>())
+	{
+		Registry->RecordClientUX(RTTMS, UpdateTimeDeltaMS);
+	}
 	if (!bInFrameRateValid) // Only change from valid to invalid
 	{
 		bFrameRateValid = bInFrameRateValid;
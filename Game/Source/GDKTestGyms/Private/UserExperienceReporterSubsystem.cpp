@@ -0,0 +1,35 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#include "UserExperienceReporterSubsystem.h"
+
+#include "UserExperienceReporter.h"
+
+void UUserExperienceReporterSubsystem::RegisterReporter(UUserExperienceReporter* Reporter)
+{
+	Reporters.AddUnique(Reporter);
+}
+
+void UUserExperienceReporterSubsystem::UnregisterReporter(UUserExperienceReporter* Reporter)
+{
+	Reporters.RemoveSwap(Reporter);
+}
+
+void UUserExperienceReporterSubsystem::RecordClientUX(float RTTMS, float UpdateTimeDeltaMS)
+{
+	if (RTTMS > 0.f)
+	{
+		PendingRTT.Add(RTTMS);
+	}
+	if (UpdateTimeDeltaMS > 0.f)
+	{
+		PendingUpdateTimeDelta.Add(UpdateTimeDeltaMS);
+	}
+}
+
+void UUserExperienceReporterSubsystem::TakeClientUX(FLatencySketch& OutRTT, FLatencySketch& OutUpdateTimeDelta)
+{
+	OutRTT = MoveTemp(PendingRTT);
+	OutUpdateTimeDelta = MoveTemp(PendingUpdateTimeDelta);
+	PendingRTT.Reset();
+	PendingUpdateTimeDelta.Reset();
+}
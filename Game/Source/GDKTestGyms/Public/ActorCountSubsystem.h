@@ -0,0 +1,89 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SpatialConstants.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/Interface.h"
+#include "ActorCountSubsystem.generated.h"
+
+UINTERFACE(MinimalAPI)
+class UActorCountAuthorityReporter : public UInterface
+{
+	GENERATED_BODY()
+};
+
+// Implemented by actors that call UActorCountSubsystem::NotifyAuthorityChanged()
+// from OnAuthorityGained() and OnAuthorityLost(). Their authoritative count is
+// kept up to date as it changes instead of being rechecked on every read.
+class IActorCountAuthorityReporter
+{
+	GENERATED_BODY()
+};
+
+// Per world total and authoritative actor counts for the classes the NFR
+// actor count check cares about.
+//
+// Counts are maintained as tracked actors spawn, end play and change
+// authority, so reading them doesn't walk the world's actors. Actors that
+// don't report their own authority changes, and reporting actors in the
+// middle of a SpatialOS handover, are rechecked when the counts are read.
+
+UCLASS()
+class GDKTESTGYMS_API UActorCountSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	// Starts counting ActorClass, including any actors of it that already exist.
+	void TrackClass(const TSubclassOf<AActor>& ActorClass);
+
+	// ActorClass must have been tracked.
+	void GetActorCount(const TSubclassOf<AActor>& ActorClass, int32& OutTotalCount, int32& OutAuthCount);
+
+	// Call from OnAuthorityGained()/OnAuthorityLost() of actors implementing IActorCountAuthorityReporter.
+	static void NotifyAuthorityChanged(AActor* Actor);
+
+private:
+	struct FTrackedClass
+	{
+		TSubclassOf<AActor> ActorClass;
+		int32 TotalCount = 0;
+		int32 AuthCount = 0;
+	};
+
+	struct FTrackedActor
+	{
+		// Bit per entry in TrackedClasses this actor counts towards.
+		uint32 ClassMask = 0;
+		bool bAuthoritative = false;
+		bool bReportsAuthority = false;
+		Worker_EntityId EntityId = SpatialConstants::INVALID_ENTITY_ID;
+	};
+
+	void OnActorSpawned(AActor* Actor);
+
+	UFUNCTION()
+	void OnActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
+
+	void AddActor(AActor* Actor, uint32 ClassMask);
+	void UpdateAuthority(AActor* Actor, FTrackedActor& Tracked);
+	void SetAuthoritative(FTrackedActor& Tracked, bool bAuthoritative);
+	bool HasEntityAuthority(const AActor* Actor, FTrackedActor& Tracked) const;
+	uint32 GetClassMask(const AActor* Actor) const;
+
+	// Only ever a handful, so a linear search is fine.
+	TArray<FTrackedClass> TrackedClasses;
+
+	// Actors are removed on EndPlay, so raw keys never dangle.
+	TMap<AActor*, FTrackedActor> TrackedActors;
+
+	// Tracked actors whose authority has to be rechecked on read.
+	TSet<AActor*> PendingActors;
+
+	FDelegateHandle ActorSpawnedHandle;
+};
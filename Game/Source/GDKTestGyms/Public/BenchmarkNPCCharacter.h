@@ -3,15 +3,17 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "ActorCountSubsystem.h"
 #include "GameFramework/Character.h"
 #include "BenchmarkNPCCharacter.generated.h"
 
 UCLASS()
-class GDKTESTGYMS_API ABenchmarkNPCCharacter : public ACharacter
+class GDKTESTGYMS_API ABenchmarkNPCCharacter : public ACharacter, public IActorCountAuthorityReporter
 {
 	GENERATED_BODY()
 
 public:
+	virtual void OnAuthorityGained() override;
 	virtual void OnAuthorityLost() override;
 
 };
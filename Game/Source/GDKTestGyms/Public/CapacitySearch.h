@@ -0,0 +1,36 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Search for the highest load in [MinLoad, MaxLoad] that passes, given one pass/fail result per load tried.
+//
+// Starts at MinLoad and doubles while loads pass, so a build with plenty of headroom finds the failing side quickly.  After the
+// first failure it bisects between the highest pass and lowest failure until they're within Resolution of each other.  Assumes
+// that if a load fails, every higher load fails too.
+class FCapacitySearch
+{
+public:
+	FCapacitySearch(int32 InMinLoad, int32 InMaxLoad, int32 InResolution);
+
+	// The load to try next.
+	int32 GetCurrentLoad() const { return CurrentLoad; }
+
+	void ReportResult(bool bPassed);
+
+	bool IsFinished() const { return bFinished; }
+
+	// Highest load that passed, INDEX_NONE if even MinLoad failed.
+	int32 GetCapacity() const { return HighestPass; }
+
+private:
+	int32 MinLoad;
+	int32 MaxLoad;
+	int32 Resolution;
+
+	int32 CurrentLoad;
+	int32 HighestPass = INDEX_NONE;
+	int32 LowestFailure = INDEX_NONE;
+	bool bFinished = false;
+};
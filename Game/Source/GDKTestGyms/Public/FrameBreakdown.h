@@ -0,0 +1,108 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+
+class FPrometheusHistogram;
+class UWorld;
+
+// Splits each server frame into where the time went, so a failed FPS check can say what got slower rather than just that it did.
+//
+// Phases are timed from the world's tick and net driver events plus the GC delegates:
+//   NetReceive        world tick start to the end of the net drivers' TickDispatch, which on Spatial includes op processing
+//   ActorTick         OnWorldPreActorTick to OnWorldPostActorTick
+//   ReplicationGraph  ServerReplicateActors, reported by UTestGymsReplicationGraph
+//   NetSend           the rest of the net drivers' TickFlush, along with the end of frame world updates that run before it
+//   GarbageCollection pre to post GC, taken out of any phase it lands in
+//   Other             whatever is left of the frame, including time spent waiting on the server tick rate
+//
+// Each phase is exported per frame as unreal_frame_phase_ms{phase="..."}, and averaged over a sliding window of one second
+// buckets for the NFR failure logs.  Only bound on servers.
+class FServerFrameBreakdown
+{
+public:
+	enum class EPhase : uint8
+	{
+		NetReceive,
+		ActorTick,
+		ReplicationGraph,
+		NetSend,
+		GarbageCollection,
+		Other,
+		Count
+	};
+
+	explicit FServerFrameBreakdown(int32 InWindowSeconds);
+	~FServerFrameBreakdown();
+
+	FServerFrameBreakdown(const FServerFrameBreakdown&) = delete;
+	FServerFrameBreakdown& operator=(const FServerFrameBreakdown&) = delete;
+
+	// Starts timing World, moving over from any previously bound world. Does nothing if World is already bound.
+	void Bind(UWorld* World);
+	void Unbind();
+	bool IsBound() const { return BoundWorld.IsValid(); }
+
+	void AddReplicationGraphTime(double Seconds);
+
+	// Closes the frame, called once per frame after the world has ticked.
+	void EndFrame(double NowSeconds, float DeltaSeconds);
+
+	// Average milliseconds per frame spent in Phase over the window.
+	float GetAveragePhaseMS(EPhase Phase) const;
+
+	// The phase with the most time over the window, leaving out Other.
+	EPhase GetDominantPhase() const;
+
+	// e.g. "ActorTick 21.4ms, NetSend 6.2ms, ..." slowest first.
+	FString ToString() const;
+
+	static const TCHAR* GetPhaseName(EPhase Phase);
+
+private:
+	static constexpr int32 NumPhases = static_cast<int32>(EPhase::Count);
+
+	struct FSecondBucket
+	{
+		int64 Second = -1;
+		int32 NumFrames = 0;
+		double PhaseSeconds[NumPhases] = {};
+	};
+
+	void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnPostTickDispatch();
+	void OnPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnPostTickFlush();
+	void OnPreGarbageCollect();
+	void OnPostGarbageCollect();
+
+	void OpenPhase();
+	void ClosePhase(EPhase Phase);
+	void GetWindowTotals(double (&OutPhaseSeconds)[NumPhases], int32& OutNumFrames) const;
+
+	TWeakObjectPtr<UWorld> BoundWorld;
+	FDelegateHandle TickStartHandle;
+	FDelegateHandle PostTickDispatchHandle;
+	FDelegateHandle PreActorTickHandle;
+	FDelegateHandle PostActorTickHandle;
+	FDelegateHandle PostTickFlushHandle;
+	FDelegateHandle PreGarbageCollectHandle;
+	FDelegateHandle PostGarbageCollectHandle;
+
+	// Running total of GC and replication graph time, which can land inside another phase and is taken out of it.
+	double NestedSeconds = 0.0;
+
+	bool bPhaseOpen = false;
+	double PhaseStartTime = 0.0;
+	double PhaseStartNestedSeconds = 0.0;
+	double GarbageCollectStartTime = 0.0;
+
+	double FramePhaseSeconds[NumPhases] = {};
+
+	TArray<FSecondBucket> Buckets;
+
+	TSharedPtr<FPrometheusHistogram, ESPMode::ThreadSafe> PhaseHistograms[NumPhases];
+};
@@ -0,0 +1,54 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Frame times over a sliding time window, for the FPS checks.
+//
+// Frames go into a fixed capacity ring, with a running total and a log bucketed histogram kept up to date as frames enter and
+// leave the window, so adding a frame never moves memory and every query is constant time.  If frames arrive faster than
+// MaxFrames fit in the window the oldest are dropped early, shortening the window rather than growing the ring.
+class FFrameTimeWindow
+{
+public:
+	FFrameTimeWindow(double InWindowSeconds, int32 InMaxFrames);
+
+	void AddFrame(double NowSeconds, float DeltaSeconds);
+
+	int32 GetNumFrames() const { return NumFrames; }
+
+	// IdealFPS if there are no frames yet.
+	float GetAverageFPS(float IdealFPS = 60.0f) const;
+
+	// Upper bound of the bucket holding the given percentile, so within BucketGrowth of the true frame time.
+	float GetFrameTimePercentileMS(float Percentile) const;
+
+	// The frame rate of the slowest 1% of frames, the standard "1% low".
+	float GetOnePercentLowFPS(float IdealFPS = 60.0f) const;
+
+	static constexpr int32 NumBuckets = 96;
+	static constexpr float MinBucketMS = 1.0f;
+	static constexpr float BucketGrowth = 1.1f;
+
+private:
+	struct FFrame
+	{
+		double Time;
+		uint32 DeltaMicroseconds;
+		uint8 Bucket;
+	};
+
+	void RemoveOldest();
+
+	static uint8 GetBucket(float FrameTimeMS);
+	static float GetBucketUpperBoundMS(int32 Bucket);
+
+	double WindowSeconds;
+	TArray<FFrame> Frames;
+	int32 Head = 0; // Oldest frame
+	int32 NumFrames = 0;
+
+	int64 TotalMicroseconds = 0;
+	int32 BucketCounts[NumBuckets] = {};
+};
@@ -0,0 +1,62 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "LatencySketch.generated.h"
+
+// Mergeable quantile sketch (DDSketch) for latency style values in ms.
+//
+// Values are counted in log spaced bins, so any quantile is within RelativeAccuracy of the true value, and two sketches
+// merge by adding bin counts.  Each server sketches its own clients and sends the sketch with its UX report, the
+// authoritative game mode merges them to get percentiles over every client rather than a max of per-server averages.
+//
+// Bins are contiguous from MinIndex.  Once there are more than MaxBins the lowest are folded together, which only costs
+// accuracy at the bottom of the distribution.
+USTRUCT()
+struct FLatencySketch
+{
+	GENERATED_BODY()
+
+	static constexpr float RelativeAccuracy = 0.02f;
+	static constexpr int32 MaxBins = 512;
+
+	// Values at or below this are counted as zero.
+	static constexpr float MinTrackedValue = 0.01f;
+
+	void Add(float Value);
+	void Merge(const FLatencySketch& Other);
+	void Reset();
+
+	// Nearest rank, the same as FPrometheusSummary.  Zero if the sketch is empty.
+	float GetQuantile(float Quantile) const;
+
+	float GetMean() const { return Count > 0 ? Sum / Count : 0.0f; }
+	float GetSum() const { return Sum; }
+	int32 GetCount() const { return Count; }
+
+private:
+	void AddToBin(int32 Index, int32 BinCount);
+	void CollapseLowestBins();
+
+	static int32 GetBinIndex(float Value);
+	static float GetBinValue(int32 Index);
+
+	UPROPERTY()
+	TArray<int32> Bins;
+
+	UPROPERTY()
+	int32 MinIndex = 0;
+
+	UPROPERTY()
+	int32 ZeroCount = 0;
+
+	UPROPERTY()
+	int32 Count = 0;
+
+	UPROPERTY()
+	float Sum = 0.0f;
+
+	UPROPERTY()
+	float MaxValue = 0.0f;
+};
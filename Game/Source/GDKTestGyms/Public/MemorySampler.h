@@ -0,0 +1,46 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MetricsBlueprintLibrary.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogMemorySampler, Log, All);
+
+// Periodic memory sampling for benchmark workers, cheap enough to run for a whole uptime test and chart, unlike memreport.
+//
+// With LLM enabled (-LLM) each sample reads a fixed set of LLM tag totals, otherwise it falls back to the platform memory stats.
+// Either way they're exported as unreal_memory_mb{tag="..."} gauges along with the live UObject count.  The total (LLM's
+// TrackedTotal, or used physical memory without LLM) is also kept over a sliding window, and its least squares slope is the
+// growth rate the game mode checks for leaks.
+class FMemorySampler
+{
+public:
+	explicit FMemorySampler(double InGrowthWindowSeconds);
+
+	void Sample(double NowSeconds);
+
+	// Drops the growth history, e.g. once load in has finished so it isn't mistaken for a leak.
+	void ResetGrowthHistory() { TotalHistory.Reset(); }
+
+	// MB per hour over the window, 0 until there are two samples.
+	double GetGrowthRateMBPerHour() const;
+
+	// How much time the growth rate is based on.
+	double GetGrowthHistorySeconds() const;
+
+	double GetTotalMB() const { return LastTotalMB; }
+
+	static bool IsUsingLLM();
+
+private:
+	void Publish(const TCHAR* Tag, double ValueMB);
+
+	double GrowthWindowSeconds;
+	TArray<TPair<double, double>> TotalHistory; // <time, MB>, oldest first
+	double LastTotalMB = 0.0;
+
+	TMap<FString, FPrometheusMetricHandle> TagMetrics;
+	FPrometheusMetricHandle UObjectCountMetric;
+	FPrometheusMetricHandle GrowthRateMetric;
+};
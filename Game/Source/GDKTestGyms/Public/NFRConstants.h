@@ -8,6 +8,8 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogNFRConstants, Log, All);
 
+// One-shot deadline on the monotonic cycle counter, so wall clock changes can't set it off early or late.
+// For checks that repeat, prefer scheduling them on the game mode's FNFRScheduler over polling one of these every tick.
 class FMetricTimer
 {
 public:
@@ -23,8 +25,8 @@ public:
 
 private:
 
-	bool bLocked;
-	int64 TimeToStart;
+	bool bLocked = false;
+	int64 TimeToStart = 0; // In FPlatformTime::Cycles64 cycles.
 };
 
 UCLASS()
@@ -0,0 +1,149 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogNFRFlightRecorder, Log, All);
+
+class UNetDriver;
+class UWorld;
+
+// Always on, in memory record of the last few seconds of frames, scopes, net counters and GC, written out when something goes
+// wrong so a failed NFR run comes with a capture of the hitch rather than whatever a blind stat startfile window caught.
+//
+// Scopes cover the bound world's tick, split into net receive (TickDispatch), actor tick and net flush, with
+// ServerReplicateActors and the game mode's own work nested inside.  Net driver byte and packet counters are sampled once a
+// second, and in builds with STATS so are the call counts of engine stats whose names contain one of -NFRFlightRecorderStats=
+// (default RPC,Replicat), which is where RPC counts come from.  Those are only there while stats are being collected.
+//
+// Events go into a fixed ring of POD records on the game thread, which is a couple of stores per event.  Dump() copies out the
+// last -NFRFlightRecorderSeconds= (default 10) and writes it on the thread pool as Chrome trace JSON (chrome://tracing, Perfetto)
+// under Saved/Profiling/FlightRecorder.  EndFrame() dumps by itself when a frame takes longer than -NFRFlightRecorderHitchMS=
+// (default 250), and the game mode dumps when an NFR check fails.  -NoNFRFlightRecorder turns it off.
+//
+// Game thread only, events from other threads are dropped.
+class FNFRFlightRecorder
+{
+public:
+	static FNFRFlightRecorder& Get();
+
+	bool IsEnabled() const { return bEnabled; }
+
+	// Names must be string literals or otherwise outlive the recorder.
+	void BeginScope(const TCHAR* Name);
+	void EndScope(const TCHAR* Name);
+	void RecordCounter(const TCHAR* Name, double Value);
+
+	// Called once per frame by the game instance.  NetDriver may be null.
+	void EndFrame(float DeltaSeconds, const UNetDriver* NetDriver);
+
+	// Records the world tick scopes for World.  Cheap to call every frame, it only rebinds when the world changes.
+	void Bind(UWorld* World);
+	void Unbind();
+
+	// Dumps unless one was written within the last MinSecondsBetweenDumps, or MaxDumps have been written.  bForce skips the
+	// cooldown, for failures we'd always want a capture of.
+	void Dump(const FString& Reason, bool bForce = false);
+
+private:
+	FNFRFlightRecorder();
+
+	enum class EEventType : uint8
+	{
+		Frame,
+		ScopeBegin,
+		ScopeEnd,
+		Counter,
+	};
+
+	struct FRecordedEvent
+	{
+		uint64 Cycles;
+		const TCHAR* Name;
+		double Value;
+		EEventType Type;
+	};
+
+	void Record(EEventType Type, const TCHAR* Name, double Value);
+	void OnPreGarbageCollect();
+	void OnPostGarbageCollect();
+
+	void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnPostTickDispatch();
+	void OnPreActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	void OnPostTickFlush();
+
+	// Engine hooks don't always come in pairs (e.g. a world without a net driver), so the world scopes track whether they're
+	// open and are closed innermost first, keeping the trace properly nested.
+	enum EWorldScope
+	{
+		WorldTick,
+		NetReceive,
+		ActorTick,
+		NetFlush,
+		NumWorldScopes
+	};
+	void OpenWorldScope(EWorldScope Scope);
+	void CloseWorldScopes(EWorldScope Outermost);
+
+#if STATS
+	void RecordStatCounters();
+#endif
+
+	static void WriteTrace(const FString& Path, const FString& Reason, TArray<FRecordedEvent> TraceEvents, uint64 StartCycles);
+
+	bool bEnabled = false;
+	float WindowSeconds = 10.0f;
+	float HitchThresholdMS = 250.0f;
+
+	TArray<FRecordedEvent> Events;
+	int32 NextEvent = 0;
+	bool bWrapped = false;
+
+	// Hitches while loading in are expected, don't dump for them.
+	double HitchArmTime = 0.0;
+	double LastDumpTime = -1.0;
+	int32 NumDumps = 0;
+	double LastNetCounterTime = 0.0;
+
+	TWeakObjectPtr<UWorld> BoundWorld;
+	FDelegateHandle TickStartHandle;
+	FDelegateHandle PostTickDispatchHandle;
+	FDelegateHandle PreActorTickHandle;
+	FDelegateHandle PostActorTickHandle;
+	FDelegateHandle PostTickFlushHandle;
+	bool bWorldScopeOpen[NumWorldScopes] = {};
+
+#if STATS
+	TArray<FString> StatSubstrings;
+
+	// Counter name per stat, empty for stats that aren't recorded.  Entries are never removed, so the string buffers the ring
+	// points into stay put as the map grows.
+	TMap<FName, FString> StatCounterNames;
+#endif
+
+	static constexpr double MinSecondsBetweenDumps = 30.0;
+	static constexpr int32 MaxDumps = 20;
+};
+
+struct FNFRFlightScope
+{
+	explicit FNFRFlightScope(const TCHAR* InName)
+		: Name(InName)
+	{
+		FNFRFlightRecorder::Get().BeginScope(Name);
+	}
+
+	~FNFRFlightScope()
+	{
+		FNFRFlightRecorder::Get().EndScope(Name);
+	}
+
+private:
+	const TCHAR* Name;
+};
+
+#define NFR_FLIGHT_SCOPE(Name) FNFRFlightScope PREPROCESSOR_JOIN(NFRFlightScope_, __LINE__)(TEXT(Name))
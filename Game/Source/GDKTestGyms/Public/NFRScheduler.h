@@ -0,0 +1,94 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FNFRTimerHandle
+{
+	bool IsValid() const { return Index != INDEX_NONE; }
+
+private:
+	friend class FNFRScheduler;
+
+	int32 Index = INDEX_NONE;
+	uint32 Serial = 0;
+};
+
+// Runs NFR check callbacks at a fixed delay or period, driven by Tick() once per frame on the game thread.
+//
+// Time comes from FPlatformTime::Cycles64, so wall clock changes (NTP steps, DST) don't move deadlines.  Timers live in a
+// hierarchical timer wheel of NumLevels x NumSlots slots, ResolutionSeconds per slot at the bottom level, so Tick() is a
+// single compare on frames where no slot has elapsed, and a slot only holds the timers that are actually due in it.
+//
+// A repeating timer that falls behind (e.g. a long hitch) fires once and skips the periods it missed.
+class FNFRScheduler
+{
+public:
+	FNFRScheduler();
+
+	FNFRScheduler(const FNFRScheduler&) = delete;
+	FNFRScheduler& operator=(const FNFRScheduler&) = delete;
+
+	FNFRTimerHandle Schedule(float DelaySeconds, TFunction<void()> Callback);
+	FNFRTimerHandle ScheduleRepeating(float FirstDelaySeconds, float PeriodSeconds, TFunction<void()> Callback);
+
+	// Safe to call from inside a callback, including the timer's own.  Resets the handle.
+	void Cancel(FNFRTimerHandle& Handle);
+	bool IsScheduled(const FNFRTimerHandle& Handle) const;
+
+	void Tick();
+
+	static constexpr float ResolutionSeconds = 0.1f;
+
+private:
+#if WITH_DEV_AUTOMATION_TESTS
+	friend class FNFRSchedulerTest;
+#endif // WITH_DEV_AUTOMATION_TESTS
+
+	static constexpr int32 SlotBits = 6;
+	static constexpr int32 NumSlots = 1 << SlotBits;
+	static constexpr uint64 SlotMask = NumSlots - 1;
+	static constexpr int32 NumLevels = 4;
+
+	struct FTimer
+	{
+		uint64 Expiry;
+		uint64 Period;
+		uint32 Serial;
+		TFunction<void()> Callback;
+	};
+
+	// Slots refer to timers by index and serial, a cancelled timer's entries are skipped when its slot comes up.
+	struct FSlotEntry
+	{
+		int32 Index;
+		uint32 Serial;
+	};
+
+	FNFRTimerHandle Add(uint64 Delay, uint64 Period, TFunction<void()> Callback);
+
+	// Runs everything due up to InNowTick, which is where real time is.
+	void AdvanceTo(uint64 InNowTick);
+	void Insert(int32 Index);
+	void Cascade();
+	void RunDueSlot();
+	bool IsCurrent(const FSlotEntry& Entry) const;
+
+	uint64 SecondsToTicks(float Seconds) const;
+
+	uint64 StartCycles;
+	uint64 CyclesPerTick;
+	uint64 CurrentTick = 0;
+
+	// The tick real time is in.  Ahead of CurrentTick while Tick() catches up after a hitch, equal to it otherwise.
+	uint64 NowTick = 0;
+
+	// When CurrentTick + 1 starts, in cycles.
+	uint64 NextTickCycles;
+
+	TSparseArray<FTimer> Timers;
+	uint32 NextSerial = 1;
+
+	TArray<FSlotEntry> Slots[NumLevels][NumSlots];
+};
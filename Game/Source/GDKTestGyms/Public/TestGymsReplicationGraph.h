@@ -49,6 +49,9 @@ public:
 	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
 	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
 	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+
+	// Timed for the server frame breakdown, see FServerFrameBreakdown.
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
 	
 	UPROPERTY()
 	TArray<UClass*>	SpatializedClasses;
@@ -8,6 +8,8 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogUserExperienceReporter, Log, All);
 
+class FPrometheusSummary;
+
 // User experience metric
 //
 // This component takes the recorded values from UserExperienceComponent,
@@ -29,10 +31,17 @@ public:
 	bool bFrameRateValid;
 
 	void InitializeComponent() override;
+	void BeginPlay() override;
+	void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	 
 	void OnClientOwnershipGained() override;
 	void ReportMetrics();
 
 	UFUNCTION(Server, Reliable)
 	void ServerReportedMetrics(float RTTMS, float UpdateTimeDeltaMS, bool bInFrameRateValid);
+
+private:
+	// Per worker distributions of the reported values, so the tail can be scraped rather than just the averages.
+	TSharedPtr<FPrometheusSummary, ESPMode::ThreadSafe> RTTSummary;
+	TSharedPtr<FPrometheusSummary, ESPMode::ThreadSafe> UpdateTimeDeltaSummary;
 };
@@ -0,0 +1,45 @@
+// Copyright (c) Improbable Worlds Ltd, All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "LatencySketch.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UserExperienceReporterSubsystem.generated.h"
+
+class UUserExperienceReporter;
+
+// Per world registry of UserExperienceReporter components.
+//
+// Reporters join on BeginPlay and leave on EndPlay, so the game mode can
+// check every player's UX each frame by walking a compact array rather
+// than the global UObject array.
+//
+// Reporters also record each client report here as it arrives, so the game
+// mode can send a distribution on its own interval without sampling every frame.
+
+UCLASS()
+class GDKTESTGYMS_API UUserExperienceReporterSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	void RegisterReporter(UUserExperienceReporter* Reporter);
+	void UnregisterReporter(UUserExperienceReporter* Reporter);
+
+	// Unordered, reporters are swapped in and out.
+	const TArray<UUserExperienceReporter*>& GetReporters() const { return Reporters; }
+
+	// Zero means the client doesn't have a result yet and isn't recorded.
+	void RecordClientUX(float RTTMS, float UpdateTimeDeltaMS);
+
+	// Everything recorded since the last call.
+	void TakeClientUX(FLatencySketch& OutRTT, FLatencySketch& OutUpdateTimeDelta);
+
+private:
+	FLatencySketch PendingRTT;
+	FLatencySketch PendingUpdateTimeDelta;
+
+	UPROPERTY()
+	TArray<UUserExperienceReporter*> Reporters;
+};